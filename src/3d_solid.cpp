@@ -212,9 +212,15 @@ std::ostream& operator<<(std::ostream& os, const AFK_3DVapourCube& cube)
 
 /* AFK_3DList implementation. */
 
+AFK_3DList::AFK_3DList(AFK_FrameArena *arena):
+    f(AFK_FrameAllocator<AFK_3DVapourFeature>(arena)),
+    c(AFK_FrameAllocator<AFK_3DVapourCube>(arena))
+{
+}
+
 void AFK_3DList::extend(const AFK_3DList& list)
 {
-    extend<std::vector<AFK_3DVapourFeature>, std::vector<AFK_3DVapourCube> >(list.f, list.c);
+    extend<FeatureVector, CubeVector>(list.f, list.c);
 }
 
 size_t AFK_3DList::featureCount(void) const
@@ -234,7 +240,7 @@ std::ostream& operator<<(std::ostream& os, const AFK_3DList& list)
 {
     os << "3D List: Cubes: (";
     bool first = true;
-    for (std::vector<AFK_3DVapourCube>::const_iterator cIt = list.c.begin();
+    for (AFK_3DList::CubeVector::const_iterator cIt = list.c.begin();
         cIt != list.c.end(); ++cIt)
     {
         if (!first) os << ", ";
@@ -246,7 +252,7 @@ std::ostream& operator<<(std::ostream& os, const AFK_3DList& list)
 #if PRINT_FEATURES
     os << "; Features: (";
     first = true;
-    for (std::vector<AFK_3DVapourFeature>::const_iterator fIt = list.f.begin();
+    for (AFK_3DList::FeatureVector::const_iterator fIt = list.f.begin();
         fIt != list.f.end(); ++fIt)
     {
         if (!first) os << ", ";
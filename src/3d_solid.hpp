@@ -28,6 +28,7 @@
 #include <boost/type_traits/has_trivial_assign.hpp>
 #include <boost/type_traits/has_trivial_destructor.hpp>
 
+#include "data/frame_arena.hpp"
 #include "def.hpp"
 #include "rng/rng.hpp"
 #include "shape_sizes.hpp"
@@ -177,10 +178,18 @@ BOOST_STATIC_ASSERT((boost::has_trivial_destructor<AFK_3DVapourCube>::value));
 class AFK_3DList
 {
 protected:
-    std::vector<AFK_3DVapourFeature> f;
-    std::vector<AFK_3DVapourCube> c;
+    typedef std::vector<AFK_3DVapourFeature, AFK_FrameAllocator<AFK_3DVapourFeature> > FeatureVector;
+    typedef std::vector<AFK_3DVapourCube, AFK_FrameAllocator<AFK_3DVapourCube> > CubeVector;
+
+    FeatureVector f;
+    CubeVector c;
 
 public:
+    /* As with the terrain list, the workers' ones come out of
+     * their frame arenas.
+     */
+    AFK_3DList(AFK_FrameArena *arena = nullptr);
+
     template<typename FeaturesIterable, typename CubesIterable>
     void extend(const FeaturesIterable& features, const CubesIterable& cubes)
     {
@@ -23,113 +23,71 @@
 std::mutex debugSpamMut;
 #endif
 
-static void afk_workerBusyBitAndMask(unsigned int id, uint64_t& o_busyBit, uint64_t& o_busyMask)
-{
-    o_busyBit = 1ull << id;
-    o_busyMask = ~o_busyBit;
-}
-
 void AFK_AsyncControls::control_workReady(void)
 {
-    ASYNC_CONTROL_DEBUG("control_workReady: " << std::hex << allWorkerMask << " worker mask")   
-
-    std::unique_lock<std::mutex> lock(workMut);
-    while ((workReady != 0 || workRunning != 0) && !quit)
-    {
-        ASYNC_CONTROL_DEBUG("control_workReady: waiting")
+    ASYNC_CONTROL_DEBUG("control_workReady: " << workerCount << " workers")
 
-        /* Those workers are busy launching something else */
-        workCond.wait(lock);
-    }
+    /* Those workers might be busy finishing something else */
+    waitUntil([this]() { return finished.load() == run.load() || quit.load(); });
 
-    workReady = allWorkerMask;
-    assert(workRunning == 0);
-    quit = false;
+    pending.store(workerCount);
+    run.fetch_add(1);
 
-    workCond.notify_all();
+    changed.notifyAll();
 }
 
 void AFK_AsyncControls::control_quit(void)
 {
     ASYNC_CONTROL_DEBUG("control_quit: sending quit")
 
-    std::unique_lock<std::mutex> lock(workMut);
-
     /* I should be able to just flag for quit right away. */
-    quit = true;
-    workCond.notify_all();
+    quit.store(true);
+    changed.notifyAll();
     ASYNC_CONTROL_DEBUG("control_quit: flagged")
 }
 
-bool AFK_AsyncControls::worker_waitForWork(unsigned int id)
+bool AFK_AsyncControls::worker_waitForWork(unsigned int index)
 {
     ASYNC_CONTROL_DEBUG("worker_waitForWork: entry")
 
-    std::unique_lock<std::mutex> lock(workMut);
-    while (workReady == 0 && !quit)
-    {
-        ASYNC_CONTROL_DEBUG("worker_waitForWork: waiting")
+    /* There's no work, wait for some to turn up.  The control
+     * thread won't start another run until I've finished this
+     * one, so the next one along is always the one after mine.
+     */
+    uint64_t lastRun = workerRun[index];
+    waitUntil([this, lastRun]() { return run.load() != lastRun || quit.load(); });
 
-        /* There's no work, wait for some to turn up. */
-        workCond.wait(lock);
-    }
-    
-    ASYNC_CONTROL_DEBUG("worker_waitForWork: syncing with other workers")
-
-    /* Register this thread as working on the task */
-    uint64_t busyBit, busyMask;
-    afk_workerBusyBitAndMask(id, busyBit, busyMask);
-    workReady &= busyMask;
-    workRunning |= busyBit;
-    workCond.notify_all();
-
-    /* Wait for everyone else to be working on this task too. */
-    while (workReady != 0 && !quit)
-    {
-        ASYNC_CONTROL_DEBUG("worker_waitForWork: " << std::hex << workReady << " left over (quit=" << quit << ")")
-        workCond.wait(lock);
-    }
+    if (quit.load()) return false;
 
-    return !quit;
+    assert(run.load() == lastRun + 1);
+    workerRun[index] = lastRun + 1;
+    return true;
 }
 
-void AFK_AsyncControls::worker_waitForFinished(unsigned int id)
+void AFK_AsyncControls::worker_waitForFinished(unsigned int index)
 {
     ASYNC_CONTROL_DEBUG("worker_waitForFinished: entry")
 
-    std::unique_lock<std::mutex> lock(workMut);
-
-    assert(workReady == 0); /* TODO, see above, I feel I ought not to need this */
-
-    /* Clear my running bit first... */
-    uint64_t busyBit, busyMask;
-    afk_workerBusyBitAndMask(id, busyBit, busyMask);
-    workRunning &= busyMask;
-
-    /* ... and now, wait for all the others.
-     * In this loop, we need to remember to check for
-     * work being ready too; if our thread is delayed at this point,
-     * the control thread may have found no work ready or running and
-     * added more, and a different thread may have grabbed some and
-     * declared itself running already, at which point we need to
-     * hop along and grab it too.  Everyone will wait before re-entry
-     * to the work loop. (in worker_waitForWork() ).
-     */
-    while (workReady == 0 && workRunning != 0 && !quit)
+    /* Count myself out ... */
+    uint64_t myRun = workerRun[index];
+    if (pending.fetch_sub(1) == 1)
     {
-        ASYNC_CONTROL_DEBUG("worker_waitForFinished: " << std::hex << workRunning << " still running (quit=" << quit << ")")
-        workCond.wait(lock);
+        /* ... I was the last, let everyone go.  (This is also
+         * what wakes the control thread and tells it it can
+         * ready the next batch.)
+         */
+        finished.store(myRun);
+        changed.notifyAll();
+    }
+    else
+    {
+        /* ... and wait for all the others. */
+        waitUntil([this, myRun]() { return finished.load() >= myRun || quit.load(); });
     }
-
-    /* This is needed to wake up the control thread and tell it it can
-     * ready the next batch
-     */
-    workCond.notify_all();
 }
 
 bool AFK_AsyncControls::control_workFinished(void)
 {
-    std::unique_lock<std::mutex> lock(workMut);
-    return (workRunning == 0);
+    return (finished.load() == run.load());
 }
 
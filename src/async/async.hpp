@@ -18,6 +18,7 @@
 #ifndef _AFK_ASYNC_ASYNC_H_
 #define _AFK_ASYNC_ASYNC_H_
 
+#include <chrono>
 #include <exception>
 #include <future>
 #include <iostream>
@@ -26,6 +27,12 @@
 #include <thread>
 #include <vector>
 
+#include <boost/atomic.hpp>
+
+#include "../clock.hpp"
+#include "../data/thread_counters.hpp"
+#include "event_count.hpp"
+#include "thread_affinity.hpp"
 #include "thread_allocation.hpp"
 #include "work_queue.hpp"
 
@@ -34,6 +41,13 @@
 
 #define ASYNC_WORKER_DEBUG 0
 
+/* Workers that run out of things to do park on the work queue
+ * until more turns up (or the task finishes), rather than spinning
+ * round a yield.  Turn this off to get the old behaviour back for
+ * comparison.
+ */
+#define AFK_ASYNC_PARK_IDLE_WORKERS 1
+
 #if ASYNC_DEBUG_SPAM
 #include <ctime>
 #include <iostream>
@@ -89,47 +103,68 @@ private:
     AFK_AsyncControls& operator=(const AFK_AsyncControls& controls) = delete;
 
 protected:
-    /* Here's the list of thread IDs of the workers (the size of this
-     * list is, of course, the worker count.)
+    const unsigned int workerCount;
+
+    /* The workers sync up with the control thread and with each
+     * other like this (there used to be a bit per worker in a
+     * uint64_t here, which capped the gang at 63 threads):
+     * - The control thread waits for the last run to finish, sets
+     * `pending' to the worker count and bumps `run'.
+     * - Each worker waits for `run' to go past the last run it
+     * picked up (which it keeps in `workerRun').
+     * - When a worker decides the run is finished, it counts
+     * itself out of `pending'.  The last one out sets `finished'
+     * to the run number, which lets everyone go.  That's a
+     * sense-reversing barrier, with the run number for a sense,
+     * so a worker that's slow to notice can't be confused by the
+     * next run starting up.
+     * Anyone who has to wait parks on `changed'.
      */
-    std::vector<unsigned int> workerIds;
-
-    uint64_t allWorkerMask;
-
-    /* The workers wait on this condition variable until things are
-     * primed and they're ready to go. Here's how we do it:
-     * - The control thread flags a bit of `workReady' for each
-     * worker it wants to run
-     * - When a worker grabs the condition variable, it clears its
-     * bit to indicate it got it.  It then waits on the variable
-     * again until all bits become 0, indicating all workers are
-     * sync'd up and ready to go
-     * - To latch the workers out, I use `workRunning' with the
-     * same scheme: when the workers start, they set their bit
-     * of `workRunning'.  When they decide things are finished, they
-     * clear their bit and wait until all the bits become zero.
+    boost::atomic<uint64_t> run;
+    boost::atomic<uint64_t> finished;
+    boost::atomic<unsigned int> pending;
+    boost::atomic<bool> quit; /* Tells the workers to instead quit out entirely */
+
+    /* Indexed by worker; each entry is only touched by its own
+     * worker.
      */
-    std::condition_variable workCond;
-    std::mutex workMut;
-    uint64_t workReady;
-    uint64_t workRunning;
-    bool quit; /* Tells the workers to instead quit out entirely */
+    std::vector<uint64_t> workerRun;
+
+    AFK_EventCount changed;
+
+    /* Parks until `pred' is true. */
+    template<typename Predicate>
+    void waitUntil(Predicate pred)
+    {
+        while (!pred())
+        {
+            AFK_EventCount::Key key = changed.prepareWait();
+            if (pred())
+            {
+                changed.cancelWait();
+                break;
+            }
+
+            changed.wait(key);
+        }
+    }
 
 public:
-    AFK_AsyncControls(const std::vector<unsigned int>& _workerIds):
-        workerIds(_workerIds), allWorkerMask(0), workReady(0), workRunning(0), quit(false)
+    AFK_AsyncControls(unsigned int _workerCount):
+        workerCount(_workerCount), run(0), finished(0), pending(0), quit(false), workerRun(_workerCount, 0)
     {
-        for (auto id : _workerIds) allWorkerMask |= (1ull << id);
     }
 
     void control_workReady(void);
     void control_quit(void);
 
-    /* Returns true if there is work to be done, false for quit */
-    bool worker_waitForWork(unsigned int id);
+    /* Returns true if there is work to be done, false for quit.
+     * The workers identify themselves by their index in the gang.
+     */
+    bool worker_waitForWork(unsigned int index);
 
     /* Blocks until all workers are latched out. */
-    void worker_waitForFinished(unsigned int id);
+    void worker_waitForFinished(unsigned int index);
 
     /* Checks whether all work is finished or not. */
     bool control_workFinished(void);
@@ -147,6 +182,70 @@ public:
     std::mutex mut;
 };
 
+/* How long the workers spent idle but awake (i.e. spinning), and
+ * how many times they parked.  Accumulated across the gang, per
+ * worker thread (see thread_counters.hpp); whoever's printing them
+ * resets them.
+ */
+class AFK_AsyncIdleStats
+{
+protected:
+#define AFK_ASYNC_IDLE_SPIN_NANOS   0
+#define AFK_ASYNC_IDLE_PARKS        1
+    AFK_ThreadCounters<2> counters;
+
+public:
+    void spun(unsigned int threadId, const afk_clock::time_point& idleStart)
+    {
+        counters.add(threadId, AFK_ASYNC_IDLE_SPIN_NANOS, std::chrono::duration_cast<std::chrono::nanoseconds>(
+            afk_clock::now() - idleStart).count());
+    }
+
+    void parked(unsigned int threadId)
+    {
+        counters.add(threadId, AFK_ASYNC_IDLE_PARKS, 1);
+    }
+
+    uint64_t getSpinNanos(void) const { return counters.total(AFK_ASYNC_IDLE_SPIN_NANOS); }
+    uint64_t getParks(void) const { return counters.total(AFK_ASYNC_IDLE_PARKS); }
+
+    uint64_t getSpinNanosAndReset(void) { return counters.totalAndReset(AFK_ASYNC_IDLE_SPIN_NANOS); }
+    uint64_t getParksAndReset(void) { return counters.totalAndReset(AFK_ASYNC_IDLE_PARKS); }
+};
+
+/* A Reducer folds the work functions' return values together.
+ * Each worker folds its own as it goes, and the results from all the
+ * workers are combined once they've all finished, so the functions
+ * themselves can return what they did instead of bumping shared
+ * counters.  It needs:
+ * - ReturnType identity(void) const: the starting value, and
+ * - void operator()(ReturnType& acc, const ReturnType& value) const,
+ * which folds `value' into `acc'.
+ * The default just keeps the last value it saw (which is all the
+ * gang used to do.)
+ */
+template<typename ReturnType>
+struct AFK_AsyncKeepLast
+{
+    ReturnType identity(void) const
+    {
+        return ReturnType();
+    }
+
+    void operator()(ReturnType& acc, const ReturnType& value) const
+    {
+        acc = value;
+    }
+};
+
+/* Where each worker leaves its folded result at the end of a run. */
+template<typename ReturnType>
+struct AFK_AsyncWorkerResult
+{
+    ReturnType value;
+    bool hasValue; /* false if that worker didn't get anything done */
+};
+
 /* TODO: Parameter for this function, to stop it from having
  * to reference globals?
  */
@@ -157,7 +256,8 @@ typedef std::function<bool (void)> AFK_AsyncTaskFinishedFunc;
  * includes each function to call along with its arguments (see
  * work_queue).
  * - ReturnType is the type the called function should return.
- * (Barely used; I've been sticking to bool.)
+ * The values get folded together with the Reducer (see above), and
+ * the result comes out of the future start() returns.
  * - ThreadLocalType is the type of a field whose contents
  * should be copied into thread-local storage at the start of each
  * run, and a const reference passed to the called function.
@@ -167,16 +267,20 @@ typedef std::function<bool (void)> AFK_AsyncTaskFinishedFunc;
  * - AsyncTaskFinishedFunc is called periodically (not on any
  * deterministic schedule) to decide when things are finished.
  */
-template<typename ParameterType, typename ReturnType, typename ThreadLocalType, AFK_AsyncTaskFinishedFunc& taskFinished>
+template<typename ParameterType, typename ReturnType, typename ThreadLocalType, AFK_AsyncTaskFinishedFunc& taskFinished, typename Reducer>
 void afk_asyncWorker(
     AFK_AsyncControls& controls,
     AFK_ThreadLocalWrapper<ThreadLocalType>& threadLocalSource,
     unsigned int id,
-    bool first,
+    unsigned int index,
     AFK_WorkQueue<ParameterType, ReturnType, ThreadLocalType>& queue,
+    AFK_AsyncIdleStats& idleStats,
+    std::vector<AFK_AsyncWorkerResult<ReturnType> >& results,
     std::promise<ReturnType>*& promise)
 {
-    while (controls.worker_waitForWork(id))
+    Reducer reduce;
+
+    while (controls.worker_waitForWork(index))
     {
         /* Copy out the thread-local values for this run. */
         ThreadLocalType tl;
@@ -185,16 +289,28 @@ void afk_asyncWorker(
         tl = threadLocalSource.inner; /* that seriously shouldn't throw an exception */
         threadLocalSource.mut.unlock();
 
-        /* TODO Do something sane with the return values rather
-         * than just accumulating the last one!
+        /* The return value of each function goes into `retval',
+         * and gets folded into `acc'.
          */
         ReturnType retval;
+        ReturnType acc = reduce.identity();
+        bool hasValue = false;
         enum AFK_WorkQueueStatus status;
         bool finished = false;
 
+        /* When I started idling (awake), if I am. */
+        bool idling = false;
+        afk_clock::time_point idleStart;
+
         while (!finished)
         {
             status = queue.consume(id, tl, retval);
+            if (status == AFK_WQ_WAITING && !idling)
+            {
+                idling = true;
+                idleStart = afk_clock::now();
+            }
+
             switch (status)
             {
             case AFK_WQ_BUSY:
@@ -206,14 +322,45 @@ void afk_asyncWorker(
                 if (taskFinished())
                 {
                     finished = true;
+
+                    /* Nobody else is going to find anything
+                     * either: get them up so they can see that.
+                     */
+                    queue.wakeAll();
                 }
                 else
                 {
+#if AFK_ASYNC_PARK_IDLE_WORKERS
+                    /* Try once more after registering as a waiter,
+                     * so that I can't miss a push (or the finish)
+                     * that happens in between.
+                     */
+                    AFK_EventCount::Key key = queue.prepareWait();
+                    status = queue.consume(id, tl, retval);
+                    if (status == AFK_WQ_BUSY)
+                    {
+                        queue.cancelWait();
+                    }
+                    else if (taskFinished())
+                    {
+                        queue.cancelWait();
+                        finished = true;
+                        queue.wakeAll();
+                    }
+                    else
+                    {
+                        idleStats.spun(id, idleStart);
+                        idleStats.parked(id);
+                        queue.park(key);
+                        idleStart = afk_clock::now();
+                    }
+#else
                     /* Give way so I don't cram the CPU with busy-waits.
                      * This is really important -- the whole system chokes
                      * if I don't do it.
                      */
                     std::this_thread::yield();
+#endif
                 }
                 break;
 
@@ -221,23 +368,45 @@ void afk_asyncWorker(
                 /* Programming error. */
                 throw AFK_AsyncException();
             }
+
+            if (status == AFK_WQ_BUSY)
+            {
+                reduce(acc, retval);
+                hasValue = true;
+            }
+
+            if (status == AFK_WQ_BUSY || finished)
+            {
+                if (idling)
+                {
+                    idleStats.spun(id, idleStart);
+                    idling = false;
+                }
+            }
         }
 
-        /* I think I've finished.  Sync up. */
-        controls.worker_waitForFinished(id);
+        /* I think I've finished.  Leave my result where the
+         * first worker can see it (the sync sorts out the memory
+         * ordering), and sync up.
+         */
+        results[index].value = acc;
+        results[index].hasValue = hasValue;
+        controls.worker_waitForFinished(index);
 
 #if ASYNC_WORKER_DEBUG
         afk_out << "X";
 #endif
 
-        /* At this point, everyone has finished.
-         * See TODO above: for expediency, if I've got the `first' flag
-         * (only one worker has), I'll populate the return value, otherwise
-         * I'll throw it away now
+        /* At this point, everyone has finished.  The first worker
+         * combines the results and fulfils the promise.
          */
-        if (first)
+        if (index == 0)
         {
-            promise->set_value(retval);
+            ReturnType combined = reduce.identity();
+            for (auto& r : results)
+                if (r.hasValue) reduce(combined, r.value);
+
+            promise->set_value(combined);
 #if ASYNC_DEBUG_SPAM
             ASYNC_DEBUG("fulfilling promise " << std::hex << (void *)promise)
 #endif
@@ -246,7 +415,12 @@ void afk_asyncWorker(
 }
 
 
-template<typename ParameterType, typename ReturnType, typename ThreadLocalType, AFK_AsyncTaskFinishedFunc& taskFinished>
+template<
+    typename ParameterType,
+    typename ReturnType,
+    typename ThreadLocalType,
+    AFK_AsyncTaskFinishedFunc& taskFinished,
+    typename Reducer = AFK_AsyncKeepLast<ReturnType> >
 class AFK_AsyncGang
 {
 protected:
@@ -263,29 +437,41 @@ protected:
      */
     AFK_ThreadLocalWrapper<ThreadLocalType> threadLocalSource;
 
+    AFK_AsyncIdleStats idleStats;
+
+    /* One per worker, in order. */
+    std::vector<AFK_AsyncWorkerResult<ReturnType> > results;
+
     /* The promised return value. */
     std::promise<ReturnType> *promise;
 
     void initWorkers(void)
     {
-        bool first = true;
-        for (auto id : threadIds)
+        results.resize(threadIds.size());
+        for (unsigned int index = 0; index < threadIds.size(); ++index)
         { 
             std::thread *t = new std::thread(
-                afk_asyncWorker<ParameterType, ReturnType, ThreadLocalType, taskFinished>,
+                afk_asyncWorker<ParameterType, ReturnType, ThreadLocalType, taskFinished, Reducer>,
                 std::ref(*controls),
                 std::ref(threadLocalSource),
-                id,
-                first,
+                threadIds[index],
+                index,
                 std::ref(queue),
+                std::ref(idleStats),
+                std::ref(results),
                 std::ref(promise));
+            afk_threadAffinity.pinWorker(*t, index);
             workers.push_back(t);
-            first = false;
         }
     }
 
 public:
-    AFK_AsyncGang(size_t queueSize, AFK_ThreadAllocation& threadAllocation, unsigned int concurrency):
+    AFK_AsyncGang(
+        size_t queueSize,
+        AFK_ThreadAllocation& threadAllocation,
+        unsigned int concurrency,
+        bool workStealing = false,
+        unsigned int priorityLevels = 1):
         promise(nullptr)
     {
         /* Work out the actual maximum number of threads I can add
@@ -297,7 +483,10 @@ public:
         for (unsigned int t = 0; t < threadCount; ++t)
             threadIds.push_back(threadAllocation.getNewId());
 
-        controls = new AFK_AsyncControls(threadIds);
+        if (workStealing) queue.enableWorkStealing(threadIds);
+        if (priorityLevels > 1) queue.enablePriorities(priorityLevels);
+
+        controls = new AFK_AsyncControls(threadCount);
         initWorkers();
     }
 
@@ -316,6 +505,16 @@ public:
         delete controls;
     }
 
+    AFK_AsyncIdleStats& getIdleStats(void)
+    {
+        return idleStats;
+    }
+
+    unsigned int getPriorityLevels(void) const
+    {
+        return queue.getPriorityLevels();
+    }
+
     unsigned int getConcurrency(void) const
     {
         return workers.size();
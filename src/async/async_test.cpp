@@ -15,12 +15,15 @@
  * along with this program.  If not, see [http://www.gnu.org/licenses/].
  */
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 
 #include <boost/atomic.hpp>
 
 #include "async.hpp"
+#include "termination_counter.hpp"
+#include "thread_affinity.hpp"
 #include "thread_allocation.hpp"
 #include "work_queue.hpp"
 #include "../clock.hpp"
@@ -53,7 +56,7 @@ struct primeFilterThreadLocal
 /* To decide when we've finished, this global tracks the number
  * of individual filters currently running.
  */
-boost::atomic_uint filtersInFlight;
+AFK_TerminationCounter filtersInFlight;
 
 bool primeFilter(
     unsigned int id,
@@ -62,7 +65,7 @@ bool primeFilter(
     AFK_WorkQueue<struct primeFilterParam, bool, struct primeFilterThreadLocal>& queue);
 
 /* Helper. */
-void enqueueFilter(struct primeFilterParam param, AFK_WorkQueue<struct primeFilterParam, bool, struct primeFilterThreadLocal>& queue)
+void enqueueFilter(unsigned int id, struct primeFilterParam param, AFK_WorkQueue<struct primeFilterParam, bool, struct primeFilterThreadLocal>& queue)
 {
     bool gotIt = false;
     bool isEnqueued = false;
@@ -74,12 +77,12 @@ void enqueueFilter(struct primeFilterParam param, AFK_WorkQueue<struct primeFilt
 
     if (!isEnqueued)
     {
-        filtersInFlight.fetch_add(1);
+        filtersInFlight.add(id, 1);
 
         AFK_WorkQueue<struct primeFilterParam, bool, struct primeFilterThreadLocal>::WorkItem workItem;
         workItem.func = primeFilter;
         workItem.param = param;
-        queue.push(workItem);
+        queue.push(id, workItem);
     }
 }
 
@@ -113,23 +116,23 @@ bool primeFilter(
             struct primeFilterParam numFilter;
             numFilter.start = num;
             numFilter.step = num;
-            enqueueFilter(numFilter, queue);
+            enqueueFilter(id, numFilter, queue);
         }
     }
 
     /* I finished successfully! */
-    filtersInFlight.fetch_sub(1);
+    filtersInFlight.remove(id, 1);
     return true;
 }
 
 bool filtersFinished(void)
 {
-    return (filtersInFlight.load() == 0);
+    return filtersInFlight.finished();
 }
 
 AFK_AsyncTaskFinishedFunc filtersFinishedFunc = filtersFinished;
 
-void test_pnFilter(unsigned int concurrency, unsigned int primeMax, std::vector<unsigned int>& primes)
+float test_pnFilter(unsigned int concurrency, unsigned int primeMax, std::vector<unsigned int>& primes, bool workStealing = false)
 {
     afk_clock::time_point startTime, endTime;
 
@@ -141,13 +144,17 @@ void test_pnFilter(unsigned int concurrency, unsigned int primeMax, std::vector<
         enqueued[i].store(false);
     }
 
-    afk_out << "Testing prime number filter with " << concurrency << " threads ..." << std::endl;
+    afk_out << "Testing prime number filter with " << concurrency << " threads" <<
+        (workStealing ? " (work stealing)" : "") << " ..." << std::endl;
 
     startTime = afk_clock::now();
 
     {
+        AFK_ThreadAllocation threadAlloc;
+        unsigned int testThreadId = threadAlloc.getNewId();
+
         /* I'm starting with one filter */
-        filtersInFlight.store(1);
+        filtersInFlight.add(testThreadId, 1);
 
         AFK_WorkQueue<struct primeFilterParam, bool, struct primeFilterThreadLocal>::WorkItem i;
         i.func              = primeFilter;
@@ -157,10 +164,8 @@ void test_pnFilter(unsigned int concurrency, unsigned int primeMax, std::vector<
         struct primeFilterThreadLocal tl;
         tl.max = primeMax;
 
-        AFK_ThreadAllocation threadAlloc;
-
         AFK_AsyncGang<struct primeFilterParam, bool, struct primeFilterThreadLocal, filtersFinishedFunc> primeFilterGang(
-            primeMax / 100, threadAlloc, concurrency);
+            primeMax / 100, threadAlloc, concurrency, workStealing);
         primeFilterGang << i;
         std::future<bool> finished = primeFilterGang.start(tl); 
 
@@ -170,6 +175,9 @@ void test_pnFilter(unsigned int concurrency, unsigned int primeMax, std::vector<
 
         /* Obligatory sanity check */
         assert(primeFilterGang.noQueuedWork());
+
+        afk_out << "Idle spinning: " << primeFilterGang.getIdleStats().getSpinNanos() / 1000000 << " millis, parks: " <<
+            primeFilterGang.getIdleStats().getParks() << std::endl;
     }
 
     endTime = afk_clock::now();
@@ -182,6 +190,64 @@ void test_pnFilter(unsigned int concurrency, unsigned int primeMax, std::vector<
 
     delete[] factors;
     delete[] enqueued;
+    return timeTaken.count();
+}
+
+/* Runs the filter over and over on the same gang, the way the
+ * world enumerates frames, and reports the mean and worst run.
+ */
+void test_pnFrames(unsigned int concurrency, unsigned int primeMax, unsigned int frames, bool pinned)
+{
+    afk_threadAffinity.configure(pinned, -1);
+
+    factors = new boost::atomic_uint[primeMax];
+    enqueued = new boost::atomic_bool[primeMax];
+
+    afk_out << "Running " << frames << " prime number filter frames with " << concurrency << " threads" <<
+        (pinned ? " (pinned)" : "") << " ..." << std::endl;
+
+    float totalTime = 0.0f, worstTime = 0.0f;
+    {
+        AFK_ThreadAllocation threadAlloc;
+        unsigned int testThreadId = threadAlloc.getNewId();
+        AFK_AsyncGang<struct primeFilterParam, bool, struct primeFilterThreadLocal, filtersFinishedFunc> primeFilterGang(
+            primeMax / 100, threadAlloc, concurrency);
+
+        struct primeFilterThreadLocal tl;
+        tl.max = primeMax;
+
+        for (unsigned int frame = 0; frame < frames; ++frame)
+        {
+            for (unsigned int i = 0; i < primeMax; ++i)
+            {
+                factors[i].store(0);
+                enqueued[i].store(false);
+            }
+
+            afk_clock::time_point startTime = afk_clock::now();
+
+            filtersInFlight.add(testThreadId, 1);
+            AFK_WorkQueue<struct primeFilterParam, bool, struct primeFilterThreadLocal>::WorkItem i;
+            i.func              = primeFilter;
+            i.param.start       = 2;
+            i.param.step        = 2;
+            primeFilterGang << i;
+            std::future<bool> finished = primeFilterGang.start(tl);
+            finished.wait();
+
+            afk_duration_mfl timeTaken = std::chrono::duration_cast<afk_duration_mfl>(afk_clock::now() - startTime);
+            totalTime += timeTaken.count();
+            worstTime = std::max(worstTime, timeTaken.count());
+        }
+    }
+
+    afk_out << concurrency << " threads" << (pinned ? " (pinned)" : "") << ": mean frame " << totalTime / frames <<
+        " millis, worst frame " << worstTime << " millis" << std::endl;
+
+    delete[] factors;
+    delete[] enqueued;
+
+    afk_threadAffinity.configure(false, -1);
 }
 
 void check_result(std::vector<unsigned int>& primes1, std::vector<unsigned int>& primes2)
@@ -240,5 +306,28 @@ void test_async(void)
     test_pnFilter(std::thread::hardware_concurrency() * 4, primeMax, primes[5]);
     check_result(primes[0], primes[5]);
     afk_out << std::endl;
+
+    /* More workers than there are bits in a uint64_t. */
+    std::vector<unsigned int> manyPrimes;
+    test_pnFilter(128, primeMax, manyPrimes);
+    check_result(primes[0], manyPrimes);
+    afk_out << std::endl;
+
+    /* Compare the shared queue with work stealing. */
+    const unsigned int stealingConcurrencies[] = { 4, 8, 16, 32 };
+    for (auto concurrency : stealingConcurrencies)
+    {
+        std::vector<unsigned int> sharedPrimes, stealingPrimes;
+        float sharedTime = test_pnFilter(concurrency, primeMax, sharedPrimes, false);
+        float stealingTime = test_pnFilter(concurrency, primeMax, stealingPrimes, true);
+        check_result(primes[0], stealingPrimes);
+        afk_out << concurrency << " threads: work stealing speedup " << sharedTime / stealingTime << std::endl;
+        afk_out << std::endl;
+    }
+
+    /* Compare floating workers with pinned ones. */
+    test_pnFrames(std::thread::hardware_concurrency(), primeMax / 10, 50, false);
+    test_pnFrames(std::thread::hardware_concurrency(), primeMax / 10, 50, true);
+    afk_out << std::endl;
 }
 
@@ -0,0 +1,113 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#ifndef _AFK_ASYNC_EVENT_COUNT_H_
+#define _AFK_ASYNC_EVENT_COUNT_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#include <boost/atomic.hpp>
+
+#include "../data/data.hpp"
+
+/* An event count: lets idle worker threads go to sleep until
+ * there's something for them to do, without the producers having
+ * to take a lock every time they push (they only touch the mutex
+ * if somebody is actually asleep).
+ *
+ * A waiter goes:
+ * - key = prepareWait()
+ * - check for work one more time.  If there is some,
+ * cancelWait() and get on with it,
+ * - otherwise, wait(key).
+ * Anything that was notified after prepareWait() makes wait()
+ * return straight away, so nothing gets lost in between.
+ *
+ * The state word holds the epoch (bumped by every notify that
+ * had somebody to wake) in the top half and the number of
+ * waiters in the bottom half.
+ */
+class AFK_EventCount
+{
+protected:
+    boost::atomic<uint64_t> state;
+
+    std::mutex mut;
+    std::condition_variable cond;
+
+    static const uint64_t waiterMask = 0xffffffffull;
+    static const unsigned int epochShift = 32;
+
+    bool bump(void)
+    {
+        /* This fence pairs with the one in prepareWait(): either
+         * I see the waiter, or the waiter sees whatever I did
+         * before notifying.
+         */
+        boost::atomic_thread_fence(boost::memory_order_seq_cst);
+        if ((state.load(boost::memory_order_relaxed) & waiterMask) == 0) return false;
+
+        std::unique_lock<std::mutex> lock(mut);
+        state.fetch_add(1ull << epochShift);
+        return true;
+    }
+
+public:
+    typedef uint32_t Key;
+
+    AFK_EventCount() afk_noexcept: state(0) {}
+
+    AFK_EventCount(const AFK_EventCount& _ec) = delete;
+    AFK_EventCount& operator=(const AFK_EventCount& _ec) = delete;
+
+    Key prepareWait(void) afk_noexcept
+    {
+        uint64_t prev = state.fetch_add(1);
+        boost::atomic_thread_fence(boost::memory_order_seq_cst);
+        return static_cast<Key>(prev >> epochShift);
+    }
+
+    void cancelWait(void) afk_noexcept
+    {
+        state.fetch_sub(1);
+    }
+
+    void wait(Key key)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mut);
+            while (static_cast<Key>(state.load() >> epochShift) == key)
+                cond.wait(lock);
+        }
+
+        state.fetch_sub(1);
+    }
+
+    void notifyOne(void)
+    {
+        if (bump()) cond.notify_one();
+    }
+
+    void notifyAll(void)
+    {
+        if (bump()) cond.notify_all();
+    }
+};
+
+#endif /* _AFK_ASYNC_EVENT_COUNT_H_ */
@@ -0,0 +1,141 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#ifndef _AFK_ASYNC_TERMINATION_COUNTER_H_
+#define _AFK_ASYNC_TERMINATION_COUNTER_H_
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+#include <boost/atomic.hpp>
+
+#include "../data/data.hpp"
+#include "thread_allocation.hpp"
+
+/* A termination counter tracks how much work is outstanding
+ * without any shared writes.  Every thread adds the work it hands
+ * out to, and takes the work it's done off, counters of its own
+ * (one cache line each), and finished() works out whether it's all
+ * gone by scanning them (which only the idle workers do.)
+ *
+ * The counters only ever go up.  finished() reads all the `done'
+ * ones first and then all the `created' ones.  Work is always
+ * created (by whoever queues it) before it's done (by whoever
+ * picks it up), so at the moment in between the two passes,
+ *   done so far <= what I read from `done'
+ *              <= created so far
+ *              <= what I read from `created',
+ * and if the two sums I read are equal, nothing was outstanding at
+ * that moment.  Since only outstanding work can create more, it's
+ * all over.  (That's Mattern's counting method, with the two waves
+ * folded into one scan.)  The sums can wrap around harmlessly.
+ */
+
+class AFK_TerminationCounter
+{
+protected:
+    struct Slot
+    {
+        boost::atomic<uint64_t> created;
+        boost::atomic<uint64_t> done;
+    } afk_align(64);
+
+    /* These live out of line, aligned by hand, because whoever
+     * owns me is probably on the heap, and (before C++17) new
+     * won't line it up on a cache line for me.
+     */
+    void *slotStorage;
+    Slot *slots;
+
+    /* One more than the highest thread ID that's counted anything,
+     * so that finished() needn't scan the rest.
+     */
+    boost::atomic<unsigned int> slotsInUse;
+
+    void useSlot(unsigned int threadId) afk_noexcept
+    {
+        assert(threadId < AFK_MAX_THREADS);
+        unsigned int inUse = slotsInUse.load(boost::memory_order_relaxed);
+        while (inUse <= threadId && !slotsInUse.compare_exchange_weak(inUse, threadId + 1));
+    }
+
+public:
+    AFK_TerminationCounter(): slotsInUse(0)
+    {
+        size_t space = sizeof(Slot) * AFK_MAX_THREADS + sizeof(Slot);
+        slotStorage = ::operator new(space);
+        void *aligned = slotStorage;
+        std::align(sizeof(Slot), sizeof(Slot) * AFK_MAX_THREADS, aligned, space);
+        slots = static_cast<Slot*>(aligned);
+
+        for (unsigned int t = 0; t < AFK_MAX_THREADS; ++t)
+        {
+            new (&slots[t]) Slot();
+            slots[t].created.store(0);
+            slots[t].done.store(0);
+        }
+    }
+
+    AFK_TerminationCounter(const AFK_TerminationCounter& _counter) = delete;
+    AFK_TerminationCounter& operator=(const AFK_TerminationCounter& _counter) = delete;
+
+    virtual ~AFK_TerminationCounter()
+    {
+        for (unsigned int t = 0; t < AFK_MAX_THREADS; ++t) slots[t].~Slot();
+        ::operator delete(slotStorage);
+    }
+
+    /* Each of these must only be called by the thread with that
+     * ID.
+     */
+    void add(unsigned int threadId, uint64_t amount) afk_noexcept
+    {
+        useSlot(threadId);
+        boost::atomic<uint64_t>& created = slots[threadId].created;
+        created.store(created.load(boost::memory_order_relaxed) + amount, boost::memory_order_release);
+    }
+
+    void remove(unsigned int threadId, uint64_t amount) afk_noexcept
+    {
+        useSlot(threadId);
+        boost::atomic<uint64_t>& done = slots[threadId].done;
+        done.store(done.load(boost::memory_order_relaxed) + amount, boost::memory_order_release);
+    }
+
+    bool finished(void) const afk_noexcept
+    {
+        unsigned int inUse = slotsInUse.load();
+
+        uint64_t doneSum = 0;
+        for (unsigned int t = 0; t < inUse; ++t)
+            doneSum += slots[t].done.load(boost::memory_order_acquire);
+
+        uint64_t createdSum = 0;
+        for (unsigned int t = 0; t < inUse; ++t)
+            createdSum += slots[t].created.load(boost::memory_order_acquire);
+
+        /* If a new thread turned up in the middle of that, I might
+         * have seen the work it did but not the work it made, so I
+         * can't tell.
+         */
+        return (doneSum == createdSum && slotsInUse.load() == inUse);
+    }
+};
+
+#endif /* _AFK_ASYNC_TERMINATION_COUNTER_H_ */
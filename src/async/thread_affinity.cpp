@@ -0,0 +1,279 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "thread_affinity.hpp"
+#include "../file/logstream.hpp"
+
+AFK_ThreadAffinity afk_threadAffinity;
+
+/* Helpers. */
+
+#ifndef _WIN32
+static bool readSysValue(const std::string& path, std::string& o_value)
+{
+    std::ifstream f(path);
+    if (!f) return false;
+    std::getline(f, o_value);
+    return !f.fail();
+}
+
+static unsigned int readSysUInt(const std::string& path, unsigned int defaultValue)
+{
+    std::string value;
+    if (!readSysValue(path, value)) return defaultValue;
+
+    std::istringstream ss(value);
+    unsigned int i;
+    return (ss >> i) ? i : defaultValue;
+}
+#endif /* _WIN32 */
+
+static bool pinThreadTo(std::thread::native_handle_type th, const std::vector<unsigned int>& cpus)
+{
+    if (cpus.empty()) return false;
+
+#ifdef _WIN32
+    DWORD_PTR mask = 0;
+    for (auto cpu : cpus)
+        if (cpu < sizeof(DWORD_PTR) * 8) mask |= (static_cast<DWORD_PTR>(1) << cpu);
+    return (mask != 0 && SetThreadAffinityMask(th, mask) != 0);
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus)
+        if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    return (pthread_setaffinity_np(th, sizeof(set), &set) == 0);
+#endif
+}
+
+static std::thread::native_handle_type currentThreadHandle(void)
+{
+#ifdef _WIN32
+    return GetCurrentThread();
+#else
+    return pthread_self();
+#endif
+}
+
+static void printCpus(std::ostream& os, const std::vector<unsigned int>& cpus)
+{
+    for (unsigned int i = 0; i < cpus.size(); ++i)
+        os << (i > 0 ? "," : "") << cpus[i];
+}
+
+std::vector<unsigned int> afk_parseCpuList(const std::string& cpuList)
+{
+    std::vector<unsigned int> cpus;
+    std::istringstream ss(cpuList);
+    std::string range;
+    while (std::getline(ss, range, ','))
+    {
+        unsigned int first, last;
+        char dash;
+        std::istringstream rs(range);
+        if (!(rs >> first)) continue;
+        if (rs >> dash && dash == '-' && rs >> last)
+        {
+            for (unsigned int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+        }
+        else
+        {
+            cpus.push_back(first);
+        }
+    }
+
+    return cpus;
+}
+
+/* AFK_CpuTopology implementation */
+
+AFK_CpuTopology::AFK_CpuTopology()
+{
+#ifndef _WIN32
+    std::string online;
+    if (readSysValue("/sys/devices/system/cpu/online", online))
+    {
+        for (auto id : afk_parseCpuList(online))
+        {
+            std::ostringstream topoPath;
+            topoPath << "/sys/devices/system/cpu/cpu" << id << "/topology/";
+
+            struct Cpu cpu;
+            cpu.id          = id;
+            cpu.core        = readSysUInt(topoPath.str() + "core_id", id);
+            cpu.package     = readSysUInt(topoPath.str() + "physical_package_id", 0);
+            cpu.node        = 0;
+            cpus.push_back(cpu);
+        }
+
+        /* The NUMA nodes list their own CPUs.  No node directory
+         * (no NUMA support in the kernel) just leaves everything
+         * on node 0.
+         */
+        std::string nodesOnline;
+        if (readSysValue("/sys/devices/system/node/online", nodesOnline))
+        {
+            for (auto node : afk_parseCpuList(nodesOnline))
+            {
+                std::ostringstream nodePath;
+                nodePath << "/sys/devices/system/node/node" << node << "/cpulist";
+
+                std::string nodeCpus;
+                if (!readSysValue(nodePath.str(), nodeCpus)) continue;
+                for (auto id : afk_parseCpuList(nodeCpus))
+                {
+                    for (auto& cpu : cpus)
+                        if (cpu.id == id) cpu.node = node;
+                }
+            }
+        }
+    }
+#endif /* _WIN32 */
+
+    if (cpus.empty())
+    {
+        for (unsigned int id = 0; id < std::thread::hardware_concurrency(); ++id)
+        {
+            struct Cpu cpu;
+            cpu.id          = id;
+            cpu.core        = id;
+            cpu.package     = 0;
+            cpu.node        = 0;
+            cpus.push_back(cpu);
+        }
+    }
+
+    std::sort(cpus.begin(), cpus.end(), [](const struct Cpu& a, const struct Cpu& b) {
+        if (a.node != b.node) return a.node < b.node;
+        if (a.package != b.package) return a.package < b.package;
+        if (a.core != b.core) return a.core < b.core;
+        return a.id < b.id;
+    });
+}
+
+std::vector<unsigned int> AFK_CpuTopology::getCoresFirst(int node) const
+{
+    std::vector<unsigned int> firsts, siblings;
+    for (unsigned int i = 0; i < cpus.size(); ++i)
+    {
+        if (node >= 0 && cpus[i].node != static_cast<unsigned int>(node)) continue;
+
+        bool first = (i == 0 ||
+            cpus[i].core != cpus[i-1].core ||
+            cpus[i].package != cpus[i-1].package ||
+            cpus[i].node != cpus[i-1].node);
+        (first ? firsts : siblings).push_back(cpus[i].id);
+    }
+
+    firsts.insert(firsts.end(), siblings.begin(), siblings.end());
+    return firsts;
+}
+
+bool AFK_CpuTopology::sameCore(unsigned int cpuA, unsigned int cpuB) const
+{
+    auto findCpu = [this](unsigned int id) {
+        return std::find_if(cpus.begin(), cpus.end(), [id](const struct Cpu& cpu) { return cpu.id == id; });
+    };
+
+    auto a = findCpu(cpuA);
+    auto b = findCpu(cpuB);
+    if (a == cpus.end() || b == cpus.end()) return cpuA == cpuB;
+    return (a->core == b->core && a->package == b->package && a->node == b->node);
+}
+
+/* AFK_ThreadAffinity implementation */
+
+AFK_ThreadAffinity::AFK_ThreadAffinity():
+    enabled(false), masterCpu(0)
+{
+}
+
+void AFK_ThreadAffinity::configure(bool pinThreads, int workerNode)
+{
+    enabled = false;
+    workerCpus.clear();
+    helperCpus.clear();
+    if (!pinThreads) return;
+
+    AFK_CpuTopology topology;
+    std::vector<unsigned int> all = topology.getCoresFirst(-1);
+    if (all.empty()) return;
+
+    /* The master gets the first core to itself, and nobody else
+     * shares it, unless there's nowhere else to go.
+     */
+    masterCpu = all[0];
+
+    std::vector<unsigned int> workerCandidates = topology.getCoresFirst(workerNode);
+    if (workerCandidates.empty())
+    {
+        afk_out << "AFK_ThreadAffinity: No CPUs in node " << workerNode << ", ignoring it" << std::endl;
+        workerCandidates = all;
+    }
+
+    for (auto cpu : workerCandidates)
+        if (!topology.sameCore(cpu, masterCpu)) workerCpus.push_back(cpu);
+    if (workerCpus.empty()) workerCpus = workerCandidates;
+
+    /* The helpers mostly chew over the caches that the workers
+     * are filling, so they go where the workers are.
+     */
+    helperCpus = workerCpus;
+    std::sort(helperCpus.begin(), helperCpus.end());
+
+    enabled = true;
+
+    afk_out << "AFK_ThreadAffinity: Master on CPU " << masterCpu << ", workers on CPUs ";
+    printCpus(afk_out, workerCpus);
+    afk_out << std::endl;
+}
+
+bool AFK_ThreadAffinity::pinMaster(void) const
+{
+    if (!enabled) return false;
+    return pinThreadTo(currentThreadHandle(), std::vector<unsigned int>(1, masterCpu));
+}
+
+bool AFK_ThreadAffinity::pinWorker(std::thread& th, unsigned int index) const
+{
+    if (!enabled) return false;
+
+    /* One to a CPU, while they last.  Any more than that would
+     * only be shuffling for the same CPU, so the stragglers float.
+     */
+    if (index < workerCpus.size())
+        return pinThreadTo(th.native_handle(), std::vector<unsigned int>(1, workerCpus[index]));
+    else
+        return pinThreadTo(th.native_handle(), helperCpus);
+}
+
+bool AFK_ThreadAffinity::pinHelper(std::thread& th) const
+{
+    if (!enabled) return false;
+    return pinThreadTo(th.native_handle(), helperCpus);
+}
@@ -0,0 +1,112 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#ifndef _AFK_ASYNC_THREAD_AFFINITY_H_
+#define _AFK_ASYNC_THREAD_AFFINITY_H_
+
+#include <string>
+#include <thread>
+#include <vector>
+
+/* This module decides which CPUs each of my threads should run on,
+ * so that the OS doesn't keep migrating them between cores and
+ * sockets (and splitting their cache working sets) as it sees fit.
+ * The placement is:
+ * - the master thread (which does all the rendering) gets the first
+ * physical core to itself;
+ * - each gang worker gets a physical core of its own, then the spare
+ * hyperthreads, optionally keeping to one NUMA node.  Any workers
+ * over and above that float over the whole worker set;
+ * - the helper threads (the caches' eviction and chain building
+ * threads) float over the workers' CPUs, since they're chewing over
+ * the same data.
+ * None of it happens unless it's been configured.
+ */
+
+/* What I learned about the machine.  On Linux, this comes out of
+ * /sys; elsewhere I just assume every logical CPU is a core of its
+ * own on node 0.
+ */
+class AFK_CpuTopology
+{
+public:
+    struct Cpu
+    {
+        unsigned int id;
+        unsigned int core;
+        unsigned int package;
+        unsigned int node;
+    };
+
+protected:
+    /* Sorted by node, package, core and then id, so that the first
+     * CPU I see of each core is its first hyperthread.
+     */
+    std::vector<struct Cpu> cpus;
+
+public:
+    AFK_CpuTopology();
+
+    const std::vector<struct Cpu>& getCpus(void) const { return cpus; }
+
+    /* Lists the CPU IDs in the given node (or in every node, for
+     * node -1), with the first hyperthread of each physical core
+     * ahead of all the others.
+     */
+    std::vector<unsigned int> getCoresFirst(int node) const;
+
+    /* True if these two CPUs are hyperthreads of the same core. */
+    bool sameCore(unsigned int cpuA, unsigned int cpuB) const;
+};
+
+/* Parses a /sys style CPU list, e.g. "0-3,8-11". */
+std::vector<unsigned int> afk_parseCpuList(const std::string& cpuList);
+
+class AFK_ThreadAffinity
+{
+protected:
+    bool enabled;
+
+    unsigned int masterCpu;
+    std::vector<unsigned int> workerCpus;
+    std::vector<unsigned int> helperCpus;
+
+public:
+    AFK_ThreadAffinity();
+
+    /* Works out the placement.  If `pinThreads' is false, it turns
+     * pinning off again.  `workerNode' keeps the workers on that
+     * NUMA node, or anywhere for -1.
+     */
+    void configure(bool pinThreads, int workerNode);
+
+    bool isEnabled(void) const { return enabled; }
+
+    /* These return false if they didn't pin anything.
+     * pinMaster() pins the calling thread.
+     */
+    bool pinMaster(void) const;
+    bool pinWorker(std::thread& th, unsigned int index) const;
+    bool pinHelper(std::thread& th) const;
+};
+
+/* The one placement everything refers to.  The gangs and caches
+ * consult it when they make threads; it's set up by AFK_Core.
+ */
+extern AFK_ThreadAffinity afk_threadAffinity;
+
+#endif /* _AFK_ASYNC_THREAD_AFFINITY_H_ */
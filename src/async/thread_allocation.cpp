@@ -26,13 +26,13 @@ AFK_ThreadAllocation::AFK_ThreadAllocation():
 
 unsigned int AFK_ThreadAllocation::getNewId(void)
 {
-    assert(next < 63);
+    assert(next < AFK_MAX_THREADS);
     unsigned int id = next++;
     return id;
 }
 
 unsigned int AFK_ThreadAllocation::getMaxNewIds(void) const
 {
-    return (62 - next);
+    return (AFK_MAX_THREADS - next);
 }
 
@@ -18,10 +18,18 @@
 #ifndef _AFK_ASYNC_THREAD_ALLOCATION_H_
 #define _AFK_ASYNC_THREAD_ALLOCATION_H_
 
-/* This module defines a way of giving out unique thread IDs that
- * fit into a uint64_t flag set, keeping the top bit reserved.
+/* This module defines a way of giving out unique thread IDs.  They
+ * come out dense, counting up from 0, because the per-thread tables
+ * (the reader slots, the recycling pools, the work queue's worker
+ * index and so on) are all indexed by them.
  * You should probably have only one of these around at once...
  */
+
+/* How many thread IDs there are to give out.  Those tables are
+ * all this size.
+ */
+#define AFK_MAX_THREADS 256
+
 class AFK_ThreadAllocation
 {
 protected:
@@ -18,10 +18,16 @@
 #ifndef _AFK_ASYNC_WORK_QUEUE_H_
 #define _AFK_ASYNC_WORK_QUEUE_H_
 
+#include <cassert>
 #include <exception>
+#include <vector>
 
 #include <boost/lockfree/queue.hpp>
 
+#include "event_count.hpp"
+#include "thread_allocation.hpp"
+#include "work_stealing_deque.hpp"
+
 /* An async work queue encompasses the concept of repeatedly
  * queueing up work items to be fed to a worker function.
  *
@@ -30,6 +36,23 @@
  *
  * I no longer try to detect whether the overall task is finished
  * here: that's now done by the async worker function (see async.hpp).
+ *
+ * By default everything goes through one shared lock-free queue.
+ * With enableWorkStealing(), each worker instead gets a deque of
+ * its own: items pushed by a worker (with its thread ID) go on the
+ * bottom of its deque, so it works through its own subtree depth
+ * first, and workers that run dry steal from the top of a randomly
+ * chosen other worker's deque.  Items pushed from outside (the
+ * initial ones) still go through the shared queue, and so should
+ * resumes: they're waiting for something else to happen, and on
+ * the bottom of a deque they'd come straight back again.
+ *
+ * With enablePriorities(), items pushed with a priority go into one
+ * of a set of shared queues, one per priority level, and consume()
+ * empties the most urgent (lowest numbered) level first.  Items
+ * pushed without one come last.  (That's only roughly in order, of
+ * course: it makes no difference to anything that's already been
+ * picked up.)  A priority push overrides work stealing.
  */
 
 class AFK_WorkQueueException: public std::exception {};
@@ -63,8 +86,108 @@ public:
 protected:
     boost::lockfree::queue<WorkItem> q;
 
+    /* The priority levels, if enabled, most urgent first.  `q'
+     * comes after all of these.
+     */
+    std::vector<boost::lockfree::queue<WorkItem>*> priorityQueues;
+
+    /* Idle workers park on this; every push wakes one of them. */
+    AFK_EventCount idle;
+
+    /* The work stealing state.  Each worker's bits are touched
+     * mostly by that worker alone.
+     */
+    class Worker
+    {
+    public:
+        AFK_WorkStealingDeque<WorkItem> deque;
+        uint32_t stealSeed;
+
+        Worker(uint32_t _stealSeed): deque(), stealSeed(_stealSeed) {}
+    };
+
+#define AFK_WQ_MAX_THREAD_ID AFK_MAX_THREADS
+#define AFK_WQ_NOT_A_WORKER -1
+
+    std::vector<Worker*> workers;
+
+    /* Thread ID -> index into `workers'. */
+    int workerIndex[AFK_WQ_MAX_THREAD_ID];
+
+    Worker *getWorker(unsigned int threadId) const
+    {
+        if (workers.empty() || threadId >= AFK_WQ_MAX_THREAD_ID) return nullptr;
+        int index = workerIndex[threadId];
+        return (index == AFK_WQ_NOT_A_WORKER ? nullptr : workers[index]);
+    }
+
+    /* Tries to steal an item from one of the other workers,
+     * starting with a random one.
+     */
+    bool steal(Worker *thief, WorkItem& o_item)
+    {
+        /* xorshift: just needs to spread the thieves around. */
+        uint32_t x = thief->stealSeed;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        thief->stealSeed = x;
+
+        size_t count = workers.size();
+        for (size_t i = 0; i < count; ++i)
+        {
+            Worker *victim = workers[(x + i) % count];
+            if (victim != thief && victim->deque.steal(o_item)) return true;
+        }
+
+        return false;
+    }
+
 public:
-    AFK_WorkQueue(): q(100) /* arbitrary */ {}
+    AFK_WorkQueue(): q(100) /* arbitrary */
+    {
+        for (unsigned int t = 0; t < AFK_WQ_MAX_THREAD_ID; ++t)
+            workerIndex[t] = AFK_WQ_NOT_A_WORKER;
+    }
+
+    virtual ~AFK_WorkQueue()
+    {
+        for (auto w : workers) delete w;
+        for (auto pq : priorityQueues) delete pq;
+    }
+
+    /* Gives each of these worker thread IDs a deque of its own.
+     * Call before any work is queued.
+     */
+    void enableWorkStealing(const std::vector<unsigned int>& workerIds)
+    {
+        assert(workers.empty());
+        for (auto id : workerIds)
+        {
+            assert(id < AFK_WQ_MAX_THREAD_ID);
+            workerIndex[id] = static_cast<int>(workers.size());
+            workers.push_back(new Worker(2463534242u + id * 2654435761u));
+        }
+    }
+
+    /* Sets up `levels' levels of priority (numbered 0 to
+     * levels-1, 0 being the most urgent.)
+     * Call before any work is queued.
+     */
+    void enablePriorities(unsigned int levels)
+    {
+        assert(priorityQueues.empty() && levels > 0);
+        for (unsigned int l = 0; l < levels - 1; ++l)
+            priorityQueues.push_back(new boost::lockfree::queue<WorkItem>(100));
+    }
+
+    /* Returns the number of priority levels (1 if they're not
+     * enabled.)
+     */
+    unsigned int getPriorityLevels(void) const
+    {
+        return static_cast<unsigned int>(priorityQueues.size()) + 1;
+    }
 
     /* Consumes one item from the queue via its function.
      * If an item was consumed, fills out `retval' with the
@@ -77,8 +200,19 @@ public:
         ReturnType& retval)
     {
         WorkItem nextItem;
+        Worker *worker = getWorker(threadId);
+
+        /* My own items first, then the priority levels in order,
+         * then anything else that's been pushed to the shared queue,
+         * then whatever I can steal.
+         */
+        bool gotItem = (worker && worker->deque.take(nextItem));
+        for (auto pq = priorityQueues.begin(); !gotItem && pq != priorityQueues.end(); ++pq)
+            gotItem = (*pq)->pop(nextItem);
 
-        if (q.pop(nextItem))
+        if (gotItem ||
+            q.pop(nextItem) ||
+            (worker && steal(worker, nextItem)))
         {
             retval = (*(nextItem.func))(threadId, nextItem.param, threadLocal, *this);
             return AFK_WQ_BUSY;
@@ -92,6 +226,68 @@ public:
     void push(WorkItem parameter)
     {
         if (!q.push(parameter)) throw AFK_WorkQueueException(); /* TODO can that happen? */
+        idle.notifyOne();
+    }
+
+    /* Pushes an item from within a work function, so that with
+     * work stealing on it goes on this worker's own deque.
+     */
+    void push(unsigned int threadId, WorkItem parameter)
+    {
+        Worker *worker = getWorker(threadId);
+        if (worker)
+        {
+            worker->deque.push(parameter);
+            idle.notifyOne(); /* so somebody can steal it */
+        }
+        else push(parameter);
+    }
+
+    /* Pushes an item with a priority (see enablePriorities()).
+     * Without priorities, it's the same as the above.
+     */
+    void push(unsigned int threadId, WorkItem parameter, unsigned int priority)
+    {
+        if (priorityQueues.empty())
+        {
+            push(threadId, parameter);
+        }
+        else if (priority < priorityQueues.size())
+        {
+            if (!priorityQueues[priority]->push(parameter)) throw AFK_WorkQueueException();
+            idle.notifyOne();
+        }
+        else
+        {
+            push(parameter);
+        }
+    }
+
+    /* Parking for idle workers (see AFK_EventCount).  A worker
+     * that's found nothing to consume calls prepareWait(), tries
+     * once more, and then either cancelWait()s or park()s.
+     */
+    AFK_EventCount::Key prepareWait(void)
+    {
+        return idle.prepareWait();
+    }
+
+    void cancelWait(void)
+    {
+        idle.cancelWait();
+    }
+
+    void park(AFK_EventCount::Key key)
+    {
+        idle.wait(key);
+    }
+
+    /* Wakes all the parked workers, e.g. when the task has
+     * finished.
+     */
+    void wakeAll(void)
+    {
+        idle.notifyAll();
     }
 };
 
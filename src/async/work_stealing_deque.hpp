@@ -0,0 +1,154 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#ifndef _AFK_ASYNC_WORK_STEALING_DEQUE_H_
+#define _AFK_ASYNC_WORK_STEALING_DEQUE_H_
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include <boost/atomic.hpp>
+
+/* A Chase-Lev work-stealing deque (after the C11 version in Le et
+ * al., "Correct and Efficient Work-Stealing for Weak Memory Models").
+ * The owning thread pushes and takes at the bottom (so it works
+ * depth first, on whatever it pushed most recently); any other
+ * thread may steal from the top.
+ *
+ * T needs to be trivially copyable: a thief may read an item that's
+ * being overwritten, but it'll then lose the race on `top' and
+ * throw it away.
+ * Buffers that have been grown out of are kept until the deque goes
+ * away, since a thief might still be reading one.
+ */
+template<typename T>
+class AFK_WorkStealingDeque
+{
+protected:
+    class Buffer
+    {
+    public:
+        const int64_t size;
+        T *items;
+
+        Buffer(int64_t _size): size(_size), items(new T[_size]) {}
+        virtual ~Buffer() { delete[] items; }
+
+        T get(int64_t i) const { return items[i & (size - 1)]; }
+        void put(int64_t i, const T& item) { items[i & (size - 1)] = item; }
+    };
+
+    boost::atomic<int64_t> top;
+    boost::atomic<int64_t> bottom;
+    boost::atomic<Buffer*> buffer;
+
+    /* Only the owner touches this. */
+    std::vector<Buffer*> oldBuffers;
+
+    Buffer *grow(Buffer *old, int64_t t, int64_t b)
+    {
+        Buffer *bigger = new Buffer(old->size * 2);
+        for (int64_t i = t; i < b; ++i) bigger->put(i, old->get(i));
+        oldBuffers.push_back(old);
+        buffer.store(bigger, boost::memory_order_release);
+        return bigger;
+    }
+
+public:
+    /* `initialSize' must be a power of two. */
+    AFK_WorkStealingDeque(int64_t initialSize = 256):
+        top(0), bottom(0), buffer(new Buffer(initialSize))
+    {
+        assert((initialSize & (initialSize - 1)) == 0);
+    }
+
+    virtual ~AFK_WorkStealingDeque()
+    {
+        delete buffer.load();
+        for (auto b : oldBuffers) delete b;
+    }
+
+    /* Owner only. */
+    void push(const T& item)
+    {
+        int64_t b = bottom.load(boost::memory_order_relaxed);
+        int64_t t = top.load(boost::memory_order_acquire);
+        Buffer *buf = buffer.load(boost::memory_order_relaxed);
+        if (b - t > buf->size - 1) buf = grow(buf, t, b);
+        buf->put(b, item);
+        boost::atomic_thread_fence(boost::memory_order_release);
+        bottom.store(b + 1, boost::memory_order_relaxed);
+    }
+
+    /* Owner only.  Returns true and fills out `o_item' if there
+     * was something to take, else false.
+     */
+    bool take(T& o_item)
+    {
+        int64_t b = bottom.load(boost::memory_order_relaxed) - 1;
+        Buffer *buf = buffer.load(boost::memory_order_relaxed);
+        bottom.store(b, boost::memory_order_relaxed);
+        boost::atomic_thread_fence(boost::memory_order_seq_cst);
+        int64_t t = top.load(boost::memory_order_relaxed);
+
+        if (t > b)
+        {
+            /* It was empty. */
+            bottom.store(b + 1, boost::memory_order_relaxed);
+            return false;
+        }
+
+        o_item = buf->get(b);
+        if (t == b)
+        {
+            /* That was the last one: race the thieves for it. */
+            bool won = top.compare_exchange_strong(t, t + 1,
+                boost::memory_order_seq_cst, boost::memory_order_relaxed);
+            bottom.store(b + 1, boost::memory_order_relaxed);
+            return won;
+        }
+
+        return true;
+    }
+
+    /* Anyone.  Returns true and fills out `o_item' if it stole
+     * something, else false (the deque was empty or someone else
+     * got there first.)
+     */
+    bool steal(T& o_item)
+    {
+        int64_t t = top.load(boost::memory_order_acquire);
+        boost::atomic_thread_fence(boost::memory_order_seq_cst);
+        int64_t b = bottom.load(boost::memory_order_acquire);
+
+        if (t >= b) return false;
+
+        Buffer *buf = buffer.load(boost::memory_order_acquire);
+        o_item = buf->get(t);
+        return top.compare_exchange_strong(t, t + 1,
+            boost::memory_order_seq_cst, boost::memory_order_relaxed);
+    }
+
+    /* Approximate, of course. */
+    bool empty(void) const
+    {
+        return (bottom.load(boost::memory_order_relaxed) <= top.load(boost::memory_order_relaxed));
+    }
+};
+
+#endif /* _AFK_ASYNC_WORK_STEALING_DEQUE_H_ */
@@ -24,6 +24,10 @@
 #include "core.hpp"
 #include "ui/config_settings.hpp"
 
+#if AFK_CAMERA_SSE
+#include <emmintrin.h>
+#endif
+
 void AFK_Camera::updateProjection(void)
 {
     /* Magic perspective projection. */
@@ -92,6 +96,25 @@ float AFK_Camera::getDetailPitchAsSeen(
         std::max<float>(std::min<float>(distanceToViewer, zFar), zNear));
 }
 
+void AFK_Camera::getDetailPitchBoundsAsSeen(
+    float objectScale,
+    const Vec3<float>& objectLocation,
+    float radius,
+    const Vec3<float>& viewerLocation,
+    float& o_detailPitch,
+    float& o_minDetailPitch,
+    float& o_maxDetailPitch) const
+{
+    float distanceToViewer = (objectLocation - (viewerLocation - separation)).magnitude();
+    float numerator = windowHeight * objectScale;
+    o_detailPitch = numerator / (tanHalfFov *
+        std::max<float>(std::min<float>(distanceToViewer, zFar), zNear));
+    o_minDetailPitch = numerator / (tanHalfFov *
+        std::max<float>(std::min<float>(distanceToViewer + radius, zFar), zNear));
+    o_maxDetailPitch = numerator / (tanHalfFov *
+        std::max<float>(std::min<float>(distanceToViewer - radius, zFar), zNear));
+}
+
 bool AFK_Camera::projectedPointIsVisible(const Vec4<float>& projectedPoint) const
 {
     return (
@@ -101,6 +124,105 @@ bool AFK_Camera::projectedPointIsVisible(const Vec4<float>& projectedPoint) cons
         (projectedPoint.v[1] / projectedPoint.v[2]) <= 1.0f);
 }
 
+/* The SSE versions of these do everything in the same order as the
+ * scalar ones, so that they come out exactly the same.
+ */
+void AFK_Camera::getDetailPitchesAsSeen(
+    float objectScale,
+    const float *xs, const float *ys, const float *zs,
+    unsigned int count,
+    const Vec3<float>& viewerLocation,
+    float *o_detailPitches) const
+{
+    Vec3<float> lens = viewerLocation - separation;
+    unsigned int i = 0;
+
+#if AFK_CAMERA_SSE
+    __m128 lensX = _mm_set1_ps(lens.v[0]);
+    __m128 lensY = _mm_set1_ps(lens.v[1]);
+    __m128 lensZ = _mm_set1_ps(lens.v[2]);
+    __m128 minDistance = _mm_set1_ps(zNear);
+    __m128 maxDistance = _mm_set1_ps(zFar);
+    __m128 numerator = _mm_set1_ps((float)windowHeight * objectScale);
+    __m128 thf = _mm_set1_ps(tanHalfFov);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(xs + i), lensX);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(ys + i), lensY);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(zs + i), lensZ);
+        __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+        __m128 clamped = _mm_max_ps(_mm_min_ps(distance, maxDistance), minDistance);
+        _mm_storeu_ps(o_detailPitches + i, _mm_div_ps(numerator, _mm_mul_ps(thf, clamped)));
+    }
+#endif
+
+    for (; i < count; ++i)
+        o_detailPitches[i] = getDetailPitchAsSeen(objectScale, afk_vec3<float>(xs[i], ys[i], zs[i]), viewerLocation);
+}
+
+void AFK_Camera::testPointsVisible(
+    const float *xs, const float *ys, const float *zs,
+    unsigned int count,
+    bool *o_visible) const
+{
+    unsigned int i = 0;
+
+#if AFK_CAMERA_SSE
+    /* I only need the x, y and z rows of the projection
+     * (the points all have w=1).
+     */
+    __m128 m[3][4];
+    for (int r = 0; r < 3; ++r)
+        for (int c = 0; c < 4; ++c)
+            m[r][c] = _mm_set1_ps(projection.m[r][c]);
+
+    __m128 maxX = _mm_set1_ps(ar);
+    __m128 minX = _mm_set1_ps(-ar);
+    __m128 maxY = _mm_set1_ps(1.0f);
+    __m128 minY = _mm_set1_ps(-1.0f);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(xs + i);
+        __m128 y = _mm_loadu_ps(ys + i);
+        __m128 z = _mm_loadu_ps(zs + i);
+
+        __m128 p[3];
+        for (int r = 0; r < 3; ++r)
+        {
+            p[r] = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(m[r][0], x), _mm_mul_ps(m[r][1], y)), _mm_mul_ps(m[r][2], z)), m[r][3]);
+        }
+
+        __m128 px = _mm_div_ps(p[0], p[2]);
+        __m128 py = _mm_div_ps(p[1], p[2]);
+        __m128 visible = _mm_and_ps(
+            _mm_and_ps(_mm_cmpge_ps(px, minX), _mm_cmple_ps(px, maxX)),
+            _mm_and_ps(_mm_cmpge_ps(py, minY), _mm_cmple_ps(py, maxY)));
+
+        int mask = _mm_movemask_ps(visible);
+        for (int j = 0; j < 4; ++j)
+            o_visible[i + j] = ((mask & (1 << j)) != 0);
+    }
+#endif
+
+    for (; i < count; ++i)
+        o_visible[i] = projectedPointIsVisible(projection * afk_vec4<float>(xs[i], ys[i], zs[i], 1.0f));
+}
+
+Vec3<float> AFK_Camera::getEyeLocation(void) const
+{
+    /* This is the point that the projection above takes to the
+     * view space origin.
+     */
+    Vec4<float> rotatedSeparation = getRotationMatrix() * afk_vec4<float>(
+        separation.v[0], separation.v[1], separation.v[2], 0.0f);
+    return translation - afk_vec3<float>(
+        rotatedSeparation.v[0], rotatedSeparation.v[1], rotatedSeparation.v[2]);
+}
+
 void AFK_Camera::driveAndUpdateProjection(const Vec3<float>& velocity, const Vec3<float>& axisDisplacement)
 {
     drive(velocity, axisDisplacement);
@@ -21,6 +21,16 @@
 #include "def.hpp"
 #include "object.hpp"
 
+/* The batch versions of the point tests below do four points at a
+ * time with SSE, where the compiler's allowed it.  (Set this to 0 to
+ * compare with the scalar versions: they give the same answers.)
+ */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AFK_CAMERA_SSE 1
+#else
+#define AFK_CAMERA_SSE 0
+#endif
+
 class AFK_Camera: protected AFK_Object
 {
 protected:
@@ -64,9 +74,43 @@ public:
      */
     float getDetailPitchAsSeen(float objectScale, const Vec3<float>& objectLocation, const Vec3<float>& viewerLocation) const;
 
+    /* The same, at the centre of a sphere of radius `radius', along
+     * with the least and greatest detail pitch that anything of that
+     * scale within the sphere could have.
+     */
+    void getDetailPitchBoundsAsSeen(
+        float objectScale,
+        const Vec3<float>& objectLocation,
+        float radius,
+        const Vec3<float>& viewerLocation,
+        float& o_detailPitch,
+        float& o_minDetailPitch,
+        float& o_maxDetailPitch) const;
+
     /* Checks whether a projected point will be visible or not. */
     bool projectedPointIsVisible(const Vec4<float>& projectedPoint) const;
 
+    /* The batch versions of those: `count' points, with their x, y
+     * and z co-ordinates in separate arrays.
+     * This one projects the points as well.
+     */
+    void getDetailPitchesAsSeen(
+        float objectScale,
+        const float *xs, const float *ys, const float *zs,
+        unsigned int count,
+        const Vec3<float>& viewerLocation,
+        float *o_detailPitches) const;
+
+    void testPointsVisible(
+        const float *xs, const float *ys, const float *zs,
+        unsigned int count,
+        bool *o_visible) const;
+
+    /* Where the lens is in world space (the drive point plus the
+     * separation).
+     */
+    Vec3<float> getEyeLocation(void) const;
+
     void driveAndUpdateProjection(const Vec3<float>& velocity, const Vec3<float>& axisDisplacement);
     Vec2<float> getWindowSize(void) const { return windowSize; }
     Mat4<float> getProjection(void) const { return projection; }
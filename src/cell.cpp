@@ -17,6 +17,7 @@
 
 #include "afk.hpp"
 
+#include <cassert>
 #include <cmath>
 #include <sstream>
 
@@ -220,3 +221,94 @@ std::ostream& operator<<(std::ostream& os, const AFK_Cell& cell)
         cell.coord.v[3] << ")";
 }
 
+
+/* AFK_PackedCell implementation */
+
+Vec3<int64_t> afk_packedCellOrigin = afk_vec3<int64_t>(0, 0, 0);
+
+void afk_rebasePackedCells(const Vec3<int64_t>& _origin)
+{
+    afk_packedCellOrigin = _origin;
+}
+
+unsigned int afk_packScale(int64_t scale)
+{
+    assert(scale > 0 && (scale & (scale - 1)) == 0);
+
+    uint64_t s = static_cast<uint64_t>(scale);
+    unsigned int l = 0;
+    if (s >= (1ull << 32)) { s >>= 32; l += 32; }
+    if (s >= (1ull << 16)) { s >>= 16; l += 16; }
+    if (s >= (1ull << 8)) { s >>= 8; l += 8; }
+    if (s >= (1ull << 4)) { s >>= 4; l += 4; }
+    if (s >= (1ull << 2)) { s >>= 2; l += 2; }
+    if (s >= (1ull << 1)) { l += 1; }
+    return l;
+}
+
+bool afk_isPackable(const AFK_Cell& cell)
+{
+    int64_t scale = cell.coord.v[3];
+    if (scale < 2 || (scale & (scale - 1)) != 0) return false;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        int64_t offset = cell.coord.v[i] - afk_packedCellOrigin.v[i];
+        if ((offset & (scale - 1)) != 0) return false;
+        if (offset < -AFK_PACKED_CELL_RANGE || offset + scale > AFK_PACKED_CELL_RANGE) return false;
+    }
+
+    return true;
+}
+
+AFK_PackedCell afk_packedCell(const AFK_Cell& cell)
+{
+    AFK_PackedCell packed;
+    if (cell == afk_unassignedCell)
+    {
+        packed.v = 0;
+    }
+    else
+    {
+        assert(afk_isPackable(cell));
+        int64_t scale = cell.coord.v[3];
+        packed.v =
+            afk_packSigned(cell.coord.v[0] - afk_packedCellOrigin.v[0] + scale / 2,
+                0, AFK_PACKED_CELL_X_BITS) |
+            afk_packSigned((cell.coord.v[1] - afk_packedCellOrigin.v[1]) / 2,
+                AFK_PACKED_CELL_X_BITS, AFK_PACKED_CELL_YZ_BITS) |
+            afk_packSigned((cell.coord.v[2] - afk_packedCellOrigin.v[2]) / 2,
+                AFK_PACKED_CELL_X_BITS + AFK_PACKED_CELL_YZ_BITS, AFK_PACKED_CELL_YZ_BITS);
+    }
+
+    return packed;
+}
+
+AFK_Cell afk_cell(const AFK_PackedCell& packed)
+{
+    if (packed == afk_unassignedPackedCell) return afk_unassignedCell;
+
+    /* The lowest set bit of the x field is half the scale. */
+    int64_t xField = afk_unpackSigned(packed.v, 0, AFK_PACKED_CELL_X_BITS);
+    int64_t halfScale = xField & -xField;
+
+    return afk_cell(afk_vec4<int64_t>(
+        afk_packedCellOrigin.v[0] + xField - halfScale,
+        afk_packedCellOrigin.v[1] + 2 * afk_unpackSigned(packed.v,
+            AFK_PACKED_CELL_X_BITS, AFK_PACKED_CELL_YZ_BITS),
+        afk_packedCellOrigin.v[2] + 2 * afk_unpackSigned(packed.v,
+            AFK_PACKED_CELL_X_BITS + AFK_PACKED_CELL_YZ_BITS, AFK_PACKED_CELL_YZ_BITS),
+        2 * halfScale));
+}
+
+const AFK_PackedCell afk_unassignedPackedCell = { 0 };
+
+size_t hash_value(const AFK_PackedCell& packed)
+{
+    return afk_hash_swizzle(0, packed.v);
+}
+
+std::ostream& operator<<(std::ostream& os, const AFK_PackedCell& packed)
+{
+    return os << "Packed" << afk_cell(packed);
+}
@@ -20,6 +20,7 @@
 
 #include "afk.hpp"
 
+#include <cstdint>
 #include <iostream>
 
 #include <boost/static_assert.hpp>
@@ -182,5 +183,91 @@ BOOST_STATIC_ASSERT((boost::has_trivial_assign<AFK_Cell>::value));
 BOOST_STATIC_ASSERT((boost::has_trivial_constructor<AFK_Cell>::value));
 BOOST_STATIC_ASSERT((boost::has_trivial_destructor<AFK_Cell>::value));
 
+
+/* A PackedCell is a Cell squashed into 64 bits, for keying the
+ * world cache and for passing around in the work queue: it's a
+ * quarter of the size, and hashing and comparing it is one
+ * operation on one word.
+ * It only takes the cells the world actually makes: scale a power
+ * of two and at least 2, and each coordinate a multiple of the
+ * scale (relative to afk_packedCellOrigin).  That means the low
+ * bit of every coordinate is always clear, so I don't store it,
+ * and the scale needn't be stored separately either: the x field
+ * holds x + scale/2, whose lowest set bit is scale/2.  Above that
+ * are y/2 and z/2.  All three are signed offsets from the origin,
+ * and together they fill the word.  (Zero is the unassigned value;
+ * no cell packs to it, because the x field is never zero.)
+ * afk_isPackable() checks that a cell is aligned and lies wholly
+ * within AFK_PACKED_CELL_RANGE of the origin along each axis --
+ * that's 2,097,152 smallest-cell steps, which takes in the whole
+ * 3x3x3 block of top cells that updateWorld() starts from with the
+ * default zFar (2^20, which makes the top cells 2^19 across).
+ * The AFK_World constructor refuses a maxDistance that would need
+ * a bigger block than that.
+ * Going further afield would need a rebase: empty out everything
+ * that's holding packed cells or tiles, then call
+ * afk_rebasePackedCells() with an origin nearer by, aligned to
+ * the largest cell scale.  (Anything packed against the old origin
+ * unpacks wrong against the new one.)  Nothing does that yet.
+ */
+#define AFK_PACKED_CELL_X_BITS 22
+#define AFK_PACKED_CELL_YZ_BITS 21
+#define AFK_PACKED_CELL_RANGE (1ll << (AFK_PACKED_CELL_X_BITS - 1))
+
+class AFK_PackedCell
+{
+public:
+    uint64_t v;
+
+    bool operator==(const AFK_PackedCell& _cell) const { return v == _cell.v; }
+    bool operator==(const AFK_PackedCell& _cell) const volatile { return v == _cell.v; }
+    bool operator!=(const AFK_PackedCell& _cell) const { return v != _cell.v; }
+};
+
+/* The origin that cells (and tiles, which use its x and z) are
+ * packed relative to.  Only change it with afk_rebasePackedCells().
+ */
+extern Vec3<int64_t> afk_packedCellOrigin;
+void afk_rebasePackedCells(const Vec3<int64_t>& _origin);
+
+bool afk_isPackable(const AFK_Cell& cell);
+
+AFK_PackedCell afk_packedCell(const AFK_Cell& cell);
+AFK_Cell afk_cell(const AFK_PackedCell& packed);
+
+extern const AFK_PackedCell afk_unassignedPackedCell;
+
+size_t hash_value(const AFK_PackedCell& packed);
+
+struct AFK_HashPackedCell
+{
+    size_t operator()(const AFK_PackedCell& packed) const { return hash_value(packed); }
+};
+
+std::ostream& operator<<(std::ostream& os, const AFK_PackedCell& packed);
+
+/* Shared by the packed types: the log2 of a scale that's a
+ * power of two, and the signed field of `bits' bits at `shift'.
+ */
+unsigned int afk_packScale(int64_t scale);
+
+inline int64_t afk_unpackSigned(uint64_t v, unsigned int shift, unsigned int bits)
+{
+    return static_cast<int64_t>(v << (64 - shift - bits)) >> (64 - bits);
+}
+
+inline uint64_t afk_packSigned(int64_t field, unsigned int shift, unsigned int bits)
+{
+    return (static_cast<uint64_t>(field) & ((1ull << bits) - 1)) << shift;
+}
+
+#define AFK_PACKED_SCALE_BITS 6
+#define AFK_PACKED_SCALE_MASK ((1ull << AFK_PACKED_SCALE_BITS) - 1)
+
+BOOST_STATIC_ASSERT((sizeof(AFK_PackedCell) == sizeof(uint64_t)));
+BOOST_STATIC_ASSERT((boost::has_trivial_assign<AFK_PackedCell>::value));
+BOOST_STATIC_ASSERT((boost::has_trivial_constructor<AFK_PackedCell>::value));
+BOOST_STATIC_ASSERT((boost::has_trivial_destructor<AFK_PackedCell>::value));
+
 #endif /* _AFK_CELL_H_ */
 
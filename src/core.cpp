@@ -21,6 +21,7 @@
 
 #include <boost/random/random_device.hpp>
 
+#include "async/thread_affinity.hpp"
 #include "camera.hpp"
 #include "computer.hpp"
 #include "core.hpp"
@@ -33,6 +34,7 @@
 #include "rng/boost_taus88.hpp"
 #include "rng/rng.hpp"
 #include "test_jigsaw.hpp"
+#include "trace.hpp"
 #include "window_glx.hpp"
 #include "window_wgl.hpp"
 #include "world.hpp"
@@ -113,26 +115,44 @@ void afk_idle(void)
          */
     }
 
-    if (!afk_core.computingUpdateDelayed)
-    {
-        /* Update the world, deciding which bits of it I'm going
-         * to draw.
-         */
-        afk_core.computingUpdate = afk_core.world->updateWorld(
-            afk_core.camera, afk_core.protagonist.object, afk_core.detailAdjuster->getDetailPitch());
+    if (afk_core.settings.pipelineFrames) afk_core.updateAndDisplayPipelined();
+    else afk_core.updateAndDisplay();
+}
 
-        /* Meanwhile, draw the previous frame */
-        afk_display(afk_core.masterThreadId);
-    }
+void AFK_Core::deleteGlGarbageBufs(void)
+{
+    static std::vector<GLuint> bufs;
+    GLuint buf;
+    while (glGarbageBufs.pop(buf))
+        bufs.push_back(buf);
 
-    /* Clean up anything that's gotten queued into the garbage queue */
-    /* TODO take this out, enable the workers to delete their own
-     * GL garbage
+    if (bufs.size() > 0)
+        glDeleteBuffers(static_cast<GLsizei>(bufs.size()), &bufs[0]);
+    bufs.clear();
+}
+
+/* The definition of AFK_Core itself. */
+
+void AFK_Core::startUpdate(void)
+{
+    /* Update the world, deciding which bits of it I'm going
+     * to draw.
      */
-    afk_core.deleteGlGarbageBufs();
+    AFK_TRACE_BEGIN(masterThreadId, "updateWorld")
+    computingCameraTime = afk_clock::now();
+    computingUpdate = world->updateWorld(
+        camera,
+        protagonist.object,
+        detailAdjuster->getDetailPitch(),
+        detailAdjuster->getComputeDeadline(computingCameraTime));
+    AFK_TRACE_END(masterThreadId, "updateWorld")
+}
 
+std::future_status AFK_Core::waitForUpdate(void)
+{
     /* Wait until it's about time to display the next frame. */
-    afk_duration_mfl computeWaitTime = afk_core.detailAdjuster->getComputeWaitTime();
+    afk_duration_mfl computeWaitTime = detailAdjuster->getComputeWaitTime();
+    AFK_TRACE_BEGIN(masterThreadId, "waitForCompute")
 #ifdef _WIN32
     /* TODO: There appears to be an issue with the Visual Studio 2013
      * future implementation and this floating point duration value,
@@ -140,61 +160,157 @@ void afk_idle(void)
      */
     std::chrono::microseconds computeWaitTimeMicros =
         std::chrono::duration_cast<std::chrono::microseconds>(computeWaitTime);
-    std::future_status status = afk_core.computingUpdate.wait_for(computeWaitTimeMicros);
+    std::future_status status = computingUpdate.wait_for(computeWaitTimeMicros);
 #else
-    std::future_status status = afk_core.computingUpdate.wait_for(computeWaitTime);
+    std::future_status status = computingUpdate.wait_for(computeWaitTime);
 #endif
+    AFK_TRACE_END(masterThreadId, "waitForCompute")
 
     switch (status)
     {
     case std::future_status::ready:
-        {
-            afk_core.detailAdjuster->computeFinished();
-
-            /* Flip the buffers and bump the computing frame */
-            afk_core.window->swapBuffers();
-            afk_core.renderingFrame = afk_core.computingFrame;
-            afk_core.computingFrame.increment();
-            afk_core.world->flipRenderQueues(afk_core.computingFrame);
-            afk_core.computingUpdateDelayed = false;
-
-#if FRAME_NUMBER_DEBUG || AFK_SHAPE_ENUM_DEBUG
-            AFK_DEBUG_PRINTL("Now computing frame " << afk_core.computingFrame)
-#endif
-        
-            break;
-        }
+        break;
 
     case std::future_status::timeout:
-        {
-            /* Flag this update as delayed. */
-            afk_core.computingUpdateDelayed = true;
-            afk_core.detailAdjuster->computeTimedOut();
-            break;
-        }
+        detailAdjuster->computeTimedOut();
+        break;
 
     default:
         throw AFK_Exception("Unexpected future_status received");
     }
+
+    return status;
 }
 
+void AFK_Core::swapBuffers(void)
+{
+    window->swapBuffers();
 
-void AFK_Core::deleteGlGarbageBufs(void)
+    /* That's when the user gets to see what the camera saw. */
+    if (renderingCameraTime != afk_clock::time_point())
+    {
+        latencySum += std::chrono::duration_cast<afk_duration_mfl>(
+            afk_clock::now() - renderingCameraTime).count();
+        ++latencyCount;
+    }
+}
+
+bool AFK_Core::commitUpdate(void)
 {
-    static std::vector<GLuint> bufs;
-    GLuint buf;
-    while (glGarbageBufs.pop(buf))
-        bufs.push_back(buf);
+    if (haveReadyFrame) return false;
+    if (computingUpdate.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
 
-    if (bufs.size() > 0)
-        glDeleteBuffers(static_cast<GLsizei>(bufs.size()), &bufs[0]);
-    bufs.clear();
+    AFK_TRACE_SCOPE(masterThreadId, "commitFrame")
+    detailAdjuster->computeFinished();
+    world->enumerationFinished(computingUpdate.get());
+
+    readyFrame = computingFrame;
+    readyCameraTime = computingCameraTime;
+    haveReadyFrame = true;
+
+    computingFrame.increment();
+    world->commitRenderQueues(computingFrame);
+
+#if FRAME_NUMBER_DEBUG || AFK_SHAPE_ENUM_DEBUG
+    AFK_DEBUG_PRINTL("Now computing frame " << computingFrame)
+#endif
+
+    /* The workers needn't wait for me to draw. */
+    startUpdate();
+    return true;
 }
 
-/* The definition of AFK_Core itself. */
+void AFK_Core::updateAndDisplay(void)
+{
+    if (!computingUpdateDelayed)
+    {
+        startUpdate();
+
+        /* Meanwhile, draw the previous frame */
+        AFK_TRACE_BEGIN(masterThreadId, "display")
+        afk_display(masterThreadId);
+        AFK_TRACE_END(masterThreadId, "display")
+    }
+
+    /* Clean up anything that's gotten queued into the garbage queue */
+    /* TODO take this out, enable the workers to delete their own
+     * GL garbage
+     */
+    AFK_TRACE_BEGIN(masterThreadId, "deleteGlGarbage")
+    deleteGlGarbageBufs();
+    AFK_TRACE_END(masterThreadId, "deleteGlGarbage")
+
+    if (waitForUpdate() == std::future_status::ready)
+    {
+        AFK_TRACE_SCOPE(masterThreadId, "flipFrame")
+        detailAdjuster->computeFinished();
+        world->enumerationFinished(computingUpdate.get());
+
+        /* Flip the buffers and bump the computing frame */
+        swapBuffers();
+        renderingFrame = computingFrame;
+        renderingCameraTime = computingCameraTime;
+        computingFrame.increment();
+        world->flipRenderQueues(computingFrame);
+        computingUpdateDelayed = false;
+
+#if FRAME_NUMBER_DEBUG || AFK_SHAPE_ENUM_DEBUG
+        AFK_DEBUG_PRINTL("Now computing frame " << computingFrame)
+#endif
+    }
+    else
+    {
+        /* Flag this update as delayed. */
+        computingUpdateDelayed = true;
+    }
+}
+
+void AFK_Core::updateAndDisplayPipelined(void)
+{
+    if (!computingUpdate.valid()) startUpdate();
+    commitUpdate();
+
+    if (haveReadyFrame)
+    {
+        AFK_TRACE_BEGIN(masterThreadId, "display")
+        world->promoteRenderQueues();
+        renderingFrame = readyFrame;
+        renderingCameraTime = readyCameraTime;
+        haveReadyFrame = false;
+
+        afk_display(masterThreadId);
+        AFK_TRACE_END(masterThreadId, "display")
+
+        AFK_TRACE_BEGIN(masterThreadId, "deleteGlGarbage")
+        deleteGlGarbageBufs();
+        AFK_TRACE_END(masterThreadId, "deleteGlGarbage")
+
+        swapBuffers();
+
+        /* If the workers finished while I was drawing, get them
+         * going on the next one straight away, and I'll have
+         * something ready for next time.
+         */
+        commitUpdate();
+    }
+    else
+    {
+        AFK_TRACE_BEGIN(masterThreadId, "deleteGlGarbage")
+        deleteGlGarbageBufs();
+        AFK_TRACE_END(masterThreadId, "deleteGlGarbage")
+
+        /* Nothing to draw: wait for the workers.  If they finish,
+         * the next time round will commit it.
+         */
+        waitForUpdate();
+    }
+}
 
 AFK_Core::AFK_Core():
     computingUpdateDelayed(false),
+    haveReadyFrame(false),
+    latencySum(0.0f),
+    latencyCount(0),
     detailAdjuster(nullptr),
     glGarbageBufs(1000),
     computer(nullptr),
@@ -244,6 +360,11 @@ void AFK_Core::configure(int *argcp, char **argv)
         throw AFK_Exception("Failed to parse command line");
     }
 
+    /* Work out where the threads go.  I don't pin myself until
+     * loop(), though.
+     */
+    afk_threadAffinity.configure(settings.pinThreads, settings.workerNumaNode);
+
     rng = new AFK_Boost_Taus88_RNG();
 
     /* The special value -1 means no seed has been supplied, so I need to make one.
@@ -314,6 +435,14 @@ void AFK_Core::loop(void)
     computer = new AFK_Computer(settings);
     computer->loadPrograms(settings);
 
+    /* I'm the master thread, so this is where I go.  I leave it
+     * until now because the GL and CL drivers start threads of their
+     * own when the window and the computer set up their contexts,
+     * and those inherit my mask: pinning any earlier would squash
+     * them all onto my one core.
+     */
+    afk_threadAffinity.pinMaster();
+
 #if JIGSAW_TEST
     afk_testJigsaw(computer, config);
 #endif
@@ -383,6 +512,12 @@ void AFK_Core::checkpoint(const afk_clock::time_point& now, bool definitely)
         afk_out << "AFK: Since last checkpoint: " << std::dec << renderingFrame - frameAtLastCheckpoint << " frames";
         float fps = (float)(renderingFrame - frameAtLastCheckpoint) * 1000.0f / sinceLastCheckpoint.count();
         afk_out << " (" << fps << " frames/second)" << std::endl;
+        if (latencyCount > 0)
+        {
+            afk_out << "AFK: Average input latency (camera to swap): " << latencySum / (float)latencyCount << " millis" << std::endl;
+            latencySum = 0.0f;
+            latencyCount = 0;
+        }
 
         assert(detailAdjuster);
         detailAdjuster->checkpoint(sinceLastCheckpoint);
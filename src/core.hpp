@@ -39,6 +39,7 @@
 #include "light.hpp"
 #include "ui/config_settings.hpp"
 #include "window.hpp"
+#include "work.hpp"
 
 
 /* Forward declare a pile of stuff, to avoid this header file depending
@@ -63,9 +64,26 @@ protected:
     /* The result we're currently waiting on from the computing
      * side of things, if there is one.
      */
-    std::future<bool> computingUpdate;
+    std::future<struct AFK_WorldWorkResult> computingUpdate;
     bool computingUpdateDelayed;
 
+    /* With settings.pipelineFrames, a frame can have finished
+     * computing and be waiting to be drawn while the next one
+     * computes.  This is it.
+     */
+    bool haveReadyFrame;
+    AFK_Frame readyFrame;
+
+    /* When the camera was sampled for the frames at each stage,
+     * so that I can measure the input latency (camera to buffer
+     * swap) that the pipelining costs.
+     */
+    afk_clock::time_point computingCameraTime;
+    afk_clock::time_point readyCameraTime;
+    afk_clock::time_point renderingCameraTime;
+    float latencySum;
+    unsigned int latencyCount;
+
     AFK_DetailAdjuster *detailAdjuster;
 
     /* This stuff is for the OpenGL buffer cleanup, glBuffersForDeletion()
@@ -75,6 +93,24 @@ protected:
 
     void deleteGlGarbageBufs(void);
 
+    /* The pieces of afk_idle(). */
+    void startUpdate(void);
+    std::future_status waitForUpdate(void);
+    void swapBuffers(void);
+
+    /* Moves a finished update into the ready slot and starts
+     * the next one, if there's room.  Returns true if it did.
+     */
+    bool commitUpdate(void);
+
+    /* The two ways of doing a frame.  In lockstep, the next
+     * frame is computed while this one is drawn, and the buffers
+     * are swapped when they're both done.  Pipelined, drawing
+     * uses the ready slot and never waits for the computing.
+     */
+    void updateAndDisplay(void);
+    void updateAndDisplayPipelined(void);
+
 public:
     /* General things. */
     AFK_ConfigSettings  settings;
@@ -188,10 +224,10 @@ extern AFK_GetComputingFrame afk_getComputingFrameFunc;
  * temporarily really small.  Better hashBits values for world and
  * landscape are 22 and 16 respectively
  */
-#define AFK_WORLD_CACHE AFK_EvictableCache<AFK_Cell, AFK_WorldCell, AFK_HashCell, afk_unassignedCell, 20, 60, afk_getComputingFrameFunc>
-#define AFK_LANDSCAPE_CACHE AFK_EvictableCache<AFK_Tile, AFK_LandscapeTile, AFK_HashTile, afk_unassignedTile, 16, 10, afk_getComputingFrameFunc>
-#define AFK_SHAPE_CELL_CACHE AFK_EvictableCache<AFK_KeyedCell, AFK_ShapeCell, AFK_HashKeyedCell, afk_unassignedKeyedCell, 16, 10, afk_getComputingFrameFunc>
-#define AFK_VAPOUR_CELL_CACHE AFK_EvictableCache<AFK_KeyedCell, AFK_VapourCell, AFK_HashKeyedCell, afk_unassignedKeyedCell, 16, 10, afk_getComputingFrameFunc>
+#define AFK_WORLD_CACHE AFK_EvictableCache<AFK_PackedCell, AFK_WorldCell, AFK_HashPackedCell, afk_unassignedPackedCell, 20, 60, afk_getComputingFrameFunc>
+#define AFK_LANDSCAPE_CACHE AFK_EvictableCache<AFK_PackedTile, AFK_LandscapeTile, AFK_HashPackedTile, afk_unassignedPackedTile, 16, 10, afk_getComputingFrameFunc>
+#define AFK_SHAPE_CELL_CACHE AFK_EvictableCache<AFK_PackedKeyedCell, AFK_ShapeCell, AFK_HashPackedKeyedCell, afk_unassignedPackedKeyedCell, 16, 10, afk_getComputingFrameFunc>
+#define AFK_VAPOUR_CELL_CACHE AFK_EvictableCache<AFK_PackedKeyedCell, AFK_VapourCell, AFK_HashPackedKeyedCell, afk_unassignedPackedKeyedCell, 16, 10, afk_getComputingFrameFunc>
 
 #endif /* _AFK_CORE_H_ */
 
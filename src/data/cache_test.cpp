@@ -26,6 +26,7 @@
 #include <boost/random/taus88.hpp>
 
 #include "cache_test.hpp"
+#include "evictable_cache.hpp"
 #include "map_cache.hpp"
 #include "polymer_cache.hpp"
 #include "../async/async.hpp"
@@ -194,3 +195,87 @@ void test_cache(void)
     //afk_out << std::endl;
 }
 
+
+
+/* The evictable cache scan test.  This fills an evictable cache
+ * the size of the world cache, and times eviction passes over it.
+ */
+
+AFK_Frame testCacheFrame;
+
+const AFK_Frame& testCache_getComputingFrame(void)
+{
+    return testCacheFrame;
+}
+
+AFK_GetComputingFrame testCache_getComputingFrameFunc = testCache_getComputingFrame;
+
+class EvictableInt
+{
+public:
+    int v;
+    EvictableInt(): v(0) {}
+
+    void evict(void) { v = 0; }
+};
+
+std::ostream& operator<<(std::ostream& os, const EvictableInt& i)
+{
+    return os << i.v;
+}
+
+#define EVICTION_TEST_HASH_BITS 20
+#define EVICTION_TEST_FRAMES 60
+#define EVICTION_TEST_PASSES 8
+
+void test_evictableCacheScan(void)
+{
+    typedef AFK_EvictableCache<
+        int,
+        EvictableInt,
+        std::function<size_t (const int&)>,
+        afk_cacheTestUnassignedKey,
+        EVICTION_TEST_HASH_BITS,
+        EVICTION_TEST_FRAMES,
+        testCache_getComputingFrameFunc> EvictionTestCache;
+
+    std::function<size_t (const int&)> hashFunc = expensivelyHashInt();
+    const int entryCount = (1 << EVICTION_TEST_HASH_BITS);
+    EvictionTestCache cache(4, hashFunc, static_cast<size_t>(entryCount), 2);
+    afk_clock::time_point startTime, endTime;
+    afk_duration_mfl timeTaken;
+
+    testCacheFrame.increment();
+    for (int i = 0; i < entryCount; ++i)
+    {
+        cache.insertAndClaim(1, i, AFK_CL_LOOP).get().v = i;
+    }
+
+    afk_out << "Evictable cache: " << cache.size() << " entries, " <<
+        sizeof(EvictionTestCache::EvictableValue) << " bytes per value, " <<
+        sizeof(AFK_FrameStamp) << " bytes per frame stamp" << std::endl;
+
+    /* This is what the evictor is doing most of the time: scanning
+     * entries that were seen too recently to go.
+     */
+    unsigned int evicted = 0;
+    startTime = afk_clock::now();
+    for (unsigned int pass = 0; pass < EVICTION_TEST_PASSES; ++pass)
+    {
+        evicted += cache.evictionPass();
+    }
+    endTime = afk_clock::now();
+    timeTaken = std::chrono::duration_cast<afk_duration_mfl>(endTime - startTime);
+    afk_out << "Evictable cache: scan with nothing to evict took " << timeTaken.count() / EVICTION_TEST_PASSES <<
+        " millis (evicted " << evicted << ")" << std::endl;
+
+    /* ...and this is a pass that gets rid of everything. */
+    for (unsigned int f = 0; f <= EVICTION_TEST_FRAMES; ++f) testCacheFrame.increment();
+    startTime = afk_clock::now();
+    evicted = cache.evictionPass();
+    endTime = afk_clock::now();
+    timeTaken = std::chrono::duration_cast<afk_duration_mfl>(endTime - startTime);
+    afk_out << "Evictable cache: scan evicting everything took " << timeTaken.count() <<
+        " millis (evicted " << evicted << ")" << std::endl;
+    cache.printStats(afk_out, "Evictable cache stats");
+}
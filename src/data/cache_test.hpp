@@ -19,6 +19,7 @@
 #define _AFK_DATA_CACHE_TEST_H_
 
 void test_cache(void);
+void test_evictableCacheScan(void);
 
 /* This needs declaring here to give it external linkage */
 extern int afk_cacheTestUnassignedKey;
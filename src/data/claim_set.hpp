@@ -0,0 +1,129 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#ifndef _AFK_DATA_CLAIM_SET_H_
+#define _AFK_DATA_CLAIM_SET_H_
+
+#include <cassert>
+#include <utility>
+#include <vector>
+
+#include "data.hpp"
+
+/* A ClaimSet is an ordered group of claims that were taken
+ * together, for example the claims on all the ancestors of a
+ * cell, coarsest LoD first.
+ * It's all-or-nothing: a set that's valid holds every claim it
+ * was asked for, and one that isn't holds none.  The claims are
+ * released (in reverse order) when the set goes away.
+ * `Claim' is any of the claim types (volatile, volatile inplace
+ * or locked).
+ */
+template<typename Claim>
+class AFK_ClaimSet
+{
+protected:
+    std::vector<Claim> claims;
+    bool valid;
+
+public:
+    AFK_ClaimSet() afk_noexcept: valid(false) {}
+
+    /* Like the claims themselves, I mustn't copy these around. */
+    AFK_ClaimSet(const AFK_ClaimSet& _set) = delete;
+    AFK_ClaimSet& operator=(const AFK_ClaimSet& _set) = delete;
+
+    /* ...but I need to be able to return them. */
+    AFK_ClaimSet(AFK_ClaimSet&& _set) afk_noexcept:
+        claims(std::move(_set.claims)), valid(_set.valid)
+    {
+        _set.claims.clear();
+        _set.valid = false;
+    }
+
+    AFK_ClaimSet& operator=(AFK_ClaimSet&& _set) afk_noexcept
+    {
+        release();
+        claims = std::move(_set.claims);
+        valid = _set.valid;
+        _set.claims.clear();
+        _set.valid = false;
+        return *this;
+    }
+
+    virtual ~AFK_ClaimSet() afk_noexcept
+    {
+        release();
+    }
+
+    /* For the benefit of whoever is filling the set out.  Reserve
+     * enough room first: claims that hold a copy of the object are
+     * expensive to shuffle about.
+     */
+    void reserve(size_t count)
+    {
+        claims.reserve(count);
+    }
+
+    void push(Claim&& claim)
+    {
+        assert(claim.isValid());
+        claims.push_back(std::move(claim));
+    }
+
+    /* Declares the set complete. */
+    void complete(void) afk_noexcept
+    {
+        valid = true;
+    }
+
+    bool isValid(void) const afk_noexcept
+    {
+        return valid;
+    }
+
+    size_t size(void) const afk_noexcept
+    {
+        return claims.size();
+    }
+
+    Claim& at(size_t i) afk_noexcept
+    {
+        assert(valid);
+        return claims[i];
+    }
+
+    const Claim& at(size_t i) const afk_noexcept
+    {
+        assert(valid);
+        return claims[i];
+    }
+
+    /* Lets go of everything, finest first. */
+    void release(void) afk_noexcept
+    {
+        while (!claims.empty())
+        {
+            if (claims.back().isValid()) claims.back().release();
+            claims.pop_back();
+        }
+
+        valid = false;
+    }
+};
+
+#endif /* _AFK_DATA_CLAIM_SET_H_ */
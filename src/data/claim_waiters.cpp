@@ -0,0 +1,61 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#include "claim_waiters.hpp"
+
+AFK_ClaimWaiters afk_claimWaiters;
+
+AFK_ClaimWaiters::AFK_ClaimWaiters():
+    parks(0), wakes(0)
+{
+    for (unsigned int b = 0; b < AFK_CLAIM_WAITER_BUCKETS; ++b)
+        buckets[b].waiting.store(0);
+}
+
+void AFK_ClaimWaiters::getStats(uint64_t& o_parks, uint64_t& o_wakes)
+{
+    o_parks = parks.exchange(0);
+    o_wakes = wakes.exchange(0);
+}
+
+void AFK_ClaimWaiters::wakeSlow(unsigned int threadId, const void *obj, Bucket& bucket)
+{
+    /* I take the waiters out under the lock, but call them
+     * outside it: they'll be enqueueing work, and they might
+     * well want to park something else.
+     */
+    std::vector<Waiter> woken;
+
+    {
+        std::unique_lock<std::mutex> lock(bucket.mut);
+        auto w = bucket.waiters.begin();
+        while (w != bucket.waiters.end())
+        {
+            if (w->obj == obj)
+            {
+                woken.push_back(*w);
+                w = bucket.waiters.erase(w);
+            }
+            else ++w;
+        }
+
+        if (!woken.empty()) bucket.waiting.fetch_sub(static_cast<unsigned int>(woken.size()));
+    }
+
+    for (auto w : woken) (*(w.func))(threadId, w.context);
+    wakes.fetch_add(woken.size());
+}
@@ -0,0 +1,123 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#ifndef _AFK_DATA_CLAIM_WAITERS_H_
+#define _AFK_DATA_CLAIM_WAITERS_H_
+
+#include <cassert>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <boost/atomic.hpp>
+
+#include "data.hpp"
+
+/* Claim waiters let whoever failed to claim something leave a
+ * callback parked on it, to be called (once) when the holder lets
+ * go, rather than going round and round trying again.  Like the
+ * reader slots, they live off to the side, hashed by the
+ * claimable's address, so the claimables themselves don't get any
+ * bigger.
+ * A releaser only looks in its bucket's list if the bucket's
+ * waiting count says there's anyone there, so releasing something
+ * that no-one's waiting for costs a load.
+ */
+
+/* A waiter is woken by the thread that released the claimable. */
+typedef void (*AFK_ClaimWaiterFunc)(unsigned int threadId, void *context);
+
+#define AFK_CLAIM_WAITER_BUCKETS 256
+
+class AFK_ClaimWaiters
+{
+protected:
+    struct Waiter
+    {
+        const void *obj;
+        AFK_ClaimWaiterFunc func;
+        void *context;
+    };
+
+    struct Bucket
+    {
+        boost::atomic<unsigned int> waiting;
+        std::mutex mut;
+        std::vector<Waiter> waiters;
+    } afk_align(64);
+
+    Bucket buckets[AFK_CLAIM_WAITER_BUCKETS];
+
+    /* Statistics. */
+    boost::atomic<uint64_t> parks;
+    boost::atomic<uint64_t> wakes;
+
+    static unsigned int bucketFor(const void *obj) afk_noexcept
+    {
+        uintptr_t p = reinterpret_cast<uintptr_t>(obj);
+        return static_cast<unsigned int>((p >> 4) ^ (p >> 12)) & (AFK_CLAIM_WAITER_BUCKETS - 1);
+    }
+
+public:
+    AFK_ClaimWaiters();
+
+    /* Parks `func' on `obj', so long as `stillBusy' (which is
+     * evaluated after I've declared myself waiting, so a release
+     * racing with this either sees me or I see it) says it's still
+     * worth waiting for.  Returns true if it parked, else false: in
+     * which case, go and try again yourself.
+     */
+    template<typename StillBusy>
+    bool park(const void *obj, AFK_ClaimWaiterFunc func, void *context, StillBusy stillBusy)
+    {
+        Bucket& bucket = buckets[bucketFor(obj)];
+        std::unique_lock<std::mutex> lock(bucket.mut);
+
+        bucket.waiting.fetch_add(1);
+        if (!stillBusy())
+        {
+            bucket.waiting.fetch_sub(1);
+            return false;
+        }
+
+        Waiter waiter;
+        waiter.obj      = obj;
+        waiter.func     = func;
+        waiter.context  = context;
+        bucket.waiters.push_back(waiter);
+        parks.fetch_add(1);
+        return true;
+    }
+
+    /* Call after releasing (any part of) a claim on `obj'. */
+    void wake(unsigned int threadId, const void *obj)
+    {
+        Bucket& bucket = buckets[bucketFor(obj)];
+        if (bucket.waiting.load() == 0) return;
+        wakeSlow(threadId, obj, bucket);
+    }
+
+    /* Gets the counts since the last call, and resets them. */
+    void getStats(uint64_t& o_parks, uint64_t& o_wakes);
+
+protected:
+    void wakeSlow(unsigned int threadId, const void *obj, Bucket& bucket);
+};
+
+extern AFK_ClaimWaiters afk_claimWaiters;
+
+#endif /* _AFK_DATA_CLAIM_WAITERS_H_ */
@@ -51,6 +51,7 @@
 #define AFK_CL_EVICTOR      16
 #define AFK_CL_SHARED       32
 #define AFK_CL_UPGRADE      64
+#define AFK_CL_READ_BIAS    128     /* with SHARED: use the reader slots (volatile claimable only) */
 
 #define AFK_CL_IS_BLOCKING(flags) ((flags & AFK_CL_LOOP) || (flags & AFK_CL_SPIN) || (flags & AFK_CL_BLOCK))
 #define AFK_CL_IS_SHARED(flags) ((flags & AFK_CL_SHARED) || (flags & AFK_CL_UPGRADE))
@@ -20,6 +20,7 @@
 
 #include <boost/thread.hpp>
 
+#include "claim_waiters.hpp"
 #include "claimable.hpp"
 #include "data.hpp"
 
@@ -177,6 +178,14 @@ public:
         mut.unlock();
     }
 
+    /* Blocking claims on these don't fail, so there's no-one to
+     * park: try again.
+     */
+    bool park(unsigned int flags, AFK_ClaimWaiterFunc func, void *context)
+    {
+        return false;
+    }
+
     AFK_LockedClaimable() afk_noexcept
     {
         boost::unique_lock<boost::upgrade_mutex> lock(mut);
@@ -0,0 +1,164 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#include <cassert>
+#include <deque>
+#include <thread>
+#include <vector>
+
+#include <boost/atomic.hpp>
+
+#include "claimable_test.hpp"
+#include "claimable_volatile.hpp"
+#include "../clock.hpp"
+#include "../file/logstream.hpp"
+
+/* These stand in for the root-level landscape tiles: the writer
+ * keeps both fields the same, so a reader that sees them differ
+ * has got in while a write was going on.
+ */
+struct HotValue
+{
+    int64_t a;
+    int64_t b;
+
+    HotValue(): a(0), b(0) {}
+};
+
+#define READ_BIAS_TEST_HOT_COUNT 4
+#define READ_BIAS_TEST_ITERATIONS 400000
+#define READ_BIAS_TEST_WRITE_INTERVAL 4096
+
+boost::atomic_uint_fast64_t readBiasTestTornReads;
+boost::atomic_uint_fast64_t readBiasTestFailedClaims;
+boost::atomic_uint_fast64_t readBiasTestWrites;
+
+void readBiasTestWorker(unsigned int threadId, unsigned int readFlags, AFK_VolatileClaimable<HotValue> *hot)
+{
+    uint64_t tornReads = 0;
+    uint64_t failedClaims = 0;
+    uint64_t writes = 0;
+
+    for (unsigned int i = 0; i < READ_BIAS_TEST_ITERATIONS; ++i)
+    {
+        AFK_VolatileClaimable<HotValue>& h = hot[(i + threadId) % READ_BIAS_TEST_HOT_COUNT];
+
+        if (threadId == 0 && (i % READ_BIAS_TEST_WRITE_INTERVAL) == 0)
+        {
+            /* The occasional write.  Don't insist: the real ones
+             * are rare enough that they can try again next time.
+             */
+            auto claim = h.claimInplace(threadId, AFK_CL_BLOCK);
+            if (claim.isValid())
+            {
+                int64_t v = claim.get().a + 1;
+                claim.get().a = v;
+                claim.get().b = v;
+                ++writes;
+            }
+            else ++failedClaims;
+        }
+        else
+        {
+            auto claim = h.claimInplace(threadId, AFK_CL_SPIN | readFlags);
+            if (claim.isValid())
+            {
+                const volatile HotValue& v = claim.getShared();
+                if (v.a != v.b) ++tornReads;
+            }
+            else ++failedClaims;
+        }
+    }
+
+    readBiasTestTornReads.fetch_add(tornReads);
+    readBiasTestFailedClaims.fetch_add(failedClaims);
+    readBiasTestWrites.fetch_add(writes);
+}
+
+void test_readBias(void)
+{
+    const unsigned int threadCounts[] = { 1, 2, 4, 8, 16, 32, 62, 128 };
+    const unsigned int readFlagSets[] = { AFK_CL_SHARED, AFK_CL_SHARED | AFK_CL_READ_BIAS };
+
+    for (auto readFlags : readFlagSets)
+    {
+        for (auto threads : threadCounts)
+        {
+            AFK_VolatileClaimable<HotValue> hot[READ_BIAS_TEST_HOT_COUNT];
+            readBiasTestTornReads.store(0);
+            readBiasTestFailedClaims.store(0);
+            readBiasTestWrites.store(0);
+
+            std::deque<std::thread> workers;
+            afk_clock::time_point startTime = afk_clock::now();
+            for (unsigned int t = 0; t < threads; ++t)
+            {
+                workers.push_back(std::thread(readBiasTestWorker, t, readFlags, hot));
+            }
+
+            for (auto& w : workers) w.join();
+            afk_clock::time_point endTime = afk_clock::now();
+            afk_duration_mfl timeTaken = std::chrono::duration_cast<afk_duration_mfl>(endTime - startTime);
+
+            float claimsPerMilli = static_cast<float>(threads) * READ_BIAS_TEST_ITERATIONS / timeTaken.count();
+            afk_out << "Read bias test (" << ((readFlags & AFK_CL_READ_BIAS) ? "biased" : "unbiased") << ", " <<
+                threads << " threads): " << claimsPerMilli << " claims/milli, " <<
+                readBiasTestWrites.load() << " writes, " <<
+                readBiasTestFailedClaims.load() << " failed claims, " <<
+                readBiasTestTornReads.load() << " torn reads" << std::endl;
+            assert(readBiasTestTornReads.load() == 0);
+        }
+    }
+}
+
+#define READ_BIAS_COLLISION_TEST_COUNT (AFK_READER_SLOTS_PER_THREAD * 2)
+
+void test_readBiasCollisions(void)
+{
+    AFK_VolatileClaimable<HotValue> hot[READ_BIAS_COLLISION_TEST_COUNT];
+
+    {
+        /* Some of these must share a slot.  A spinning claim that
+         * couldn't cope with that would never come back.
+         */
+        std::vector<AFK_VolatileInplaceClaim<HotValue> > claims;
+        claims.reserve(READ_BIAS_COLLISION_TEST_COUNT);
+        for (unsigned int i = 0; i < READ_BIAS_COLLISION_TEST_COUNT; ++i)
+        {
+            claims.push_back(hot[i].claimInplace(0, AFK_CL_SPIN | AFK_CL_SHARED | AFK_CL_READ_BIAS));
+            assert(claims.back().isValid());
+        }
+
+        /* Nobody else gets them exclusively while I've got them... */
+        for (unsigned int i = 0; i < READ_BIAS_COLLISION_TEST_COUNT; ++i)
+        {
+            auto writeClaim = hot[i].claimInplace(1, AFK_CL_BLOCK);
+            assert(!writeClaim.isValid());
+        }
+    }
+
+    /* ...and once I've let go, they can. */
+    unsigned int writable = 0;
+    for (unsigned int i = 0; i < READ_BIAS_COLLISION_TEST_COUNT; ++i)
+    {
+        auto writeClaim = hot[i].claimInplace(1, AFK_CL_BLOCK);
+        if (writeClaim.isValid()) ++writable;
+    }
+
+    afk_out << "Read bias collision test: " << writable << " of " << READ_BIAS_COLLISION_TEST_COUNT << " writable after release" << std::endl;
+    assert(writable == READ_BIAS_COLLISION_TEST_COUNT);
+}
@@ -0,0 +1,31 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#ifndef _AFK_DATA_CLAIMABLE_TEST_H_
+#define _AFK_DATA_CLAIMABLE_TEST_H_
+
+/* Times lots of threads taking shared claims on a few hot
+ * claimables, with and without read bias.
+ */
+void test_readBias(void);
+
+/* Checks that one thread can hold read-biased shared claims on
+ * more claimables than it has reader slots (so some collide).
+ */
+void test_readBiasCollisions(void);
+
+#endif /* _AFK_DATA_CLAIMABLE_TEST_H_ */
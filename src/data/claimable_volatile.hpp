@@ -24,8 +24,11 @@
 
 #include <boost/atomic.hpp>
 
+#include "../trace.hpp"
+#include "claim_waiters.hpp"
 #include "claimable.hpp"
 #include "data.hpp"
+#include "reader_slots.hpp"
 #include "volatile.hpp"
 
 /* This defines the Claimable interface, using atomics and
@@ -290,10 +293,15 @@ template<typename T>
 class AFK_VolatileClaimable
 {
 protected:
-    /* Which thread ID has claimed use of the object.
-     * The thread ID is incremented by 1 to make sure no 0s are
-     * knocking about; 0 means unclaimed, and the top bit is the
-     * non-shared flag.
+    /* Who has claimed use of the object.  0 means unclaimed.
+     * With the top bit (the non-shared flag) set, the rest is the
+     * ID of the thread that has it exclusively, incremented by 1
+     * to make sure no 0s are knocking about.  Without it, the rest
+     * is the number of shared claims.  With the top two bits set,
+     * it's read-biased (see below), and the rest is the number of
+     * shared claims that didn't get a reader slot.
+     * (That used to be one bit per thread ID, which stopped me
+     * having more than 63 threads.)
      */
     boost::atomic_uint_fast64_t id;
 
@@ -306,26 +314,95 @@ protected:
 #define AFK_CL_NO_THREAD 0
 #define AFK_CL_NONSHARED (1uLL<<63)
 
-#define AFK_CL_THREAD_ID_SHARED(id) (1uLL<<((uint64_t)(id)))
-#define AFK_CL_THREAD_ID_SHARED_MASK(id) (~AFK_CL_THREAD_ID_SHARED(id))
+#define AFK_CL_ONE_SHARED 1uLL
+#define AFK_CL_THREAD_ID_NONSHARED(id) (((uint64_t)(id) + 1) | AFK_CL_NONSHARED)
 
-#define AFK_CL_THREAD_ID_NONSHARED(id) (AFK_CL_THREAD_ID_SHARED(id) | AFK_CL_NONSHARED)
-#define AFK_CL_THREAD_ID_NONSHARED_MASK(id) (~AFK_CL_THREAD_ID_NONSHARED(id))
+/* Everything here is done by adding and subtracting, never by
+ * storing over the ID, so that a shared claim attempt that briefly
+ * adds itself to an exclusive claim (and then takes itself off
+ * again) can't get lost or leave anything behind.
+ */
+
+/* The non-shared flag together with the bias flag means
+ * read-biased: no-one has it exclusively, and the shared claims
+ * are in the reader slots (see reader_slots.hpp).  A reader whose
+ * slot for it is taken by something else falls back to counting
+ * itself in the ID as usual, on top of the flags, rather than
+ * waiting for a slot that it might be holding itself.
+ */
+#define AFK_CL_BIAS (1uLL<<62)
+#define AFK_CL_READ_BIASED (AFK_CL_NONSHARED | AFK_CL_BIAS)
+#define AFK_CL_IS_READ_BIASED(id) (((id) & AFK_CL_READ_BIASED) == AFK_CL_READ_BIASED)
+#define AFK_CL_IS_EXCLUSIVE(id) (((id) & AFK_CL_READ_BIASED) == AFK_CL_NONSHARED)
+
+    /* Switches a read-biased claimable over to being claimed
+     * exclusively by this thread, so long as no-one (other than
+     * `exceptThreadId', and whoever's counted in `expected') is
+     * reading it right now.
+     */
+    bool tryRevokeBias(unsigned int threadId, unsigned int exceptThreadId, uint64_t expected = AFK_CL_READ_BIASED) afk_noexcept
+    {
+        const uint64_t biased = expected;
+        if (!id.compare_exchange_strong(expected, AFK_CL_THREAD_ID_NONSHARED(threadId))) return false;
+
+        if (afk_readerSlots.anyReaders(this, exceptThreadId))
+        {
+            /* Put it back.  Anyone trying to claim it via the ID
+             * in the meantime will have backed off (and might have
+             * parked on it.)
+             */
+            id.fetch_sub(AFK_CL_THREAD_ID_NONSHARED(threadId) - biased);
+            afk_claimWaiters.wake(threadId, this);
+            return false;
+        }
+
+        return true;
+    }
 
     bool tryClaim(unsigned int threadId) afk_noexcept
     {
         uint64_t expected = AFK_CL_NO_THREAD;
-        return id.compare_exchange_strong(expected, AFK_CL_THREAD_ID_NONSHARED(threadId));
+        if (id.compare_exchange_strong(expected, AFK_CL_THREAD_ID_NONSHARED(threadId))) return true;
+        return (expected == AFK_CL_READ_BIASED && tryRevokeBias(threadId, AFK_READER_SLOT_NO_THREAD));
     }
 
-    bool tryClaimShared(unsigned int threadId) afk_noexcept
+    /* Publishes this thread as a reader, and checks that the
+     * claimable is still read-biased afterwards (if it isn't,
+     * a writer might not have seen me.)
+     */
+    bool tryClaimVisible(unsigned int threadId) afk_noexcept
     {
-        if ((id.fetch_or(AFK_CL_THREAD_ID_SHARED(threadId)) & AFK_CL_NONSHARED) == AFK_CL_NONSHARED)
+        if (!afk_readerSlots.publish(threadId, this)) return false;
+        if (AFK_CL_IS_READ_BIASED(id.load())) return true;
+
+        afk_readerSlots.withdraw(threadId, this);
+        return false;
+    }
+
+    bool tryClaimShared(unsigned int threadId, unsigned int flags) afk_noexcept
+    {
+        uint64_t current = id.load();
+        if ((flags & AFK_CL_READ_BIAS) && current == AFK_CL_NO_THREAD)
+        {
+            /* Nobody has it, so I can make it read-biased.  If
+             * that fails, `current' says what got there first.
+             */
+            if (id.compare_exchange_strong(current, AFK_CL_READ_BIASED)) current = AFK_CL_READ_BIASED;
+        }
+
+        if (AFK_CL_IS_READ_BIASED(current) && tryClaimVisible(threadId)) return true;
+
+        /* That's either an ordinary shared claim, or a read-biased
+         * one I couldn't get a slot for.
+         */
+        if (AFK_CL_IS_EXCLUSIVE(id.fetch_add(AFK_CL_ONE_SHARED)))
         {
-            /* It's already claimed exclusively, flip that
-             * bit back
+            /* It's already claimed exclusively, take myself
+             * back off.  Someone might have seen me and parked
+             * in the meantime.
              */
-            id.fetch_and(AFK_CL_THREAD_ID_SHARED_MASK(threadId));
+            id.fetch_sub(AFK_CL_ONE_SHARED);
+            afk_claimWaiters.wake(threadId, this);
             return false;
         }
 
@@ -334,24 +411,73 @@ protected:
 
     bool tryUpgradeShared(unsigned int threadId) afk_noexcept
     {
-        uint64_t expected = AFK_CL_THREAD_ID_SHARED(threadId);
-        return id.compare_exchange_strong(expected, AFK_CL_THREAD_ID_NONSHARED(threadId));
+        if (afk_readerSlots.isPublished(threadId, this))
+        {
+            if (!tryRevokeBias(threadId, threadId)) return false;
+            afk_readerSlots.withdraw(threadId, this);
+            return true;
+        }
+
+        /* If mine is the only shared claim, I can have it (so long
+         * as there's no-one in the reader slots either, if it's
+         * read-biased).
+         */
+        uint64_t expected = AFK_CL_ONE_SHARED;
+        if (id.compare_exchange_strong(expected, AFK_CL_THREAD_ID_NONSHARED(threadId))) return true;
+        return (expected == AFK_CL_READ_BIASED + AFK_CL_ONE_SHARED &&
+            tryRevokeBias(threadId, AFK_READER_SLOT_NO_THREAD, expected));
     }
 
     void releaseShared(unsigned int threadId) afk_noexcept
     {
+        if (afk_readerSlots.isPublished(threadId, this))
+        {
+            afk_readerSlots.withdraw(threadId, this);
+        }
+        else
+        {
 #ifdef NDEBUG
-        id.fetch_and(AFK_CL_THREAD_ID_SHARED_MASK(threadId));
+            id.fetch_sub(AFK_CL_ONE_SHARED);
 #else
-        uint64_t old = id.fetch_and(AFK_CL_THREAD_ID_SHARED_MASK(threadId));
-        assert(!(old & AFK_CL_NONSHARED));
+            uint64_t old = id.fetch_sub(AFK_CL_ONE_SHARED);
+            assert(!AFK_CL_IS_EXCLUSIVE(old));
+            assert(old != AFK_CL_NO_THREAD && old != AFK_CL_READ_BIASED);
 #endif
+        }
+
+        afk_claimWaiters.wake(threadId, this);
+    }
+
+    /* Whether a claim with these flags would fail right now
+     * because someone else has got it.
+     */
+    bool isBusy(unsigned int flags) const afk_noexcept
+    {
+        uint64_t current = id.load();
+        if (AFK_CL_IS_READ_BIASED(current))
+            return (!AFK_CL_IS_SHARED(flags) &&
+                (current != AFK_CL_READ_BIASED || afk_readerSlots.anyReaders(this, AFK_READER_SLOT_NO_THREAD)));
+        else if (AFK_CL_IS_SHARED(flags))
+            return AFK_CL_IS_EXCLUSIVE(current);
+        else
+            return (current != AFK_CL_NO_THREAD);
     }
 
 public:
     void release(unsigned int threadId) afk_noexcept
     {
-        id.fetch_and(AFK_CL_THREAD_ID_NONSHARED_MASK(threadId));
+        id.fetch_sub(AFK_CL_THREAD_ID_NONSHARED(threadId));
+        afk_claimWaiters.wake(threadId, this);
+    }
+
+    /* Having failed to claim this with these flags, parks `func' to
+     * be called when it's released (see claim_waiters.hpp.)
+     * Returns false if it's already free again, in which case, try
+     * again now.
+     */
+    bool park(unsigned int flags, AFK_ClaimWaiterFunc func, void *context)
+    {
+        return afk_claimWaiters.park(this, func, context, [this, flags]() { return isBusy(flags); });
     }
 
     AFK_VolatileClaimable() afk_noexcept: id(AFK_CL_NO_THREAD), obj()
@@ -384,15 +510,26 @@ public:
     bool claimInternal(unsigned int threadId, unsigned int flags) afk_noexcept
     {
         bool claimed = false;
+        bool blocked = false;
 
         do
         {
-            if (AFK_CL_IS_SHARED(flags)) claimed = tryClaimShared(threadId);
+            if (AFK_CL_IS_SHARED(flags)) claimed = tryClaimShared(threadId, flags);
             else claimed = tryClaim(threadId);
+            if (!claimed && !blocked && ((flags & AFK_CL_LOOP) || (flags & AFK_CL_SPIN)))
+            {
+                /* Only the waits go on the timeline. */
+                AFK_TRACE_BEGIN(threadId, "claimBlocked")
+                blocked = true;
+            }
             if (!claimed && (flags & AFK_CL_LOOP)) std::this_thread::yield();
         }
         while (!claimed && ((flags & AFK_CL_LOOP) || (flags & AFK_CL_SPIN)));
 
+        if (blocked)
+        {
+            AFK_TRACE_END(threadId, "claimBlocked")
+        }
         return claimed;
     }
 
@@ -32,4 +32,13 @@
 #endif
 #endif /* afk_noexcept */
 
+#ifndef afk_align
+#ifdef __GNUC__
+#define afk_align(v) __attribute__((aligned(v)))
+#endif
+#ifdef _WIN32
+#define afk_align(v) __declspec(align(v))
+#endif
+#endif /* afk_align */
+
 #endif /* _AFK_DATA_DATA_H_ */
@@ -23,10 +23,14 @@
 #include <mutex>
 #include <sstream>
 #include <thread>
+#include <vector>
 
+#include "../async/thread_affinity.hpp"
 #include "cache.hpp"
+#include "claim_set.hpp"
 #include "data.hpp"
 #include "frame.hpp"
+#include "frame_stamp.hpp"
 #include "polymer.hpp"
 
 /* TODO: Interestingly enough, on Linux, volatile claimable seems to be
@@ -92,11 +96,16 @@ public:
 
     AFK_Evictable(): claimable() {}
 
-    bool canBeEvicted(void) const 
+    static bool canBeEvicted(const AFK_FrameStamp& stamp, const AFK_Frame& computingFrame) afk_noexcept
     {
-        bool canEvict = ((getComputingFrame() - claimable.getLastSeen()) > framesBeforeEviction);
+        bool canEvict = (stamp.age(computingFrame) > framesBeforeEviction);
         return canEvict;
     }
+
+    bool canBeEvicted(void) const 
+    {
+        return canBeEvicted(*(claimable.getStamp()), getComputingFrame());
+    }
 };
 
 template<
@@ -130,6 +139,17 @@ public:
     typedef AFK_PolymerChain<Key, EvictableValue, unassigned, hashBits, debug> PolymerChain;
 
 protected:
+    /* Each chain carries the frame stamps for its monomers in a dense
+     * array alongside, so that the evictor's scan reads just those
+     * (and not a cache line of claimable per entry), and so that the
+     * workers' claim traffic isn't on the same lines as them.
+     */
+    class EvictableChain: public PolymerChain
+    {
+    public:
+        std::array<AFK_FrameStamp, CHAIN_SIZE> stamps;
+    };
+
     class EvictableChainFactory
     {
     protected:
@@ -151,6 +171,7 @@ protected:
             th = new std::thread(
                 &AFK_EvictableCache<Key, Value, Hasher, unassigned, hashBits, framesBeforeEviction, getComputingFrame, debug>::EvictableChainFactory::worker,
                 this);
+            afk_threadAffinity.pinHelper(*th);
             result = rp->get_future();
         }
 
@@ -172,7 +193,7 @@ protected:
 
         void worker(void) afk_noexcept
         {
-            PolymerChain *newChain = new PolymerChain();
+            EvictableChain *newChain = new EvictableChain();
             for (size_t slot = 0; slot < CHAIN_SIZE; ++slot)
             {
                 unsigned int threadId = 1; /* doesn't matter, no contention yet */
@@ -184,7 +205,11 @@ protected:
                  */
                 bool gotIt = newChain->atSlot(threadId, slot, true, &key, &value);
                 assert(gotIt && key == unassigned);
-                if (gotIt) value->claimable.claim(threadId, AFK_CL_LOOP).get() = Value();
+                if (gotIt)
+                {
+                    value->claimable.bindStamp(&newChain->stamps[slot]);
+                    value->claimable.claim(threadId, AFK_CL_LOOP).get() = Value();
+                }
             }
 
             rp->set_value(newChain);
@@ -233,61 +258,130 @@ protected:
     unsigned int runsSkipped;
     unsigned int runsOverlapped;
 
+    /* Worker for the chain claims, below.  `claimFunc' takes
+     * the claim of the right type on one value, with the given
+     * flags.
+     */
+    template<typename ClaimType, typename KeyList, typename MissingList, typename ClaimFunc>
+    AFK_ClaimSet<ClaimType> claimChain(
+        unsigned int threadId,
+        const KeyList& keys,
+        unsigned int claimFlags,
+        size_t readBiasCount,
+        MissingList *o_missing,
+        ClaimFunc claimFunc)
+    {
+        AFK_ClaimSet<ClaimType> claims;
+        claims.reserve(keys.size());
+
+        bool failed = false;
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            const Key& key = keys[i];
+            EvictableValue *value = polymer.get(threadId, key);
+            if (!value)
+            {
+                if (o_missing) o_missing->push_back(key);
+                failed = true;
+            }
+            else if (!failed)
+            {
+                ClaimType claim = claimFunc(value,
+                    i < readBiasCount ? (claimFlags | AFK_CL_READ_BIAS) : claimFlags);
+                if (claim.isValid()) claims.push(std::move(claim));
+                else failed = true;
+            }
+
+            /* Without anyone to report the missing keys to, there's
+             * no point continuing.
+             */
+            if (failed && !o_missing) break;
+        }
+
+        if (failed) claims.release();
+        else claims.complete();
+        return claims;
+    }
+
 public:
     /* Use this to refer to claims of values in the cache. */
     typedef AFK_EVICTABLE_INPLACE_CLAIM_TYPE(Value) InplaceClaim;
     typedef AFK_EVICTABLE_CLAIM_TYPE(Value) Claim;
 
-    void evictionWorker(void) afk_noexcept
+    /* Makes one pass over the whole cache, evicting everything
+     * that's old enough.  Returns the number of entries evicted.
+     */
+    unsigned int evictionPass(void) afk_noexcept
     {
-        unsigned int entriesEvicted = 0;
+        unsigned int evicted = 0;
 
-        do
+        /* TODO Does this walk need randomising?  Maybe I should check
+         * for eviction artifacts before I included something complicated
+         * including an RNG
+         */
+        for (PolymerChain *chain = polymer.firstChain(); chain; chain = chain->next())
         {
-            /* TODO Does this walk need randomising?  Maybe I should check
-             * for eviction artifacts before I included something complicated
-             * including an RNG
-             */
-            size_t slotCount = this->polymer.slotCount(); /* don't keep recomputing */
-            for (size_t slot = 0; slot < slotCount; ++slot)
+            EvictableChain *evChain = static_cast<EvictableChain*>(chain);
+            AFK_Frame computingFrame = getComputingFrame();
+            for (size_t offset = 0; offset < CHAIN_SIZE; ++offset)
             {
+                /* Most entries will have been seen recently: I can
+                 * find that out from the stamp alone, without
+                 * touching the monomer.
+                 */
+                if (!EvictableValue::canBeEvicted(evChain->stamps[offset], computingFrame)) continue;
+
                 Key key;
                 EvictableValue *candidate;
-                if (this->polymer.getSlot(threadId, slot, &key, &candidate))
+                if (chain->atSlot(threadId, offset, false, &key, &candidate))
                 {
-                    if (candidate->canBeEvicted())
+                    /* Claim it first, otherwise someone else will
+                     * and the world will not be a happy place.
+                     * If someone else has it, chances are it's
+                     * needed after all and I should let go!
+                     * Note that the evictor claim type never uses
+                     * a real frame number and so the following is OK
+                     */
+                    auto claim = candidate->claimable.claim(threadId, AFK_CL_EVICTOR);
+                    if (claim.isValid())
                     {
-                        /* Claim it first, otherwise someone else will
-                         * and the world will not be a happy place.
-                         * If someone else has it, chances are it's
-                         * needed after all and I should let go!
-                         * Note that the evictor claim type never uses
-                         * a real frame number and so the following is OK
-                         */
-                        auto claim = candidate->claimable.claim(threadId, AFK_CL_EVICTOR);
-                        if (claim.isValid())
+                        if (candidate->canBeEvicted())
                         {
-                            if (candidate->canBeEvicted())
+                            Value& obj = claim.get();
+                            obj.evict();
+
+                            /* Reset it: the polymer won't */
+                            obj = Value();
+
+                            size_t slot = chain->getIndex() * CHAIN_SIZE + offset;
+                            if (this->polymer.eraseSlot(threadId, slot, key))
                             {
-                                Value& obj = claim.get();
-                                obj.evict();
-
-                                /* Reset it: the polymer won't */
-                                obj = Value();
-
-                                if (!this->polymer.eraseSlot(threadId, slot, key))
-                                {
-                                    /* We'd better not release (and commit the reset value)
-                                     * in this case!
-                                     * (Which ought to be unlikely ...)
-                                     */
-                                    claim.invalidate();
-                                }
+                                ++evicted;
+                            }
+                            else
+                            {
+                                /* We'd better not release (and commit the reset value)
+                                 * in this case!
+                                 * (Which ought to be unlikely ...)
+                                 */
+                                claim.invalidate();
                             }
                         }
                     }
                 }
             }
+        }
+
+        return evicted;
+    }
+
+    void evictionWorker(void) afk_noexcept
+    {
+        unsigned int entriesEvicted = 0;
+
+        do
+        {
+            entriesEvicted += evictionPass();
         } while (!stop && this->polymer.size() > targetSize);
 
         rp->set_value(entriesEvicted);
@@ -360,6 +454,43 @@ public:
         return polymer.insert(threadId, key)->claimable.claim(threadId, claimFlags);
     }
 
+    /* These helpers claim a whole chain of keys (e.g. a cell's
+     * ancestors) in one go.  Supply the keys coarsest LoD first:
+     * everyone acquiring chains in the same order is what keeps
+     * this clear of deadlocks.
+     * If any key can't be claimed, everything claimed so far is
+     * released and an invalid set is returned.  If `o_missing' is
+     * supplied, it's filled out with all the keys in the chain that
+     * aren't in the cache at all, so that the caller can go and
+     * make them.  (Either list can be a vector with any allocator.)
+     * The first `readBiasCount' keys (the coarsest ones) are claimed
+     * with AFK_CL_READ_BIAS as well: use that for entries near the
+     * root that everyone reads and nobody writes.
+     */
+    template<typename KeyList = std::vector<Key>, typename MissingList = KeyList>
+    AFK_ClaimSet<AFK_EVICTABLE_INPLACE_CLAIM_TYPE(Value)> getAndClaimChainInplace(
+        unsigned int threadId,
+        const KeyList& keys,
+        unsigned int claimFlags,
+        MissingList *o_missing = nullptr,
+        size_t readBiasCount = 0)
+    {
+        return claimChain<AFK_EVICTABLE_INPLACE_CLAIM_TYPE(Value)>(threadId, keys, claimFlags, readBiasCount, o_missing,
+            [threadId](EvictableValue *value, unsigned int flags) { return value->claimable.claimInplace(threadId, flags); });
+    }
+
+    template<typename KeyList = std::vector<Key>, typename MissingList = KeyList>
+    AFK_ClaimSet<AFK_EVICTABLE_CLAIM_TYPE(Value)> getAndClaimChain(
+        unsigned int threadId,
+        const KeyList& keys,
+        unsigned int claimFlags,
+        MissingList *o_missing = nullptr,
+        size_t readBiasCount = 0)
+    {
+        return claimChain<AFK_EVICTABLE_CLAIM_TYPE(Value)>(threadId, keys, claimFlags, readBiasCount, o_missing,
+            [threadId](EvictableValue *value, unsigned int flags) { return value->claimable.claim(threadId, flags); });
+    }
+
     void doEvictionIfNecessary(void)
     {
         /* Check whether any current eviction task has finished */
@@ -387,6 +518,7 @@ public:
                 th = new std::thread(
                     &AFK_EvictableCache<Key, Value, Hasher, unassigned, hashBits, framesBeforeEviction, getComputingFrame, debug>::evictionWorker,
                     this);
+                afk_threadAffinity.pinHelper(*th);
                 result = rp->get_future();
             }
             else
@@ -29,6 +29,13 @@
  * It maintains a mirrored set of queues, one for the update
  * phase and one for the draw phase, which can be flipped
  * with flipQueues().
+ * For pipelining, there's a third set, for a frame that's
+ * finished updating but hasn't been drawn yet.  Rather than
+ * flipping, a pipelined user calls commitQueues() when an
+ * update finishes (update -> ready) and promoteQueues() when
+ * it starts drawing (ready -> draw).  The workers can carry
+ * on with the next update in the meantime: neither of those
+ * touches the update set's index.
  * The underlying queue type must:
  * - have a sensible default constructor (no arguments)
  * - have a clear() function to clear it
@@ -39,16 +46,25 @@ template<typename QueueType>
 class AFK_Fair
 {
 protected:
-    AFK_Chain<QueueType> queues[2];
+    AFK_Chain<QueueType> queues[3];
 
-    /* This atomic controls which queue is which, by indicating
-     * the current update queue; the draw queue is the other
-     * one.
+    /* These atomics control which queue is which.  Without
+     * pipelining, only the first two sets get used.
      */
     boost::atomic_uint updateQ;
+    boost::atomic_uint readyQ;
+    boost::atomic_uint drawQ;
+
+    void clearQueues(unsigned int q)
+    {
+        queues[q].foreach([](std::shared_ptr<QueueType>& queue)
+        {
+            queue->clear();
+        });
+    }
 
 public:
-    AFK_Fair() : updateQ(0) {}
+    AFK_Fair() : updateQ(0), readyQ(2), drawQ(1) {}
 
     /* Call this when you're an evaluator thread.  This method
      * gives you a pointer to the queue you should use.
@@ -65,7 +81,7 @@ public:
      */
     void getDrawQueues(std::vector<std::shared_ptr<QueueType> >& o_drawQueues)
     {
-        queues[1 - updateQ.load()].foreach([&o_drawQueues](std::shared_ptr<QueueType>& queue)
+        queues[drawQ.load()].foreach([&o_drawQueues](std::shared_ptr<QueueType>& queue)
         {
             o_drawQueues.push_back(queue);
         });
@@ -73,13 +89,27 @@ public:
         
     void flipQueues(void)
     {
-        updateQ.fetch_xor(1);
+        drawQ.store(updateQ.exchange(drawQ.load()));
 
         /* Clear the update queue afresh. */
-        queues[updateQ.load()].foreach([](std::shared_ptr<QueueType>& queue)
-        {
-            queue->clear();
-        });
+        clearQueues(updateQ.load());
+    }
+
+    /* Call with the update phase finished and the ready set
+     * free (i.e. promoted since the last commit).
+     */
+    void commitQueues(void)
+    {
+        readyQ.store(updateQ.exchange(readyQ.load()));
+        clearQueues(updateQ.load());
+    }
+
+    /* Call from the draw thread only.  The old draw set becomes
+     * the free one, which the next commit will clear.
+     */
+    void promoteQueues(void)
+    {
+        readyQ.store(drawQ.exchange(readyQ.load()));
     }
 };
 
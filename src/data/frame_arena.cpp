@@ -0,0 +1,95 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#include "frame_arena.hpp"
+
+
+/* AFK_FrameArena implementation */
+
+AFK_FrameArena::AFK_FrameArena():
+    block(0), offset(0)
+{
+    allocations.store(0);
+    heapAllocations.store(0);
+}
+
+AFK_FrameArena::~AFK_FrameArena()
+{
+    for (auto b : blocks) delete[] b;
+    for (auto b : bigBlocks) delete[] b;
+}
+
+void *AFK_FrameArena::allocate(size_t size, size_t alignment)
+{
+    allocations.fetch_add(1, boost::memory_order_relaxed);
+
+    if (size + alignment > AFK_FRAME_ARENA_BLOCK_SIZE)
+    {
+        /* `new char[]' gives me something aligned for anything. */
+        heapAllocations.fetch_add(1, boost::memory_order_relaxed);
+        char *big = new char[size];
+        bigBlocks.push_back(big);
+        return big;
+    }
+
+    for (;;)
+    {
+        if (block < blocks.size())
+        {
+            size_t start = (offset + alignment - 1) & ~(alignment - 1);
+            if (start + size <= AFK_FRAME_ARENA_BLOCK_SIZE)
+            {
+                offset = start + size;
+                return blocks[block] + start;
+            }
+
+            /* Move on to the next block. */
+            ++block;
+            offset = 0;
+        }
+        else
+        {
+            heapAllocations.fetch_add(1, boost::memory_order_relaxed);
+            blocks.push_back(new char[AFK_FRAME_ARENA_BLOCK_SIZE]);
+            assert(block == blocks.size() - 1);
+        }
+    }
+}
+
+void AFK_FrameArena::deallocate(void *ptr, size_t size) afk_noexcept
+{
+    /* If this was the last thing I handed out, I can have it
+     * back.  Otherwise, it'll wait for the reset.
+     */
+    if (block < blocks.size() && static_cast<char *>(ptr) + size == blocks[block] + offset)
+        offset -= size;
+}
+
+void AFK_FrameArena::reset(void) afk_noexcept
+{
+    block = 0;
+    offset = 0;
+
+    for (auto b : bigBlocks) delete[] b;
+    bigBlocks.clear();
+}
+
+void AFK_FrameArena::getStatsAndReset(uint64_t& o_allocations, uint64_t& o_heapAllocations) afk_noexcept
+{
+    o_allocations += allocations.exchange(0);
+    o_heapAllocations += heapAllocations.exchange(0);
+}
@@ -0,0 +1,156 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#ifndef _AFK_DATA_FRAME_ARENA_H_
+#define _AFK_DATA_FRAME_ARENA_H_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include <boost/atomic.hpp>
+
+#include "data.hpp"
+
+/* A FrameArena is a bump allocator for the temporaries a worker
+ * makes while it enumerates a frame (subcell lists, missing tile
+ * lists, terrain lists and the like), which would otherwise go
+ * in and out of the heap several times per cell.
+ * It's for one thread only.  Nothing is given back to it until
+ * reset() throws the lot away at once, which the world does
+ * between frames when the workers are idle -- so nothing made
+ * here may be kept beyond the end of the enumeration.  (The one
+ * exception is the most recent allocation, which can be given
+ * back straight away: that lets a vector that's growing reuse
+ * its old space.)
+ * The blocks are kept across resets, so after the first few
+ * frames a worker shouldn't need the heap at all.
+ */
+
+#define AFK_FRAME_ARENA_BLOCK_SIZE 65536
+
+class AFK_FrameArena
+{
+protected:
+    std::vector<char *> blocks;
+    size_t block; /* the one I'm allocating from */
+    size_t offset; /* into that block */
+
+    /* Anything that won't fit in a block gets its own, which goes
+     * at reset().
+     */
+    std::vector<char *> bigBlocks;
+
+    /* Statistics, which only this thread bumps. */
+    boost::atomic_uint_fast64_t allocations;
+    boost::atomic_uint_fast64_t heapAllocations;
+
+    char pad[64];
+
+public:
+    AFK_FrameArena();
+    virtual ~AFK_FrameArena();
+
+    AFK_FrameArena(const AFK_FrameArena& _arena) = delete;
+    AFK_FrameArena& operator=(const AFK_FrameArena& _arena) = delete;
+
+    void *allocate(size_t size, size_t alignment);
+    void deallocate(void *ptr, size_t size) afk_noexcept;
+
+    /* Makes an array of default-constructed Ts. */
+    template<typename T>
+    T *allocArray(size_t count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "Arena objects are never destroyed");
+        T *arr = static_cast<T*>(allocate(count * sizeof(T), std::alignment_of<T>::value));
+        for (size_t i = 0; i < count; ++i) new (arr + i) T();
+        return arr;
+    }
+
+    /* Throws away everything allocated so far. */
+    void reset(void) afk_noexcept;
+
+    /* Adds to the counts of allocations this arena has handed out,
+     * and the ones it had to go to the heap for, and resets them.
+     */
+    void getStatsAndReset(uint64_t& o_allocations, uint64_t& o_heapAllocations) afk_noexcept;
+};
+
+/* An STL allocator that takes from a FrameArena.  With no arena,
+ * it uses the heap like the standard one, so that a type that's
+ * sometimes a frame temporary and sometimes not (like the terrain
+ * list) can have one vector type either way.
+ */
+template<typename T>
+class AFK_FrameAllocator
+{
+public:
+    typedef T value_type;
+    typedef T *pointer;
+    typedef const T *const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<typename U>
+    struct rebind
+    {
+        typedef AFK_FrameAllocator<U> other;
+    };
+
+    AFK_FrameArena *arena;
+
+    AFK_FrameAllocator(AFK_FrameArena *_arena = nullptr) afk_noexcept: arena(_arena) {}
+
+    template<typename U>
+    AFK_FrameAllocator(const AFK_FrameAllocator<U>& _allocator) afk_noexcept: arena(_allocator.arena) {}
+
+    T *allocate(size_t count)
+    {
+        if (arena) return static_cast<T*>(arena->allocate(count * sizeof(T), std::alignment_of<T>::value));
+        else return static_cast<T*>(::operator new(count * sizeof(T)));
+    }
+
+    void deallocate(T *ptr, size_t count) afk_noexcept
+    {
+        if (arena) arena->deallocate(ptr, count * sizeof(T));
+        else ::operator delete(ptr);
+    }
+
+    size_t max_size(void) const afk_noexcept
+    {
+        return static_cast<size_t>(-1) / sizeof(T);
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const AFK_FrameAllocator<T>& a, const AFK_FrameAllocator<U>& b) afk_noexcept
+{
+    return a.arena == b.arena;
+}
+
+template<typename T, typename U>
+bool operator!=(const AFK_FrameAllocator<T>& a, const AFK_FrameAllocator<U>& b) afk_noexcept
+{
+    return a.arena != b.arena;
+}
+
+#endif /* _AFK_DATA_FRAME_ARENA_H_ */
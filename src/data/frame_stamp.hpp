@@ -0,0 +1,110 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#ifndef _AFK_DATA_FRAME_STAMP_H_
+#define _AFK_DATA_FRAME_STAMP_H_
+
+#include <cstdint>
+#include <iostream>
+
+#include <boost/atomic.hpp>
+
+#include "data.hpp"
+#include "frame.hpp"
+
+/* A FrameStamp records when a WatchedClaimable was last seen (and
+ * last seen exclusively).  They don't live next to the claimables:
+ * the evictable cache keeps them in a dense array per polymer chain,
+ * so that the evictor can scan them without dragging in the
+ * claimables (and the claim word traffic doesn't keep knocking the
+ * stamps out of the evictor's cache).
+ *
+ * With AFK_SHORT_FRAME_STAMPS, only the bottom 16 bits of each frame
+ * number are kept and ages are worked out modulo 2^16.  That makes
+ * the array a quarter of the size, at the cost of an entry that's
+ * gone unseen for a multiple of 65536 frames looking briefly young
+ * again (and being turned down for one exclusive claim in the
+ * unlikely event that it's asked for one exactly then).
+ */
+#define AFK_SHORT_FRAME_STAMPS 0
+
+class AFK_FrameStamp
+{
+protected:
+#if AFK_SHORT_FRAME_STAMPS
+    typedef uint16_t StampType;
+#else
+    typedef uint64_t StampType;
+#endif
+
+    boost::atomic<StampType> lastSeen;
+    boost::atomic<StampType> lastSeenExclusively;
+
+    static StampType toStamp(int64_t frameNum) afk_noexcept
+    {
+        return static_cast<StampType>(frameNum);
+    }
+
+public:
+    AFK_FrameStamp() afk_noexcept:
+        lastSeen(toStamp(-1)), lastSeenExclusively(toStamp(-1)) {}
+
+    void reset(void) afk_noexcept
+    {
+        lastSeen.store(toStamp(-1));
+        lastSeenExclusively.store(toStamp(-1));
+    }
+
+    void see(int64_t frameNum) afk_noexcept
+    {
+        lastSeen.store(toStamp(frameNum));
+    }
+
+    bool seenAt(int64_t frameNum) const afk_noexcept
+    {
+        return (lastSeen.load() == toStamp(frameNum));
+    }
+
+    /* Stamps an exclusive sighting.  Returns true if this is the
+     * first exclusive sighting this frame, else false.
+     */
+    bool seeExclusively(int64_t frameNum) afk_noexcept
+    {
+        return (lastSeenExclusively.exchange(toStamp(frameNum)) != toStamp(frameNum));
+    }
+
+    /* How many frames since the last sighting. */
+    int64_t age(const AFK_Frame& now) const afk_noexcept
+    {
+#if AFK_SHORT_FRAME_STAMPS
+        return static_cast<int64_t>(static_cast<StampType>(toStamp(now.get()) - lastSeen.load()));
+#else
+        return now - AFK_Frame(static_cast<int64_t>(lastSeen.load()));
+#endif
+    }
+
+    int64_t getLastSeen(void) const afk_noexcept { return static_cast<int64_t>(lastSeen.load()); }
+    int64_t getLastSeenExclusively(void) const afk_noexcept { return static_cast<int64_t>(lastSeenExclusively.load()); }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const AFK_FrameStamp& stamp)
+{
+    os << "last seen " << stamp.getLastSeen() << ", last seen exclusively " << stamp.getLastSeenExclusively();
+    return os;
+}
+
+#endif /* _AFK_DATA_FRAME_STAMP_H_ */
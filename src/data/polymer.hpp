@@ -348,7 +348,7 @@ protected:
                 {
                     inserted = chain->insert(threadId, hops, hash, key, o_valuePtr);
 
-                    if (inserted) stats.insertedOne(hops);
+                    if (inserted) stats.insertedOne(threadId, hops);
                 }
             }
 
@@ -413,6 +413,15 @@ public:
         return value;
     }
 
+    /* For walking the chains directly (again, the eviction thread
+     * wants this, to get at whatever else it keeps alongside them.)
+     * Follow it with next().
+     */
+    PolymerChain *firstChain(void) const afk_noexcept
+    {
+        return chains;
+    }
+
     /* For accessing the chain slots directly.  Use carefully (it's really
      * just for the eviction thread).
      * Here chain slots are numbered 0 to (CHAIN_SIZE * chain count).
@@ -439,7 +448,7 @@ public:
     bool eraseSlot(unsigned int threadId, size_t slot, const KeyType& key) afk_noexcept
     {
         bool success = chains->eraseSlot(threadId, slot, key);
-        if (success) stats.erasedOne();
+        if (success) stats.erasedOne(threadId);
         return success;
     }
 
@@ -0,0 +1,28 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#include "reader_slots.hpp"
+
+AFK_ReaderSlots afk_readerSlots;
+
+AFK_ReaderSlots::AFK_ReaderSlots() afk_noexcept:
+    rowsInUse(0)
+{
+    for (unsigned int t = 0; t < AFK_READER_SLOT_THREADS; ++t)
+        for (unsigned int s = 0; s < AFK_READER_SLOTS_PER_THREAD; ++s)
+            rows[t].slots[s].store(nullptr);
+}
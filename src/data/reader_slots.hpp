@@ -0,0 +1,124 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#ifndef _AFK_DATA_READER_SLOTS_H_
+#define _AFK_DATA_READER_SLOTS_H_
+
+#include <cassert>
+#include <cstdint>
+
+#include <boost/atomic.hpp>
+
+#include "data.hpp"
+#include "../async/thread_allocation.hpp"
+
+/* Reader slots are a per-thread reader indicator (in the style of
+ * BRAVO) for the few claimables that nearly every worker claims
+ * shared every frame -- the root-level landscape tiles.  Rather
+ * than all those readers hammering the bits in one claimable ID,
+ * a read-biased claimable's readers each publish it in a row of
+ * slots belonging to their own thread (so no-one else writes that
+ * cache line), and anyone wanting to claim it exclusively has to
+ * scan everyone's rows for it first.
+ * That makes writes much more expensive, which is why this is only
+ * turned on (with AFK_CL_READ_BIAS) for entries that are almost
+ * never written.
+ */
+
+/* Enough for every thread ID that AFK_ThreadAllocation hands out. */
+#define AFK_READER_SLOT_THREADS AFK_MAX_THREADS
+
+/* How many read-biased claims any one thread can have at once
+ * (one row is a cache line).  Collisions just push the reader
+ * back onto the ordinary path.
+ */
+#define AFK_READER_SLOTS_PER_THREAD 8
+
+/* Use this for "no thread" when asking whether there are any readers. */
+#define AFK_READER_SLOT_NO_THREAD AFK_READER_SLOT_THREADS
+
+class AFK_ReaderSlots
+{
+protected:
+    struct Row
+    {
+        boost::atomic<const void *> slots[AFK_READER_SLOTS_PER_THREAD];
+    } afk_align(64);
+
+    Row rows[AFK_READER_SLOT_THREADS];
+
+    /* One more than the highest thread ID that's ever published
+     * anything, so that anyReaders() needn't scan rows that no
+     * thread is using.
+     */
+    boost::atomic<unsigned int> rowsInUse;
+
+    static unsigned int slotFor(const void *obj) afk_noexcept
+    {
+        uintptr_t p = reinterpret_cast<uintptr_t>(obj);
+        return static_cast<unsigned int>((p >> 4) ^ (p >> 10)) & (AFK_READER_SLOTS_PER_THREAD - 1);
+    }
+
+public:
+    AFK_ReaderSlots() afk_noexcept;
+
+    /* Publishes `obj' as being read by this thread.  Returns false
+     * if this thread's slot for it is already in use.
+     */
+    bool publish(unsigned int threadId, const void *obj) afk_noexcept
+    {
+        assert(threadId < AFK_READER_SLOT_THREADS);
+        unsigned int inUse = rowsInUse.load();
+        while (inUse <= threadId && !rowsInUse.compare_exchange_weak(inUse, threadId + 1));
+
+        boost::atomic<const void *>& slot = rows[threadId].slots[slotFor(obj)];
+        if (slot.load(boost::memory_order_relaxed) != nullptr) return false;
+        slot.store(obj);
+        return true;
+    }
+
+    bool isPublished(unsigned int threadId, const void *obj) const afk_noexcept
+    {
+        assert(threadId < AFK_READER_SLOT_THREADS);
+        return (rows[threadId].slots[slotFor(obj)].load(boost::memory_order_relaxed) == obj);
+    }
+
+    void withdraw(unsigned int threadId, const void *obj) afk_noexcept
+    {
+        assert(isPublished(threadId, obj));
+        rows[threadId].slots[slotFor(obj)].store(nullptr);
+    }
+
+    /* Returns true if any thread other than `exceptThreadId' has
+     * published `obj'.
+     */
+    bool anyReaders(const void *obj, unsigned int exceptThreadId) const afk_noexcept
+    {
+        unsigned int slot = slotFor(obj);
+        unsigned int inUse = rowsInUse.load();
+        for (unsigned int t = 0; t < inUse; ++t)
+        {
+            if (t != exceptThreadId && rows[t].slots[slot].load() == obj) return true;
+        }
+
+        return false;
+    }
+};
+
+extern AFK_ReaderSlots afk_readerSlots;
+
+#endif /* _AFK_DATA_READER_SLOTS_H_ */
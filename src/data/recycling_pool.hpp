@@ -0,0 +1,162 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#ifndef _AFK_DATA_RECYCLING_POOL_H_
+#define _AFK_DATA_RECYCLING_POOL_H_
+
+#include <cassert>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/lockfree/queue.hpp>
+
+#include "data.hpp"
+#include "../async/thread_allocation.hpp"
+
+/* A RecyclingPool hands out objects of type T, and takes them
+ * back again for re-use, so that things that get made and thrown
+ * away all the time by the workers (like the work dependencies)
+ * don't keep going through the heap.
+ * Each thread ID keeps its own free list, which only it touches.
+ * An object goes back on the list of whichever thread frees it
+ * (which needn't be the one that allocated it); when a thread's
+ * list is full, the spares go to a shared lock-free overflow queue
+ * that anyone can take from.
+ */
+
+/* Enough for every thread ID that AFK_ThreadAllocation hands out. */
+#define AFK_RECYCLING_POOL_THREADS AFK_MAX_THREADS
+
+template<typename T>
+class AFK_RecyclingPool
+{
+protected:
+    /* The pool itself lives on the heap, where I can't count on
+     * an afk_align() being honoured, so I just pad the rows out to
+     * a cache line's worth to keep the threads apart.
+     */
+    struct Row
+    {
+        std::vector<void *> freeList;
+
+        /* Statistics, which only this thread bumps. */
+        boost::atomic_uint_fast64_t fresh;
+        boost::atomic_uint_fast64_t recycled;
+
+        char pad[64];
+    };
+
+    Row rows[AFK_RECYCLING_POOL_THREADS];
+    const size_t maxPerThread;
+
+    boost::lockfree::queue<void *> overflow;
+
+    void *getStorage(unsigned int threadId)
+    {
+        void *storage = nullptr;
+        bool haveRow = (threadId < AFK_RECYCLING_POOL_THREADS);
+        if (haveRow && !rows[threadId].freeList.empty())
+        {
+            storage = rows[threadId].freeList.back();
+            rows[threadId].freeList.pop_back();
+        }
+        else if (!overflow.pop(storage))
+        {
+            storage = ::operator new(sizeof(T));
+            if (haveRow) rows[threadId].fresh.fetch_add(1, boost::memory_order_relaxed);
+            return storage;
+        }
+
+        if (haveRow) rows[threadId].recycled.fetch_add(1, boost::memory_order_relaxed);
+        return storage;
+    }
+
+public:
+    AFK_RecyclingPool(size_t _maxPerThread = 256):
+        maxPerThread(_maxPerThread), overflow(_maxPerThread)
+    {
+        for (auto& row : rows)
+        {
+            row.freeList.reserve(maxPerThread);
+            row.fresh.store(0);
+            row.recycled.store(0);
+        }
+    }
+
+    AFK_RecyclingPool(const AFK_RecyclingPool& _pool) = delete;
+    AFK_RecyclingPool& operator=(const AFK_RecyclingPool& _pool) = delete;
+
+    virtual ~AFK_RecyclingPool()
+    {
+        /* Anything still out there is lost, of course. */
+        for (auto& row : rows)
+            for (auto storage : row.freeList) ::operator delete(storage);
+
+        void *storage;
+        while (overflow.pop(storage)) ::operator delete(storage);
+    }
+
+    /* Makes a new T with these constructor arguments. */
+    template<typename... Args>
+    T *alloc(unsigned int threadId, Args&&... args)
+    {
+        void *storage = getStorage(threadId);
+        try
+        {
+            return new (storage) T(std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            ::operator delete(storage);
+            throw;
+        }
+    }
+
+    /* Destroys a T made with alloc() and keeps its storage. */
+    void free(unsigned int threadId, T *obj)
+    {
+        obj->~T();
+
+        if (threadId < AFK_RECYCLING_POOL_THREADS &&
+            rows[threadId].freeList.size() < maxPerThread)
+        {
+            rows[threadId].freeList.push_back(obj);
+        }
+        else if (!overflow.bounded_push(obj))
+        {
+            ::operator delete(obj);
+        }
+    }
+
+    /* Gathers up (and resets) the statistics: how many objects
+     * needed fresh storage, and how many were recycled.
+     */
+    void getStats(uint64_t& o_fresh, uint64_t& o_recycled)
+    {
+        o_fresh = o_recycled = 0;
+        for (auto& row : rows)
+        {
+            o_fresh += row.fresh.exchange(0);
+            o_recycled += row.recycled.exchange(0);
+        }
+    }
+};
+
+#endif /* _AFK_DATA_RECYCLING_POOL_H_ */
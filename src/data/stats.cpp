@@ -19,46 +19,48 @@
 
 AFK_StructureStats::AFK_StructureStats()
 {
-    size.store(0);
-    contention.store(0);
-    contentionSampleSize.store(0);
 }
 
-void AFK_StructureStats::insertedOne(unsigned int tries)
+void AFK_StructureStats::insertedOne(unsigned int threadId, unsigned int tries)
 {
     /* Right now this doesn't guard against concurrent
      * access of separate fields, but I don't think I really
      * need that level of accuracy (?)
      */
-    size.fetch_add(1);
-    contention.fetch_add(tries);
-    contentionSampleSize.fetch_add(1);
+    counters.add(threadId, AFK_STRUCTURE_STATS_INSERTED, 1);
+    counters.add(threadId, AFK_STRUCTURE_STATS_CONTENTION, tries);
+    counters.add(threadId, AFK_STRUCTURE_STATS_CONTENTION_SAMPLE_SIZE, 1);
 }
 
-void AFK_StructureStats::erasedOne(void)
+void AFK_StructureStats::erasedOne(unsigned int threadId)
 {
-    size.fetch_sub(1);
+    counters.add(threadId, AFK_STRUCTURE_STATS_ERASED, 1);
 }
 
 size_t AFK_StructureStats::getSize(void) const
 {
-    return size.load();
+    /* Read the erasures first, so that I can't see one without
+     * its insertion and come out negative.
+     */
+    uint64_t erased = counters.total(AFK_STRUCTURE_STATS_ERASED);
+    uint64_t inserted = counters.total(AFK_STRUCTURE_STATS_INSERTED);
+    return static_cast<size_t>(inserted - erased);
 }
 
 unsigned int AFK_StructureStats::getContentionAndReset(void)
 {
-    unsigned int oldContention = contention;
-    unsigned int oldContentionSampleSize = contentionSampleSize;
-
-    contentionSampleSize.store(0);
-    contention.store(0);
+    uint64_t oldContention = counters.totalAndReset(AFK_STRUCTURE_STATS_CONTENTION);
+    uint64_t oldContentionSampleSize = counters.totalAndReset(AFK_STRUCTURE_STATS_CONTENTION_SAMPLE_SIZE);
 
-    return oldContentionSampleSize == 0 ? 0 : (oldContention / oldContentionSampleSize);
+    return oldContentionSampleSize == 0 ? 0 : static_cast<unsigned int>(oldContention / oldContentionSampleSize);
 }
 
 void AFK_StructureStats::printStats(std::ostream& os, const std::string& prefix) const
 {
-    os << prefix << ": Size: " << size << std::endl;
+    uint64_t contention = counters.total(AFK_STRUCTURE_STATS_CONTENTION);
+    uint64_t contentionSampleSize = counters.total(AFK_STRUCTURE_STATS_CONTENTION_SAMPLE_SIZE);
+
+    os << prefix << ": Size: " << getSize() << std::endl;
     os << prefix << ": Contention: " << (
         contentionSampleSize == 0 ? 0.0f : ((float)contention / (float)contentionSampleSize)) << std::endl;
 }
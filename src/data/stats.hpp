@@ -20,32 +20,35 @@
 
 #include <sstream>
 
-#include <boost/atomic.hpp>
+#include "thread_counters.hpp"
 
-/* Useful tracking stats module for the async structures. */
+/* Useful tracking stats module for the async structures.
+ * Every insert bumps these, so they're kept per thread (see
+ * thread_counters.hpp).
+ */
 
 class AFK_StructureStats
 {
 protected:
-    /* The number of things in use in the structure. */
-    boost::atomic_uint size;
-
-    /* Accumulated contention: the number of times we
+    /* - The number of things inserted and erased (the difference
+     * being the number of things in use in the structure.)
+     * - Accumulated contention: the number of times we
      * had to retry to slot a new thing.
+     * - The number of things that have been accumulated into
+     * the contention value.  Reset to re-begin contention
+     * sampling
      */
-    boost::atomic_uint contention;
-
-    /* The number of things that have been accumulated into
-     * the `contention' value.  Reset to re-begin
-     * contention sampling
-     */
-    boost::atomic_uint contentionSampleSize;
+#define AFK_STRUCTURE_STATS_INSERTED                0
+#define AFK_STRUCTURE_STATS_ERASED                  1
+#define AFK_STRUCTURE_STATS_CONTENTION              2
+#define AFK_STRUCTURE_STATS_CONTENTION_SAMPLE_SIZE  3
+    AFK_ThreadCounters<4> counters;
 
 public:
     AFK_StructureStats();
 
-    void insertedOne(unsigned int tries);
-    void erasedOne(void);
+    void insertedOne(unsigned int threadId, unsigned int tries);
+    void erasedOne(unsigned int threadId);
     size_t getSize(void) const;
     unsigned int getContentionAndReset(void);
     void printStats(std::ostream& os, const std::string& prefix) const;
@@ -0,0 +1,111 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#ifndef _AFK_DATA_THREAD_COUNTERS_H_
+#define _AFK_DATA_THREAD_COUNTERS_H_
+
+#include <cassert>
+#include <cstdint>
+
+#include <boost/atomic.hpp>
+
+#include "data.hpp"
+#include "../async/thread_allocation.hpp"
+
+/* ThreadCounters are statistics counters that every worker bumps
+ * all the time, but that only get read out now and again (at a
+ * checkpoint).  Each thread ID gets a row of `count' counters of
+ * its own, padded out to keep it off everyone else's cache line,
+ * and only that thread ever writes to it -- so a bump is a plain
+ * load and store, not a locked add.  Reading one adds up all the
+ * rows.
+ * Reading "and resetting" doesn't touch the rows either: I just
+ * remember what the total was last time, and return the
+ * difference.  So there should only be one of those readers at
+ * once (the checkpoint.)
+ */
+
+template<unsigned int count>
+class AFK_ThreadCounters
+{
+protected:
+    /* Like the recycling pool's rows, these are padded rather than
+     * aligned, because the counters mostly live in things on the
+     * heap.
+     */
+    struct Row
+    {
+        boost::atomic<uint64_t> v[count];
+        char pad[64];
+    };
+
+    Row rows[AFK_MAX_THREADS];
+
+    /* One more than the highest thread ID that's bumped anything,
+     * so that the readers needn't add up rows that nobody uses.
+     */
+    boost::atomic<unsigned int> rowsInUse;
+
+    /* What the totals were when they were last reset. */
+    uint64_t lastTotal[count];
+
+public:
+    AFK_ThreadCounters() afk_noexcept: rowsInUse(0)
+    {
+        for (unsigned int t = 0; t < AFK_MAX_THREADS; ++t)
+            for (unsigned int c = 0; c < count; ++c)
+                rows[t].v[c].store(0);
+
+        for (unsigned int c = 0; c < count; ++c) lastTotal[c] = 0;
+    }
+
+    AFK_ThreadCounters(const AFK_ThreadCounters& _counters) = delete;
+    AFK_ThreadCounters& operator=(const AFK_ThreadCounters& _counters) = delete;
+
+    /* Only the thread with this ID may call this. */
+    void add(unsigned int threadId, unsigned int counter, uint64_t amount) afk_noexcept
+    {
+        assert(threadId < AFK_MAX_THREADS && counter < count);
+        unsigned int inUse = rowsInUse.load(boost::memory_order_relaxed);
+        while (inUse <= threadId && !rowsInUse.compare_exchange_weak(inUse, threadId + 1));
+
+        boost::atomic<uint64_t>& v = rows[threadId].v[counter];
+        v.store(v.load(boost::memory_order_relaxed) + amount, boost::memory_order_release);
+    }
+
+    /* The total since the start. */
+    uint64_t total(unsigned int counter) const afk_noexcept
+    {
+        assert(counter < count);
+        uint64_t sum = 0;
+        unsigned int inUse = rowsInUse.load();
+        for (unsigned int t = 0; t < inUse; ++t)
+            sum += rows[t].v[counter].load(boost::memory_order_acquire);
+        return sum;
+    }
+
+    /* The total since the last reset, and resets it. */
+    uint64_t totalAndReset(unsigned int counter) afk_noexcept
+    {
+        uint64_t sum = total(counter);
+        uint64_t sinceReset = sum - lastTotal[counter];
+        lastTotal[counter] = sum;
+        return sinceReset;
+    }
+};
+
+#endif /* _AFK_DATA_THREAD_COUNTERS_H_ */
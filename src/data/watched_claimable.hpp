@@ -18,12 +18,17 @@
 #ifndef _AFK_DATA_WATCHED_CLAIMABLE_H_
 #define _AFK_DATA_WATCHED_CLAIMABLE_H_
 
+#include "claim_waiters.hpp"
 #include "claimable.hpp"
 #include "data.hpp"
+#include "frame_stamp.hpp"
 
 /* A WatchedClaimable wraps a Claimable and provides last seen,
  * per-frame exclusivity, and an exception for the evictor.
  * It's generic, so that it can wrap a locked or volatile claimable.
+ * The last seen stamps themselves are kept out of line (see
+ * frame_stamp.hpp): whoever owns the WatchedClaimable must bind it
+ * to a stamp with bindStamp() before claiming it.
  */
 
 template<
@@ -37,8 +42,7 @@ protected:
     Claimable claimable;
 
     /* Last times the object was seen. */
-    boost::atomic_uint_fast64_t lastSeen;
-    boost::atomic_uint_fast64_t lastSeenExclusively;
+    AFK_FrameStamp *stamp;
 
     /* This utility method verifies that it's okay to claim ths object,
      * based on the last seen fields and the given flags.
@@ -46,21 +50,22 @@ protected:
     bool watch(unsigned int flags) afk_noexcept
     {
         int64_t computingFrameNum = getComputingFrame().get();
+        assert(stamp);
 
         /* Help the evictor out a little */
         if (flags & AFK_CL_EVICTOR)
         {
             assert(!(AFK_CL_IS_SHARED(flags)));
-            if (lastSeen.load() == computingFrameNum) return false;
+            if (stamp->seenAt(computingFrameNum)) return false;
         }
         else
         {
-            lastSeen.store(computingFrameNum);
+            stamp->see(computingFrameNum);
         
             if (flags & AFK_CL_EXCLUSIVE)
             {
                 assert(!(AFK_CL_IS_SHARED(flags)));
-                if (lastSeenExclusively.exchange(computingFrameNum) == computingFrameNum) return false;
+                if (!stamp->seeExclusively(computingFrameNum)) return false;
             }
         }
 
@@ -68,22 +73,30 @@ protected:
     }
 
 public:
-    AFK_WatchedClaimable() afk_noexcept: claimable(), lastSeen(-1), lastSeenExclusively(-1) {}
+    AFK_WatchedClaimable() afk_noexcept: claimable(), stamp(nullptr) {}
 
     /* The move constructors are used to enable initialisation.
-     * They essentially make a new Claimable.
+     * They essentially make a new Claimable (which needs binding
+     * to a stamp of its own.)
      */
     AFK_WatchedClaimable(const AFK_WatchedClaimable&& _wc) afk_noexcept:
-        claimable(_wc.claimable), lastSeen(-1), lastSeenExclusively(-1) {}
+        claimable(_wc.claimable), stamp(nullptr) {}
 
     AFK_WatchedClaimable& operator=(const AFK_WatchedClaimable&& _wc) afk_noexcept
     {
         claimable = _wc.claimable;
-        lastSeen.store(-1);
-        lastSeenExclusively.store(-1);
+        if (stamp) stamp->reset();
         return *this;
     }
 
+    void bindStamp(AFK_FrameStamp *_stamp) afk_noexcept
+    {
+        stamp = _stamp;
+        stamp->reset();
+    }
+
+    const AFK_FrameStamp *getStamp(void) const afk_noexcept { return stamp; }
+
     Claim claim(unsigned int threadId, unsigned int flags) afk_noexcept
     {
         bool claimed = claimable.claimInternal(threadId, flags);
@@ -116,8 +129,13 @@ public:
         else return InplaceClaim();
     }
 
-    int64_t getLastSeen(void) const afk_noexcept { return lastSeen.load(); }
-    int64_t getLastSeenExclusively(void) const afk_noexcept { return lastSeenExclusively.load(); }
+    /* Parks a waiter on the claimable after a failed claim (see
+     * claim_waiters.hpp.)
+     */
+    bool park(unsigned int flags, AFK_ClaimWaiterFunc func, void *context)
+    {
+        return claimable.park(flags, func, context);
+    }
 
     template<
         typename _Claimable,
@@ -138,7 +156,9 @@ std::ostream& operator<<(
     std::ostream& os,
     const AFK_WatchedClaimable<Claimable, InplaceClaim, Claim, getComputingFrame>& c)
 {
-    os << "WatchedClaimable(with " << c.claimable << ", last seen " << c.getLastSeen() << ", last seen exclusively " << c.getLastSeenExclusively() << ")";
+    os << "WatchedClaimable(with " << c.claimable;
+    if (c.stamp) os << ", " << *(c.stamp);
+    os << ")";
     return os;
 }
 
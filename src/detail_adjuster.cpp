@@ -124,6 +124,12 @@ afk_duration_mfl AFK_DetailAdjuster::getComputeWaitTime(void)
     return afk_duration_mfl((frameTimeTarget - frameTimeSoFar.count()) * wiggle);
 }
 
+afk_clock::time_point AFK_DetailAdjuster::getComputeDeadline(const afk_clock::time_point& updateStart) const
+{
+    return updateStart + std::chrono::duration_cast<afk_clock::duration>(
+        afk_duration_mfl(frameTimeTarget * wiggle));
+}
+
 float AFK_DetailAdjuster::getDetailPitch(void)
 {
     /* I'm going to apply a "stickiness",
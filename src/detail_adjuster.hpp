@@ -102,6 +102,14 @@ public:
      */
     afk_duration_mfl getComputeWaitTime(void);
 
+    /* The same sort of thing as a point in time: when the workers
+     * ought to stop going into more detail, for an update that
+     * started at `updateStart'.  (That isn't necessarily the start
+     * of the frame: when pipelining, an update starts whenever the
+     * last one has been committed.)
+     */
+    afk_clock::time_point getComputeDeadline(const afk_clock::time_point& updateStart) const;
+
     /* Output detail pitch for the world to use. */
     float getDetailPitch(void);
 
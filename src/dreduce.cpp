@@ -120,7 +120,7 @@ void AFK_DReduce::readBack(
         {
             if (pushed[i]) continue;
 
-            auto entry = cache->get(threadId, shapeCells[i]);
+            auto entry = cache->get(threadId, afk_packedKeyedCell(shapeCells[i]));
             if (entry)
             {
                 auto claim = entry->claimable.claim(threadId, 0);
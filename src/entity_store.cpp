@@ -0,0 +1,101 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#include "afk.hpp"
+
+#include <sstream>
+
+#include "entity_store.hpp"
+#include "exception.hpp"
+
+
+/* AFK_EntityStore implementation */
+
+AFK_EntityStore::AFK_EntityStore():
+    nextFresh(0), freeBlocks(AFK_ENTITY_STORE_CHUNK_BLOCKS), blocksInUse(0)
+{
+    for (auto& chunk : chunks) chunk.store(nullptr);
+}
+
+AFK_EntityStore::~AFK_EntityStore()
+{
+    for (auto& chunk : chunks)
+    {
+        Block *blocks = chunk.load();
+        if (blocks) delete[] blocks;
+    }
+}
+
+uint32_t AFK_EntityStore::alloc(void)
+{
+    uint32_t index;
+    if (freeBlocks.pop(index))
+    {
+        /* The entities position themselves relative to how they
+         * were before, so a recycled block needs clearing out.
+         */
+        for (auto& e : at(index)) e = AFK_Entity();
+    }
+    else
+    {
+        index = nextFresh.fetch_add(1);
+        uint32_t chunkIndex = index / AFK_ENTITY_STORE_CHUNK_BLOCKS;
+        if (chunkIndex >= AFK_ENTITY_STORE_MAX_CHUNKS)
+        {
+            std::ostringstream ss;
+            ss << "Entity store full (" << index << " blocks)";
+            throw AFK_Exception(ss.str());
+        }
+
+        /* If I'm the first into this chunk, I make it.  If someone
+         * beats me to it, I throw mine away.
+         */
+        if (!chunks[chunkIndex].load(boost::memory_order_acquire))
+        {
+            Block *newChunk = new Block[AFK_ENTITY_STORE_CHUNK_BLOCKS];
+            Block *expected = nullptr;
+            if (!chunks[chunkIndex].compare_exchange_strong(expected, newChunk,
+                boost::memory_order_acq_rel))
+            {
+                delete[] newChunk;
+            }
+        }
+    }
+
+    blocksInUse.fetch_add(1, boost::memory_order_relaxed);
+    return index;
+}
+
+void AFK_EntityStore::free(uint32_t index)
+{
+    freeBlocks.push(index);
+    blocksInUse.fetch_sub(1, boost::memory_order_relaxed);
+}
+
+int64_t AFK_EntityStore::getBlocksInUse(void) const
+{
+    return blocksInUse.load(boost::memory_order_relaxed);
+}
+
+size_t AFK_EntityStore::getBytesAllocated(void) const
+{
+    size_t chunkCount = 0;
+    for (auto& chunk : chunks)
+        if (chunk.load(boost::memory_order_relaxed)) ++chunkCount;
+
+    return chunkCount * AFK_ENTITY_STORE_CHUNK_BLOCKS * sizeof(Block);
+}
@@ -0,0 +1,97 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#ifndef _AFK_ENTITY_STORE_H_
+#define _AFK_ENTITY_STORE_H_
+
+#include "afk.hpp"
+
+#include <array>
+#include <cstdint>
+
+#include <boost/atomic.hpp>
+#include <boost/lockfree/queue.hpp>
+
+#include "entity.hpp"
+
+/* The entities don't live in the world cells any more: only about
+ * one cell in entitySparseness has any, and having room for them in
+ * every cache slot made the world cache several times bigger than it
+ * needed to be.  Instead, a cell that gets entities takes a block of
+ * them out of the EntityStore and keeps its index.
+ *
+ * The blocks live in chunks that are made as needed and never
+ * moved, so an index stays good (and the blocks can be used without
+ * any locking beyond the claim on the owning cell) until it's freed.
+ * Freed blocks go on a lock-free list for re-use.  The chunks
+ * themselves only go away with the store.
+ */
+
+/* How many entities a cell can have. */
+#define AFK_ENTITY_BLOCK_SIZE 4
+
+/* The index of no block at all. */
+#define AFK_ENTITY_BLOCK_NONE 0xffffffffu
+
+#define AFK_ENTITY_STORE_CHUNK_BLOCKS 1024
+#define AFK_ENTITY_STORE_MAX_CHUNKS 4096
+
+class AFK_EntityStore
+{
+public:
+    typedef std::array<AFK_Entity, AFK_ENTITY_BLOCK_SIZE> Block;
+
+protected:
+    boost::atomic<Block *> chunks[AFK_ENTITY_STORE_MAX_CHUNKS];
+
+    /* The next never-used block index. */
+    boost::atomic_uint_fast32_t nextFresh;
+
+    boost::lockfree::queue<uint32_t> freeBlocks;
+
+    /* How many blocks are out right now. */
+    boost::atomic_int_fast64_t blocksInUse;
+
+public:
+    AFK_EntityStore();
+    virtual ~AFK_EntityStore();
+
+    AFK_EntityStore(const AFK_EntityStore& _store) = delete;
+    AFK_EntityStore& operator=(const AFK_EntityStore& _store) = delete;
+
+    /* Hands out a block of fresh entities. */
+    uint32_t alloc(void);
+
+    /* Gives a block back.  Nobody should be holding on to its
+     * index after this.
+     */
+    void free(uint32_t index);
+
+    Block& at(uint32_t index)
+    {
+        return chunks[index / AFK_ENTITY_STORE_CHUNK_BLOCKS].load(
+            boost::memory_order_acquire)[index % AFK_ENTITY_STORE_CHUNK_BLOCKS];
+    }
+
+    /* For the checkpoint: how many blocks are out, and how many
+     * bytes the store has taken in total.
+     */
+    int64_t getBlocksInUse(void) const;
+    size_t getBytesAllocated(void) const;
+};
+
+#endif /* _AFK_ENTITY_STORE_H_ */
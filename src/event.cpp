@@ -21,6 +21,7 @@
 #include "debug.hpp"
 #include "display.hpp"
 #include "event.hpp"
+#include "trace.hpp"
 #include "ui/config_settings.hpp"
 
 #define DEBUG_CONTROLS 0
@@ -72,6 +73,11 @@ static void enableControl(AFK_Control control)
             afk_core.window->switchAwayFromFullScreen();
         break;
 
+    case AFK_Control::WRITE_TRACE:
+        /* Dumps what the tracer has so far, without stopping it. */
+        if (afk_tracer.isEnabled()) afk_tracer.write(afk_core.settings.traceFile);
+        break;
+
     default:
         /* Nothing else to do. */
         break;
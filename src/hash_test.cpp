@@ -17,6 +17,7 @@
 
 #include "afk.hpp"
 
+#include <cassert>
 #include <iostream>
 
 #include "file/logstream.hpp"
@@ -78,6 +79,44 @@ void test_cellHash(void)
     test_cellHash(131072, 2);
 }
 
+void test_packedCell(void)
+{
+    /* Every corner of the block of top cells that the world starts
+     * from with the default zFar (top cells 2^19 across, see
+     * cell.hpp), at every scale, should pack and come back the same.
+     */
+    afk_out << "Packed cell test" << std::endl;
+    afk_out << "----------------" << std::endl;
+
+    const int64_t topScale = 1ll << 19;
+    unsigned int mismatches = 0;
+    for (int64_t scale = 2; scale <= topScale; scale *= 2)
+    {
+        for (unsigned int corner = 0; corner < 8; ++corner)
+        {
+            AFK_Cell testCell = afk_cell(afk_vec4<int64_t>(
+                (corner & 1) ? 2 * topScale - scale : -topScale,
+                (corner & 2) ? 2 * topScale - scale : -topScale,
+                (corner & 4) ? 2 * topScale - scale : -topScale,
+                scale));
+            assert(afk_isPackable(testCell));
+
+            AFK_PackedCell packed = afk_packedCell(testCell);
+            if (packed == afk_unassignedPackedCell || afk_cell(packed) != testCell)
+            {
+                afk_out << testCell << " packed to " << std::hex << packed.v << std::dec <<
+                    " and came back as " << afk_cell(packed) << std::endl;
+                ++mismatches;
+            }
+        }
+    }
+
+    assert(afk_cell(afk_packedCell(afk_unassignedCell)) == afk_unassignedCell);
+    afk_out << "Packed cell mismatches: " << mismatches << std::endl;
+    afk_out << std::endl;
+    assert(mismatches == 0);
+}
+
 void test_tileHash(void)
 {
     test_tileHash(-1, 1);
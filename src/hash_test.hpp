@@ -22,6 +22,7 @@
 #include "tile.hpp"
 
 void test_cellHash(void);
+void test_packedCell(void);
 void test_tileHash(void);
 void test_rotate(void);
 
@@ -0,0 +1,238 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#include "afk.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+#include "horizon_buffer.hpp"
+
+
+/* AFK_HorizonBuffer implementation */
+
+bool AFK_HorizonBuffer::project(float x, float y, float z, Vec3<float>& o_projected) const
+{
+    Vec4<float> p = projection * afk_vec4<float>(x, y, z, 1.0f);
+
+    /* That's the same division as the visibility test does.  Points
+     * too close to (or behind) the lens don't count.
+     */
+    if (!(p.v[2] > 0.0f)) return false;
+    o_projected = afk_vec3<float>(p.v[0] / p.v[2], p.v[1] / p.v[2], p.v[2]);
+    return true;
+}
+
+float AFK_HorizonBuffer::pixelX(int i) const
+{
+    return -ar + (float)i * 2.0f * ar / (float)AFK_HORIZON_BUFFER_WIDTH;
+}
+
+float AFK_HorizonBuffer::pixelY(int j) const
+{
+    return -1.0f + (float)j * 2.0f / (float)AFK_HORIZON_BUFFER_HEIGHT;
+}
+
+int AFK_HorizonBuffer::toPixelX(float sx) const
+{
+    int i = (int)std::floor((sx + ar) * (float)AFK_HORIZON_BUFFER_WIDTH / (2.0f * ar));
+    return std::max(0, std::min(i, AFK_HORIZON_BUFFER_WIDTH - 1));
+}
+
+int AFK_HorizonBuffer::toPixelY(float sy) const
+{
+    int j = (int)std::floor((sy + 1.0f) * (float)AFK_HORIZON_BUFFER_HEIGHT / 2.0f);
+    return std::max(0, std::min(j, AFK_HORIZON_BUFFER_HEIGHT - 1));
+}
+
+void AFK_HorizonBuffer::rasterise(const Occluder& occluder)
+{
+    /* The top of the column, going round. */
+    Vec3<float> q[4];
+    if (!project(occluder.x, occluder.yTop, occluder.z, q[0]) ||
+        !project(occluder.x + occluder.scale, occluder.yTop, occluder.z, q[1]) ||
+        !project(occluder.x + occluder.scale, occluder.yTop, occluder.z + occluder.scale, q[2]) ||
+        !project(occluder.x, occluder.yTop, occluder.z + occluder.scale, q[3]))
+        return;
+
+    /* Across a plane, the reciprocal of the depth goes linearly
+     * with the screen co-ordinates, so I can fit it from three of
+     * the corners and then find the furthest depth in each pixel
+     * at that pixel's corners.
+     */
+    float det =
+        q[0].v[0] * (q[1].v[1] - q[2].v[1]) -
+        q[0].v[1] * (q[1].v[0] - q[2].v[0]) +
+        (q[1].v[0] * q[2].v[1] - q[2].v[0] * q[1].v[1]);
+    if (std::fabs(det) < FLT_EPSILON) return;
+
+    float r0 = 1.0f / q[0].v[2], r1 = 1.0f / q[1].v[2], r2 = 1.0f / q[2].v[2];
+    float invDepthX = (r0 * (q[1].v[1] - q[2].v[1]) + r1 * (q[2].v[1] - q[0].v[1]) + r2 * (q[0].v[1] - q[1].v[1])) / det;
+    float invDepthY = (r0 * (q[2].v[0] - q[1].v[0]) + r1 * (q[0].v[0] - q[2].v[0]) + r2 * (q[1].v[0] - q[0].v[0])) / det;
+    float invDepth0 = r0 - invDepthX * q[0].v[0] - invDepthY * q[0].v[1];
+
+    /* Which way round it's come out on the screen. */
+    float area = 0.0f;
+    for (int e = 0; e < 4; ++e)
+        area += q[e].v[0] * q[(e + 1) % 4].v[1] - q[(e + 1) % 4].v[0] * q[e].v[1];
+    if (std::fabs(area) < FLT_EPSILON) return;
+    float winding = (area > 0.0f ? 1.0f : -1.0f);
+
+    float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX;
+    for (int c = 0; c < 4; ++c)
+    {
+        minX = std::min(minX, q[c].v[0]);
+        maxX = std::max(maxX, q[c].v[0]);
+        minY = std::min(minY, q[c].v[1]);
+        maxY = std::max(maxY, q[c].v[1]);
+    }
+
+    if (maxX < -ar || minX > ar || maxY < -1.0f || minY > 1.0f) return;
+
+    auto inside = [&q, winding](float px, float py) -> bool
+    {
+        for (int e = 0; e < 4; ++e)
+        {
+            const Vec3<float>& a = q[e];
+            const Vec3<float>& b = q[(e + 1) % 4];
+            if (winding * ((b.v[0] - a.v[0]) * (py - a.v[1]) - (b.v[1] - a.v[1]) * (px - a.v[0])) < 0.0f)
+                return false;
+        }
+
+        return true;
+    };
+
+    /* The top is convex, so a pixel whose corners are all in it is
+     * entirely covered.
+     */
+    for (int j = toPixelY(minY); j <= toPixelY(maxY); ++j)
+    {
+        for (int i = toPixelX(minX); i <= toPixelX(maxX); ++i)
+        {
+            if (inside(pixelX(i), pixelY(j)) && inside(pixelX(i + 1), pixelY(j)) &&
+                inside(pixelX(i), pixelY(j + 1)) && inside(pixelX(i + 1), pixelY(j + 1)))
+            {
+                float minInvDepth = std::min(
+                    std::min(invDepthX * pixelX(i) + invDepthY * pixelY(j), invDepthX * pixelX(i + 1) + invDepthY * pixelY(j)),
+                    std::min(invDepthX * pixelX(i) + invDepthY * pixelY(j + 1), invDepthX * pixelX(i + 1) + invDepthY * pixelY(j + 1))) +
+                    invDepth0;
+                if (!(minInvDepth > 0.0f)) continue;
+
+                /* A little slack for the rounding. */
+                float maxDepth = 1.0001f / minInvDepth;
+                if (maxDepth < depths[j][i])
+                {
+                    depths[j][i] = maxDepth;
+                    empty = false;
+                }
+            }
+        }
+    }
+}
+
+AFK_HorizonBuffer::AFK_HorizonBuffer():
+    ar(1.0f)
+{
+    clear();
+}
+
+void AFK_HorizonBuffer::addOccluder(unsigned int threadId, const Vec3<float>& tileCoord, float yBoundLower)
+{
+    assert(threadId < AFK_MAX_THREADS);
+
+    /* Tiles whose bounds haven't come back yet are no use. */
+    if (yBoundLower == -FLT_MAX) return;
+
+    Occluder occluder;
+    occluder.x      = tileCoord.v[0];
+    occluder.z      = tileCoord.v[1];
+    occluder.scale  = tileCoord.v[2];
+    occluder.yTop   = yBoundLower - tileCoord.v[2];
+    lists[threadId].occluders.push_back(occluder);
+}
+
+unsigned int AFK_HorizonBuffer::build(const AFK_Camera& camera)
+{
+    clear();
+
+    projection = camera.getProjection();
+    Vec2<float> windowSize = camera.getWindowSize();
+    ar = windowSize.v[0] / windowSize.v[1];
+    float eyeY = camera.getEyeLocation().v[1];
+
+    unsigned int used = 0;
+    for (unsigned int t = 0; t < AFK_MAX_THREADS; ++t)
+    {
+        for (auto occluder : lists[t].occluders)
+        {
+            /* An occluder only works if I'm looking down on it. */
+            if (used < AFK_HORIZON_BUFFER_MAX_OCCLUDERS && occluder.yTop < eyeY)
+            {
+                rasterise(occluder);
+                ++used;
+            }
+        }
+
+        lists[t].occluders.clear();
+    }
+
+    return used;
+}
+
+void AFK_HorizonBuffer::clear(void)
+{
+    for (int j = 0; j < AFK_HORIZON_BUFFER_HEIGHT; ++j)
+        for (int i = 0; i < AFK_HORIZON_BUFFER_WIDTH; ++i)
+            depths[j][i] = FLT_MAX;
+
+    empty = true;
+}
+
+bool AFK_HorizonBuffer::occludes(const Vec4<float>& realCoord) const
+{
+    if (empty) return false;
+
+    float minDepth = FLT_MAX;
+    float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX;
+    for (int c = 0; c < 8; ++c)
+    {
+        Vec3<float> p;
+        if (!project(
+            realCoord.v[0] + ((c & 4) ? realCoord.v[3] : 0.0f),
+            realCoord.v[1] + ((c & 2) ? realCoord.v[3] : 0.0f),
+            realCoord.v[2] + ((c & 1) ? realCoord.v[3] : 0.0f),
+            p))
+            return false;
+
+        minDepth = std::min(minDepth, p.v[2]);
+        minX = std::min(minX, p.v[0]);
+        maxX = std::max(maxX, p.v[0]);
+        minY = std::min(minY, p.v[1]);
+        maxY = std::max(maxY, p.v[1]);
+    }
+
+    /* Off the screen is the frustum test's business, not mine. */
+    if (maxX < -ar || minX > ar || maxY < -1.0f || minY > 1.0f) return false;
+
+    for (int j = toPixelY(minY); j <= toPixelY(maxY); ++j)
+        for (int i = toPixelX(minX); i <= toPixelX(maxX); ++i)
+            if (!(depths[j][i] < minDepth)) return false;
+
+    return true;
+}
@@ -0,0 +1,125 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#ifndef _AFK_HORIZON_BUFFER_H_
+#define _AFK_HORIZON_BUFFER_H_
+
+#include "afk.hpp"
+
+#include <vector>
+
+#include "async/thread_allocation.hpp"
+#include "camera.hpp"
+#include "def.hpp"
+
+/* The horizon buffer is a coarse software depth buffer of the
+ * landscape, for throwing away cells that are hidden behind (or
+ * under) it before I go to the trouble of enumerating them.
+ *
+ * It's made of the landscape tiles that were displayed last frame.
+ * Each one has a y lower bound (read back by the y-reduce), and so
+ * I know that everything in its column below that bound is
+ * underground.  If the eye is above that, any line of sight that
+ * goes through the top of the column has met the terrain by the
+ * time it gets there, and can't see anything further on.  So each
+ * pixel that the top of the column entirely covers gets the
+ * furthest depth of that top, and a cell whose nearest depth is
+ * further than that across all of its pixels can't be seen.
+ *
+ * The bounds are only for the tile's own level of detail, and the
+ * finer tiles below it add their own features (which might dig
+ * deeper), so I drop the top of the column by a tile's scale to
+ * leave room for that.
+ */
+
+#define AFK_HORIZON_BUFFER_WIDTH    128
+#define AFK_HORIZON_BUFFER_HEIGHT   64
+
+/* I won't rasterise more occluders than this per frame. */
+#define AFK_HORIZON_BUFFER_MAX_OCCLUDERS 4096
+
+class AFK_HorizonBuffer
+{
+protected:
+    struct Occluder
+    {
+        float x, z, scale; /* the tile, in world space */
+        float yTop;
+    };
+
+    /* The occluders are collected by all the workers, each into
+     * its own list (padded apart).
+     */
+    struct OccluderList
+    {
+        std::vector<Occluder> occluders;
+        char pad[64];
+    };
+
+    OccluderList lists[AFK_MAX_THREADS];
+
+    /* The buffer itself, covering the screen from (-ar, -1) to
+     * (ar, 1) as in AFK_Camera::projectedPointIsVisible().
+     * Each entry is the nearest depth beyond which nothing at
+     * that pixel can be seen.
+     */
+    float depths[AFK_HORIZON_BUFFER_HEIGHT][AFK_HORIZON_BUFFER_WIDTH];
+
+    Mat4<float> projection;
+    float ar;
+    bool empty;
+
+    /* Projects a world space point into (screen x, screen y,
+     * depth).  Returns false if it's not in front of the camera.
+     */
+    bool project(float x, float y, float z, Vec3<float>& o_projected) const;
+
+    /* Pixel co-ordinate conversions. */
+    float pixelX(int i) const;
+    float pixelY(int j) const;
+    int toPixelX(float sx) const;
+    int toPixelY(float sy) const;
+
+    void rasterise(const Occluder& occluder);
+
+public:
+    AFK_HorizonBuffer();
+
+    AFK_HorizonBuffer(const AFK_HorizonBuffer& _buffer) = delete;
+    AFK_HorizonBuffer& operator=(const AFK_HorizonBuffer& _buffer) = delete;
+
+    /* Workers call this for each landscape tile they display.
+     * `tileCoord' is the tile's (x, z, scale) in world space.
+     */
+    void addOccluder(unsigned int threadId, const Vec3<float>& tileCoord, float yBoundLower);
+
+    /* The master thread calls this between enumerations, to
+     * rasterise the occluders collected so far for this camera
+     * (and throw them away).  Returns the number it used.
+     */
+    unsigned int build(const AFK_Camera& camera);
+
+    /* Forgets everything, so that nothing is occluded. */
+    void clear(void);
+
+    /* Tests whether a cell, given by its (x, y, z, scale) in world
+     * space, is definitely hidden.
+     */
+    bool occludes(const Vec4<float>& realCoord) const;
+};
+
+#endif /* _AFK_HORIZON_BUFFER_H_ */
@@ -189,6 +189,24 @@ void AFK_Jigsaw::flip(const AFK_Frame& currentFrame)
     map.flip(currentFrame);
 }
 
+void AFK_Jigsaw::commit(const AFK_Frame& currentFrame)
+{
+    map.commit(currentFrame);
+}
+
+void AFK_Jigsaw::promote(void)
+{
+    /* The same as flip(), but it's the ready Places that
+     * become the ones to push.
+     */
+    for (auto image : images) image->waitForAll();
+
+    havePushList = false;
+    pushList.clear();
+
+    map.promote();
+}
+
 void AFK_Jigsaw::printStats(std::ostream& os, const std::string& prefix)
 {
     map.printStats(os, prefix);
@@ -191,6 +191,10 @@ public:
      */
     void flip(const AFK_Frame& currentFrame);
 
+    /* The pipelined equivalents (see jigsaw_map.hpp). */
+    void commit(const AFK_Frame& currentFrame);
+    void promote(void);
+
     void printStats(std::ostream& os, const std::string& prefix);
 };
 
@@ -210,6 +210,22 @@ void AFK_JigsawCollection::flip(const AFK_Frame& currentFrame)
     });
 }
 
+void AFK_JigsawCollection::commit(const AFK_Frame& currentFrame)
+{
+    chain->foreach([&currentFrame](std::shared_ptr<AFK_Jigsaw> jigsaw)
+    {
+        jigsaw->commit(currentFrame);
+    });
+}
+
+void AFK_JigsawCollection::promote(void)
+{
+    chain->foreach([](std::shared_ptr<AFK_Jigsaw> jigsaw)
+    {
+        jigsaw->promote();
+    });
+}
+
 void AFK_JigsawCollection::printStats(std::ostream& os, const std::string& prefix)
 {
     int i = 0;
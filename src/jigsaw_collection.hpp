@@ -123,6 +123,10 @@ public:
     /* Flips the cuboids in all the jigsaws. */
     void flip(const AFK_Frame& currentFrame);
 
+    /* ...or commits and promotes them, for pipelining. */
+    void commit(const AFK_Frame& currentFrame);
+    void promote(void);
+
     void printStats(std::ostream& os, const std::string& prefix);
 };
 
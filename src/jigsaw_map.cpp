@@ -332,6 +332,32 @@ void AFK_JigsawMap::flip(const AFK_Frame& frame)
     pushed.insert(pushed.end(), updating.begin(), updating.end());
     updating.clear();
 
+    sweep(frame);
+}
+
+void AFK_JigsawMap::commit(const AFK_Frame& frame)
+{
+    std::unique_lock<std::mutex> lock(mut);
+
+    assert(ready.empty());
+    ready.insert(ready.end(), updating.begin(), updating.end());
+    updating.clear();
+
+    sweep(frame);
+}
+
+void AFK_JigsawMap::promote(void)
+{
+    std::unique_lock<std::mutex> lock(mut);
+
+    idle.insert(idle.end(), pushed.begin(), pushed.end());
+    pushed.clear();
+    pushed.insert(pushed.end(), ready.begin(), ready.end());
+    ready.clear();
+}
+
+void AFK_JigsawMap::sweep(const AFK_Frame& frame)
+{
     /* If the cleared list has fallen below minimum, clear
      * up to maximum.
      */
@@ -103,6 +103,11 @@ protected:
      */
     std::deque<AFK_JigsawPlace*> updating;
 
+    /* With pipelining, the Places that finished updating but
+     * whose frame hasn't been drawn yet.
+     */
+    std::deque<AFK_JigsawPlace*> ready;
+
     /* The queue of Places that are being pushed to the GPU. */
     std::deque<AFK_JigsawPlace*> pushed;
 
@@ -130,6 +135,11 @@ protected:
     /* This one gets a pointer to the place a piece is in. */
     AFK_JigsawPlace *findPiece(const Vec3<int>& piece) const;
 
+    /* Tops up the cleared list from the idle one.  Call with the
+     * lock held.
+     */
+    void sweep(const AFK_Frame& frame);
+
 public:
     AFK_JigsawMap(const Vec3<int>& _jigsawSize);
     virtual ~AFK_JigsawMap();
@@ -151,6 +161,15 @@ public:
     /* Rolls the queues about and prepares for the next frame. */
     void flip(const AFK_Frame& frame);
 
+    /* The pipelined equivalents of flip() (see fair.hpp).
+     * commit() is when the update phase finishes, and does the
+     * sweeping, because there aren't any workers about to be
+     * looking at the timestamps; promote() is when the frame
+     * starts being drawn.
+     */
+    void commit(const AFK_Frame& frame);
+    void promote(void);
+
     /* Prints and resets the stats. */
     void printStats(std::ostream& os, const std::string& prefix);
 };
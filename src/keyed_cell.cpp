@@ -17,8 +17,11 @@
 
 #include "afk.hpp"
 
+#include <cassert>
+
 #include "core.hpp"
 #include "keyed_cell.hpp"
+#include "rng/hash.hpp"
 
 /* AFK_KeyedCell implementation */
 
@@ -98,3 +101,72 @@ std::ostream& operator<<(std::ostream& os, const AFK_KeyedCell& cell)
         cell.key << ")";
 }
 
+
+/* AFK_PackedKeyedCell implementation */
+
+bool afk_isPackable(const AFK_KeyedCell& cell)
+{
+    if (cell.c.coord.v[3] <= 0 || (cell.c.coord.v[3] & (cell.c.coord.v[3] - 1)) != 0) return false;
+    if (cell.key < 0 || cell.key >= (1ll << AFK_PACKED_KEYED_CELL_KEY_BITS)) return false;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        if (cell.c.coord.v[i] < -AFK_PACKED_KEYED_CELL_RANGE ||
+            cell.c.coord.v[i] >= AFK_PACKED_KEYED_CELL_RANGE) return false;
+    }
+
+    return true;
+}
+
+AFK_PackedKeyedCell afk_packedKeyedCell(const AFK_KeyedCell& cell)
+{
+    AFK_PackedKeyedCell packed;
+    if (cell == afk_unassignedKeyedCell)
+    {
+        packed.v = ~0ull;
+    }
+    else
+    {
+        assert(afk_isPackable(cell));
+        packed.v = afk_packScale(cell.c.coord.v[3]);
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            packed.v |= afk_packSigned(cell.c.coord.v[i],
+                AFK_PACKED_SCALE_BITS + i * AFK_PACKED_KEYED_CELL_COORD_BITS, AFK_PACKED_KEYED_CELL_COORD_BITS);
+        }
+
+        packed.v |= static_cast<uint64_t>(cell.key) << (AFK_PACKED_SCALE_BITS + 3 * AFK_PACKED_KEYED_CELL_COORD_BITS);
+    }
+
+    return packed;
+}
+
+AFK_KeyedCell afk_keyedCell(const AFK_PackedKeyedCell& packed)
+{
+    if (packed == afk_unassignedPackedKeyedCell) return afk_unassignedKeyedCell;
+
+    Vec4<int64_t> coord;
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        coord.v[i] = afk_unpackSigned(packed.v,
+            AFK_PACKED_SCALE_BITS + i * AFK_PACKED_KEYED_CELL_COORD_BITS, AFK_PACKED_KEYED_CELL_COORD_BITS);
+    }
+
+    coord.v[3] = 1ll << (packed.v & AFK_PACKED_SCALE_MASK);
+    int64_t key = static_cast<int64_t>(
+        (packed.v >> (AFK_PACKED_SCALE_BITS + 3 * AFK_PACKED_KEYED_CELL_COORD_BITS)) &
+        ((1ull << AFK_PACKED_KEYED_CELL_KEY_BITS) - 1));
+    return afk_keyedCell(coord, key);
+}
+
+const AFK_PackedKeyedCell afk_unassignedPackedKeyedCell = { ~0ull };
+
+size_t hash_value(const AFK_PackedKeyedCell& packed)
+{
+    return afk_hash_swizzle(0, packed.v);
+}
+
+std::ostream& operator<<(std::ostream& os, const AFK_PackedKeyedCell& packed)
+{
+    return os << "Packed" << afk_keyedCell(packed);
+}
@@ -67,5 +67,49 @@ BOOST_STATIC_ASSERT((boost::has_trivial_assign<AFK_KeyedCell>::value));
 BOOST_STATIC_ASSERT((boost::has_trivial_constructor<AFK_KeyedCell>::value));
 BOOST_STATIC_ASSERT((boost::has_trivial_destructor<AFK_KeyedCell>::value));
 
+/* A PackedKeyedCell is the 64-bit form of a KeyedCell, for keying
+ * the shape and vapour caches and for the shape work items.
+ * Keyed cells live in their own shape space, which starts at
+ * SHAPE_CELL_MAX_DISTANCE and never strays far from the origin, so
+ * these don't need an origin to pack against: it's 6 bits of
+ * log2(scale), then x, y and z as AFK_PACKED_KEYED_CELL_COORD_BITS-bit
+ * signed values, then the key as an unsigned
+ * AFK_PACKED_KEYED_CELL_KEY_BITS-bit value.
+ */
+#define AFK_PACKED_KEYED_CELL_COORD_BITS 16
+#define AFK_PACKED_KEYED_CELL_RANGE (1ll << (AFK_PACKED_KEYED_CELL_COORD_BITS - 1))
+#define AFK_PACKED_KEYED_CELL_KEY_BITS 9
+
+class AFK_PackedKeyedCell
+{
+public:
+    uint64_t v;
+
+    bool operator==(const AFK_PackedKeyedCell& _cell) const { return v == _cell.v; }
+    bool operator==(const AFK_PackedKeyedCell& _cell) const volatile { return v == _cell.v; }
+    bool operator!=(const AFK_PackedKeyedCell& _cell) const { return v != _cell.v; }
+};
+
+bool afk_isPackable(const AFK_KeyedCell& cell);
+
+AFK_PackedKeyedCell afk_packedKeyedCell(const AFK_KeyedCell& cell);
+AFK_KeyedCell afk_keyedCell(const AFK_PackedKeyedCell& packed);
+
+extern const AFK_PackedKeyedCell afk_unassignedPackedKeyedCell;
+
+size_t hash_value(const AFK_PackedKeyedCell& packed);
+
+struct AFK_HashPackedKeyedCell
+{
+    size_t operator()(const AFK_PackedKeyedCell& packed) const { return hash_value(packed); }
+};
+
+std::ostream& operator<<(std::ostream& os, const AFK_PackedKeyedCell& packed);
+
+BOOST_STATIC_ASSERT((sizeof(AFK_PackedKeyedCell) == sizeof(uint64_t)));
+BOOST_STATIC_ASSERT((boost::has_trivial_assign<AFK_PackedKeyedCell>::value));
+BOOST_STATIC_ASSERT((boost::has_trivial_constructor<AFK_PackedKeyedCell>::value));
+BOOST_STATIC_ASSERT((boost::has_trivial_destructor<AFK_PackedKeyedCell>::value));
+
 #endif /* _AFK_KEYED_CELL_H_ */
 
@@ -95,7 +95,7 @@ void AFK_LandscapeDisplayQueue::draw(
         {
             if (checked[i]) continue;
 
-            auto entry = cache->get(threadId, landscapeTiles[i]);
+            auto entry = cache->get(threadId, afk_packedTile(landscapeTiles[i]));
             if (entry)
             {
                 auto claim = entry->claimable.claimInplace(threadId, AFK_CL_SHARED);
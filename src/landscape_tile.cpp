@@ -17,6 +17,7 @@
 
 #include "afk.hpp"
 
+#include <algorithm>
 #include <cfloat>
 #include <sstream>
 
@@ -127,84 +128,48 @@ void AFK_LandscapeTile::buildTerrainList(
     unsigned int subdivisionFactor,
     float maxDistance,
     AFK_LANDSCAPE_CACHE *cache,
-    std::vector<AFK_Tile>& missing) const
+    AFK_FramePackedTileVector& missing) const
 {
-    AFK_DEBUG_PRINTL_LANDSCAPE_BUILD("buildTerrainList(): adding local terrain for " << tile << " (terrain tiles " << AFK_InnerDebug<TileArray>(&terrainTiles) << ")")
-
-    /* Add the local terrain tiles to the list,
-     * but only if there aren't any missing already
-     * (otherwise it's a waste of time)
+    /* Work out the chain of ancestor tiles, up to the top level
+     * tile, and claim the lot in one go, coarsest first.
      */
-    if (missing.empty())
-        list.extend<FeatureArray, TileArray>(terrainFeatures, terrainTiles);
-
-    /* If this isn't the top level tile... */
-    AFK_Tile thisTile = tile;
-    while (thisTile.coord.v[2] < maxDistance)
+    AFK_FramePackedTileVector ancestors(missing.get_allocator());
+    for (AFK_Tile thisTile = tile; thisTile.coord.v[2] < maxDistance; )
     {
-        /* Find the parent tile in the cache. */
-        AFK_Tile parentTile = thisTile.parent(subdivisionFactor);
+        thisTile = thisTile.parent(subdivisionFactor);
+        ancestors.push_back(afk_packedTile(thisTile));
+    }
 
-        AFK_DEBUG_PRINTL_LANDSCAPE_BUILD("buildTerrainList(): looking for terrain for " << parentTile)
+    std::reverse(ancestors.begin(), ancestors.end());
 
-        auto parentLandscapeTileClaim = cache->getAndClaimInplace(threadId, parentTile, AFK_CL_LOOP | AFK_CL_SHARED);
-        if (parentLandscapeTileClaim.isValid())
-        {
-            parentLandscapeTileClaim.getShared().buildTerrainList(threadId, list, parentTile, subdivisionFactor, maxDistance, cache, missing);
-            return;
-        }
-        else
-        {
-            /* That tile is missing.  Continue looking for
-             * higher level tiles anyway.
-             */
-            AFK_DEBUG_PRINTL_LANDSCAPE_BUILD("buildTerrainList(): tile " << parentTile << " missing")
-            missing.push_back(parentTile);
-            thisTile = parentTile;
-        }
+    AFK_DEBUG_PRINTL_LANDSCAPE_BUILD("buildTerrainList(): looking for terrain for " << ancestors.size() << " ancestors of " << tile)
+
+    auto ancestorClaims = cache->getAndClaimChainInplace(
+        threadId, ancestors, AFK_CL_LOOP | AFK_CL_SHARED, &missing, AFK_LANDSCAPE_READ_BIASED_LEVELS);
+    if (!ancestorClaims.isValid())
+    {
+        /* Some of those tiles are missing, and have been added to
+         * the missing list.  (It's a waste of time building the
+         * list now.)
+         */
+        AFK_DEBUG_PRINTL_LANDSCAPE_BUILD("buildTerrainList(): " << missing.size() << " tiles missing")
+        return;
     }
-}
 
-void AFK_LandscapeTile::buildTerrainList(
-    unsigned int threadId,
-    AFK_TerrainList& list,
-    const AFK_Tile& tile,
-    unsigned int subdivisionFactor,
-    float maxDistance,
-    AFK_LANDSCAPE_CACHE *cache,
-    std::vector<AFK_Tile>& missing) const volatile
-{
-    AFK_DEBUG_PRINTL_LANDSCAPE_BUILD("buildTerrainList(): adding local terrain for volatile tile " << tile)
+    /* The list goes from this tile outwards: the local terrain tiles
+     * first, then the parents', finest to coarsest.
+     */
+    AFK_DEBUG_PRINTL_LANDSCAPE_BUILD("buildTerrainList(): adding local terrain for " << tile << " (terrain tiles " << AFK_InnerDebug<TileArray>(&terrainTiles) << ")")
+    list.extend<FeatureArray, TileArray>(terrainFeatures, terrainTiles);
 
-    if (missing.empty())
+    for (size_t i = ancestorClaims.size(); i > 0; --i)
+    {
+        const volatile AFK_LandscapeTile& ancestor = ancestorClaims.at(i - 1).getShared();
         list.extendInplaceTiles(
             reinterpret_cast<const volatile AFK_TerrainFeature *>(
-                reinterpret_cast<const volatile char *>(this) + afk_getLandscapeTileFeaturesOffset()),
+                reinterpret_cast<const volatile char *>(&ancestor) + afk_getLandscapeTileFeaturesOffset()),
             reinterpret_cast<const volatile AFK_TerrainTile *>(
-                reinterpret_cast<const volatile char *>(this) + afk_getLandscapeTileTilesOffset()));
-
-    AFK_Tile thisTile = tile;
-    while (thisTile.coord.v[2] < maxDistance)
-    {
-        AFK_Tile parentTile = tile.parent(subdivisionFactor);
-
-        AFK_DEBUG_PRINTL_LANDSCAPE_BUILD("buildTerrainList(): looking for terrain for " << parentTile)
-
-        auto parentLandscapeTileClaim = cache->getAndClaimInplace(threadId, parentTile, AFK_CL_LOOP | AFK_CL_SHARED);
-        if (parentLandscapeTileClaim.isValid())
-        {
-            parentLandscapeTileClaim.getShared().buildTerrainList(threadId, list, parentTile, subdivisionFactor, maxDistance, cache, missing);
-            return;
-        }
-        else
-        {
-            /* That tile is missing.  Continue looking for
-             * higher level tiles anyway.
-             */
-            AFK_DEBUG_PRINTL_LANDSCAPE_BUILD("buildTerrainList(): tile " << parentTile << " missing")
-            missing.push_back(parentTile);
-            thisTile = parentTile;
-        }
+                reinterpret_cast<const volatile char *>(&ancestor) + afk_getLandscapeTileTilesOffset()));
     }
 }
 
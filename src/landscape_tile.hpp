@@ -51,6 +51,12 @@ enum AFK_LandscapeTileArtworkState
     AFK_LANDSCAPE_TILE_HAS_ARTWORK
 };
 
+/* How many of the coarsest ancestor tiles buildTerrainList()
+ * claims read-biased.  These are read by nearly every worker
+ * every frame and written only when first made.
+ */
+#define AFK_LANDSCAPE_READ_BIASED_LEVELS 2
+
 /* Utilities. */
 ptrdiff_t afk_getLandscapeTileFeaturesOffset(void);
 ptrdiff_t afk_getLandscapeTileTilesOffset(void);
@@ -105,8 +111,11 @@ public:
 
     /* Builds the terrain list for this tile.  Call it with
      * an empty list.
+     * The ancestor tiles are claimed all together (inplace),
+     * coarsest first, the top few with AFK_CL_READ_BIAS.
      * If tiles are missing, fills out the `missing' list:
      * you'll need to render all those tiles then resume.
+     * The ancestor list comes out of the same arena as that one.
      */
     void buildTerrainList(
         unsigned int threadId,
@@ -115,19 +124,7 @@ public:
         unsigned int subdivisionFactor,
         float maxDistance,
         AFK_LANDSCAPE_CACHE *cache,
-        std::vector<AFK_Tile>& missing) const;
-
-    /* This version so that I can use an inplace claim and
-     * save a copy.
-     */
-    void buildTerrainList(
-        unsigned int threadId,
-        AFK_TerrainList& list,
-        const AFK_Tile& tile,
-        unsigned int subdivisionFactor,
-        float maxDistance,
-        AFK_LANDSCAPE_CACHE *cache,
-        std::vector<AFK_Tile>& missing) const volatile;
+        AFK_FramePackedTileVector& missing) const;
 
     /* Assigns a jigsaw piece to this tile. */
     AFK_JigsawPiece getJigsawPiece(unsigned int threadId, int minJigsaw, AFK_JigsawCollection *_jigsaws);
@@ -135,6 +132,8 @@ public:
     enum AFK_LandscapeTileArtworkState artworkState(AFK_JigsawCollection *jigsaws) const;
     float getYBoundLower() const { return yBoundLower; }
     float getYBoundUpper() const { return yBoundUpper; }
+    float getYBoundLower() const volatile { return yBoundLower; }
+    float getYBoundUpper() const volatile { return yBoundUpper; }
 
     /* Supply new y bounds _in tile space_ (that's easiest
      * for the yReduce kernel)
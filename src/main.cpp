@@ -23,24 +23,29 @@
 #include "async/async_test.hpp"
 #include "data/cache_test.hpp"
 #include "data/chain_link_test.hpp"
+#include "data/claimable_test.hpp"
 #include "file/logstream.hpp"
 #include "hash_test.hpp"
 #include "rng/boost_taus88.hpp"
 #include "rng/rng_test.hpp"
 #include "test_jigsaw_fake3d.hpp"
+#include "visible_cell_test.hpp"
 
 #include "clock.hpp"
 #include "core.hpp"
 #include "exception.hpp"
+#include "trace.hpp"
 
 
 #define TEST_ASYNC 0
 #define TEST_CACHE 0
 #define TEST_CHAIN_LINK 0
+#define TEST_CLAIMABLE 0
 #define TEST_HASH 0
 #define TEST_JIGSAW_FAKE3D 0
 #define TEST_RNGS 0
 #define TEST_SUBSTRATE 0
+#define TEST_VISIBLE_CELL 0
 
 
 /* This is the AFK global core declared in core.hpp */
@@ -77,6 +82,7 @@ int main(int argc, char **argv)
 
 #if TEST_CACHE
     test_cache();
+    test_evictableCacheScan();
     afk_waitForKeyPress();
 #endif
 
@@ -94,10 +100,17 @@ int main(int argc, char **argv)
     afk_waitForKeyPress();
 #endif
 
+#if TEST_CLAIMABLE
+    test_readBiasCollisions();
+    test_readBias();
+    afk_waitForKeyPress();
+#endif
+
 #if TEST_HASH
     test_rotate();
     test_tileHash();
     test_cellHash();
+    test_packedCell();
     afk_waitForKeyPress();
 #endif
 
@@ -112,6 +125,7 @@ int main(int argc, char **argv)
 #endif
 
     bool hitLoop = false;
+    std::string traceFile;
     try
     {
         afk_core.configure(&argc, argv);
@@ -120,6 +134,10 @@ int main(int argc, char **argv)
         std::string logFile = afk_core.settings.logFile;
         if (logFile.size() > 0) afk_out.setLogFile(logFile);
 
+        /* ...and the tracer, if I've been asked for one. */
+        traceFile = afk_core.settings.traceFile;
+        if (traceFile.size() > 0) afk_tracer.enable();
+
         /* Banner. */
         afk_out << "AFK v0.2.1-test" << std::endl;
         afk_out << "Copyright (C) 2013-2014, Alex Holloway" << std::endl;
@@ -141,6 +159,13 @@ int main(int argc, char **argv)
         afk_waitForKeyPress();
 #endif
 
+        /* Likewise, the visible cell test wants the camera settings. */
+#if TEST_VISIBLE_CELL
+        test_visibleCell();
+        test_detailPitch();
+        afk_waitForKeyPress();
+#endif
+
         afk_out << "AFK initalising graphics" << std::endl;
         afk_core.initGraphics();
 
@@ -163,6 +188,8 @@ int main(int argc, char **argv)
         }
     }
 
+    if (afk_tracer.isEnabled()) afk_tracer.write(traceFile);
+
     afk_out << "AFK exiting" << std::endl;
     return retcode;
 }
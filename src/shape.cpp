@@ -27,6 +27,7 @@
 #include "entity_display_queue.hpp"
 #include "jigsaw.hpp"
 #include "shape.hpp"
+#include "trace.hpp"
 #include "vapour_cell.hpp"
 #include "world.hpp"
 
@@ -35,21 +36,24 @@
 #define AFK_SCG_FLAG_ENTIRELY_VISIBLE       1
 
 /* The top-level entity worker. */
-bool afk_generateEntity(
+struct AFK_WorldWorkResult afk_generateEntity(
     unsigned int threadId,
     const union AFK_WorldWorkParam& param,
     const struct AFK_WorldWorkThreadLocal& threadLocal,
     AFK_WorldWorkQueue& queue)
 {
-    AFK_KeyedCell cell                      = param.shape.cell;
+    AFK_TRACE_SCOPE(threadId, "generateEntity")
+
+    AFK_KeyedCell cell                      = afk_keyedCell(param.shape.cell);
     AFK_World *world                        = afk_core.world;
 
     AFK_Shape& shape                        = world->shape;
 
+    struct AFK_WorldWorkResult result;
     bool needsResume = false;
 
     AFK_KeyedCell vc = afk_shapeToVapourCell(cell, world->sSizes);
-    auto claim = shape.vapourCellCache->insertAndClaim(threadId, vc, AFK_CL_BLOCK | AFK_CL_UPGRADE);
+    auto claim = shape.vapourCellCache->insertAndClaim(threadId, afk_packedKeyedCell(vc), AFK_CL_BLOCK | AFK_CL_UPGRADE);
     if (claim.isValid())
     {    
         if (!claim.getShared().hasDescriptor())
@@ -62,7 +66,7 @@ bool afk_generateEntity(
                 if (!vapourCell.hasDescriptor())
                 {
                     vapourCell.makeDescriptor(vc, world->sSizes);
-                    world->separateVapoursComputed.fetch_add(1);
+                    ++result.separateVapoursComputed;
                 }
             }
         }
@@ -76,7 +80,7 @@ bool afk_generateEntity(
                 AFK_KeyedCell nextCell = shapeCells.next();
 
                 /* Track the volume I'm enumerating here */
-                world->volumeLeftToEnumerate.fetch_add(CUBE(nextCell.c.coord.v[3]));
+                world->volumeLeftToEnumerate.add(threadId, CUBE(nextCell.c.coord.v[3]));
         
                 /* Enqueue this shape cell. */
                 /* TODO I think I've actually forgotten to do the
@@ -89,9 +93,9 @@ bool afk_generateEntity(
                 AFK_WorldWorkQueue::WorkItem shapeCellItem;
                 shapeCellItem.func = afk_generateShapeCells;
                 shapeCellItem.param = param;
-                shapeCellItem.param.shape.cell = nextCell;
+                shapeCellItem.param.shape.cell = afk_packedKeyedCell(nextCell);
                 shapeCellItem.param.shape.dependency = nullptr;
-                queue.push(shapeCellItem);
+                queue.push(threadId, shapeCellItem);
             }
         }
         else
@@ -108,7 +112,7 @@ bool afk_generateEntity(
     if (needsResume)
     {
         /* I'm about to want to enumerate this volume again */
-        world->volumeLeftToEnumerate.fetch_add(CUBE(cell.c.coord.v[3]));
+        world->volumeLeftToEnumerate.add(threadId, CUBE(cell.c.coord.v[3]));
 
         AFK_WorldWorkQueue::WorkItem resumeItem;
         resumeItem.func = afk_generateEntity;
@@ -116,23 +120,23 @@ bool afk_generateEntity(
         if (param.shape.dependency) param.shape.dependency->retain();
         queue.push(resumeItem);
 
-        world->shapeCellsResumed.fetch_add(1);
+        ++result.shapeCellsResumed;
     }
 
     /* If this cell had a dependency ... */
     if (param.shape.dependency)
     {
-        if (param.shape.dependency->check(queue))
+        if (param.shape.dependency->check(threadId, queue))
         {
-            world->dependenciesFollowed.fetch_add(1);
-            delete param.shape.dependency;
+            ++result.dependenciesFollowed;
+            world->dependencyPool.free(threadId, param.shape.dependency);
         }
     }
 
     /* I've finished with this cell */
-    world->volumeLeftToEnumerate.fetch_sub(CUBE(cell.c.coord.v[3]));
+    world->volumeLeftToEnumerate.remove(threadId, CUBE(cell.c.coord.v[3]));
 
-    return true;
+    return result;
 }
 
 /* The shape worker */
@@ -145,13 +149,15 @@ bool afk_generateEntity(
 #define DEBUG_VISIBLE_CELL(message)
 #endif
 
-bool afk_generateShapeCells(
+struct AFK_WorldWorkResult afk_generateShapeCells(
     unsigned int threadId,
     const union AFK_WorldWorkParam& param,
     const struct AFK_WorldWorkThreadLocal& threadLocal,
     AFK_WorldWorkQueue& queue)
 {
-    const AFK_KeyedCell cell                = param.shape.cell;
+    AFK_TRACE_SCOPE(threadId, "generateShapeCells")
+
+    const AFK_KeyedCell cell                = afk_keyedCell(param.shape.cell);
     Mat4<float> worldTransform              = param.shape.transformation;
     const AFK_Camera& camera                = threadLocal.camera;
     const Vec3<float>& viewerLocation       = threadLocal.viewerLocation;
@@ -162,6 +168,7 @@ bool afk_generateShapeCells(
 
     AFK_Shape& shape                        = world->shape;
 
+    struct AFK_WorldWorkResult result;
     bool needsResume = false;
 
     /* Check for visibility. */
@@ -179,13 +186,14 @@ bool afk_generateShapeCells(
 #endif
 
         DEBUG_VISIBLE_CELL("invisible")
-        world->shapeCellsInvisible.fetch_add(1);
+        ++result.shapeCellsInvisible;
     }
     else
     {
         bool display = (
             cell.c.coord.v[3] == 1 || visibleCell.testDetailPitch(
-                world->getEntityDetailPitch(threadLocal.detailPitch), camera, viewerLocation));
+                world->getEntityDetailPitch(threadLocal.detailPitch), camera, viewerLocation,
+                world->sphereDetailPitchTolerance));
 
         /* Always build the vapour descriptor, because other cells
          * will need it.
@@ -193,7 +201,7 @@ bool afk_generateShapeCells(
          * cell, however.
          */
         AFK_KeyedCell vc = afk_shapeToVapourCell(cell, world->sSizes);
-        auto vapourCellClaim = shape.vapourCellCache->insertAndClaim(threadId, vc, AFK_CL_BLOCK | AFK_CL_UPGRADE);
+        auto vapourCellClaim = shape.vapourCellCache->insertAndClaim(threadId, afk_packedKeyedCell(vc), AFK_CL_BLOCK | AFK_CL_UPGRADE);
         if (vapourCellClaim.isValid())
         {
             const AFK_VapourCell& vapourCell = vapourCellClaim.getShared();
@@ -208,7 +216,7 @@ bool afk_generateShapeCells(
                      */
                     AFK_KeyedCell upperVC = vc.parent(world->sSizes.subdivisionFactor);
                     auto upperVapourCellClaim =
-                        shape.vapourCellCache->getAndClaim(threadId, upperVC, AFK_CL_BLOCK | AFK_CL_SHARED);
+                        shape.vapourCellCache->getAndClaim(threadId, afk_packedKeyedCell(upperVC), AFK_CL_BLOCK | AFK_CL_SHARED);
                     if (upperVapourCellClaim.isValid())
                         vapourCellClaim.get().makeDescriptor(vc, upperVC, upperVapourCellClaim.getShared(), world->sSizes);
                 }
@@ -227,7 +235,7 @@ bool afk_generateShapeCells(
                 if (vapourCell.withinSkeleton(vc, cell, world->sSizes))
                 {
                     /* I want that shape cell now ... */
-                    auto shapeCellClaim = shape.shapeCellCache->insertAndClaim(threadId, cell, AFK_CL_BLOCK | AFK_CL_UPGRADE);
+                    auto shapeCellClaim = shape.shapeCellCache->insertAndClaim(threadId, afk_packedKeyedCell(cell), AFK_CL_BLOCK | AFK_CL_UPGRADE);
                     if (shapeCellClaim.isValid())
                     {
                         if (shapeCellClaim.getShared().getDMin() < 0.0f &&
@@ -239,7 +247,7 @@ bool afk_generateShapeCells(
                             if (display) 
                             {
                                 if (!shape.generateClaimedShapeCell(
-                                    threadId, vc, cell, vapourCellClaim, shapeCellClaim, worldTransform))
+                                    threadId, vc, cell, vapourCellClaim, shapeCellClaim, worldTransform, result))
                                 {
                                     DEBUG_VISIBLE_CELL("needs resume")
                                     needsResume = true;
@@ -260,10 +268,10 @@ bool afk_generateShapeCells(
                                 shapeCellClaim.release();
             
                                 /* I'm about to enumerate this cell's volume in subcells */
-                                world->volumeLeftToEnumerate.fetch_add(CUBE(cell.c.coord.v[3]));
+                                world->volumeLeftToEnumerate.add(threadId, CUBE(cell.c.coord.v[3]));
              
                                 size_t subcellsSize = CUBE(world->sSizes.subdivisionFactor);
-                                AFK_Cell *subcells = new AFK_Cell[subcellsSize];
+                                AFK_Cell *subcells = world->frameArenas[threadId].allocArray<AFK_Cell>(subcellsSize);
                                 unsigned int subcellsCount = cell.c.subdivide(subcells, subcellsSize, world->sSizes.subdivisionFactor);
                                 assert(subcellsCount == subcellsSize);
              
@@ -272,23 +280,21 @@ bool afk_generateShapeCells(
                                     AFK_WorldWorkQueue::WorkItem subcellItem;
                                     subcellItem.func                            = afk_generateShapeCells;
                                     subcellItem.param                           = param;
-                                    subcellItem.param.shape.cell                = afk_keyedCell(subcells[i], cell.key);
+                                    subcellItem.param.shape.cell                = afk_packedKeyedCell(afk_keyedCell(subcells[i], cell.key));
                                     subcellItem.param.shape.flags               = (allVisible ? AFK_SCG_FLAG_ENTIRELY_VISIBLE : 0);
                                     subcellItem.param.shape.dependency          = nullptr;
-                                    queue.push(subcellItem);
+                                    queue.push(threadId, subcellItem);
              
 #if AFK_SHAPE_ENUM_DEBUG
                                     AFK_DEBUG_PRINTL("ASED: Shape cell " << cell << " of entity: worldCell=" << param.shape.asedWorldCell << ", entity counter=" << param.shape.asedCounter << " recursed")
 #endif
                                 }
-                        
-                                delete[] subcells;
                             }
                         }
                         else
                         {
                             DEBUG_VISIBLE_CELL("empty or solid")
-                            world->shapeCellsReducedOut.fetch_add(1);
+                            ++result.shapeCellsReducedOut;
                         }
                     }
                     else
@@ -320,7 +326,7 @@ bool afk_generateShapeCells(
     if (needsResume)
     {
         /* Add the resume volume to the amount left */
-        world->volumeLeftToEnumerate.fetch_add(CUBE(cell.c.coord.v[3]));
+        world->volumeLeftToEnumerate.add(threadId, CUBE(cell.c.coord.v[3]));
 
         AFK_WorldWorkQueue::WorkItem resumeItem;
         resumeItem.func = afk_generateShapeCells;
@@ -328,23 +334,23 @@ bool afk_generateShapeCells(
         if (param.shape.dependency) param.shape.dependency->retain();
         queue.push(resumeItem);
 
-        world->shapeCellsResumed.fetch_add(1);
+        ++result.shapeCellsResumed;
     }
 
     /* If this cell had a dependency ... */
     if (param.shape.dependency)
     {
-        if (param.shape.dependency->check(queue))
+        if (param.shape.dependency->check(threadId, queue))
         {
-            world->dependenciesFollowed.fetch_add(1);
-            delete param.shape.dependency;
+            ++result.dependenciesFollowed;
+            world->dependencyPool.free(threadId, param.shape.dependency);
         }
     }
 
     /* I have finished this cell and can check its volume off */
-    world->volumeLeftToEnumerate.fetch_sub(CUBE(cell.c.coord.v[3]));
+    world->volumeLeftToEnumerate.remove(threadId, CUBE(cell.c.coord.v[3]));
 
-    return true;
+    return result;
 }
 
 
@@ -356,7 +362,8 @@ bool AFK_Shape::generateClaimedShapeCell(
     const AFK_KeyedCell& cell,
     AFK_VAPOUR_CELL_CACHE::Claim& vapourCellClaim,
     AFK_SHAPE_CELL_CACHE::Claim& shapeCellClaim,
-    const Mat4<float>& worldTransform)
+    const Mat4<float>& worldTransform,
+    struct AFK_WorldWorkResult& result)
 {
     AFK_World *world                        = afk_core.world;
 
@@ -384,7 +391,7 @@ bool AFK_Shape::generateClaimedShapeCell(
                 int adjacency = vapourCellClaim.getShared().skeletonFullAdjacency(vc, cell, world->sSizes);
                 shapeCellClaim.get().enqueueVapourComputeUnitFromExistingVapour(
                     threadId, adjacency, cubeOffset, cubeCount, cell, world->sSizes, vapourJigsaws, world->vapourComputeFair);
-                world->shapeVapoursComputed.fetch_add(1);
+                ++result.shapeVapoursComputed;
 
 #if AFK_SHAPE_ENUM_DEBUG
                 AFK_DEBUG_PRINTL("ASED: Shape cell " << cell << ": enqueueing existing vapour with " << cubeCount << " cubes from " << cubeOffset << ", from " << vc)
@@ -397,14 +404,14 @@ bool AFK_Shape::generateClaimedShapeCell(
                 {
                     AFK_VapourCell& vapourCell = vapourCellClaim.get();
 
-                    AFK_3DList list;
-                    if (vapourCell.build3DList(threadId, vc, list, world->sSizes, vapourCellCache))
+                    AFK_3DList list(&world->frameArenas[threadId]);
+                    if (vapourCell.build3DList(threadId, vc, list, world->sSizes, vapourCellCache, &world->frameArenas[threadId]))
                     {
                         int adjacency = vapourCell.skeletonFullAdjacency(vc, cell, world->sSizes);
                         shapeCellClaim.get().enqueueVapourComputeUnitWithNewVapour(
                             threadId, adjacency, list, cell, world->sSizes, vapourJigsaws, world->vapourComputeFair, cubeOffset, cubeCount);
                         vapourCell.enqueued(cubeOffset, cubeCount);
-                        world->shapeVapoursComputed.fetch_add(1);
+                        ++result.shapeVapoursComputed;
 #if AFK_SHAPE_ENUM_DEBUG
                         AFK_DEBUG_PRINTL("ASED: Shape cell " << cell << ": generated new vapour with " << list.cubeCount() << " cubes at " << vc)
 #endif
@@ -430,7 +437,7 @@ bool AFK_Shape::generateClaimedShapeCell(
             {
                 shapeCellClaim.get().enqueueEdgeComputeUnit(
                     threadId, shapeCellCache, vapourJigsaws, edgeJigsaws, world->edgeComputeFair, world->entityFair2DIndex);
-                world->shapeEdgesComputed.fetch_add(1);
+                ++result.shapeEdgesComputed;
 
 #if AFK_SHAPE_ENUM_DEBUG
                 AFK_DEBUG_PRINTL("ASED: Shape cell " << cell << ": generated edges from vapour at " << vc)
@@ -467,7 +474,7 @@ AFK_Shape::AFK_Shape(
         (2 * settings.shape_skeletonMaxSize * 6 * SQUARE(afk_shapePointSubdivisionFactor));
     shapeCellCache = new AFK_SHAPE_CELL_CACHE(
         4,
-        AFK_HashKeyedCell(),
+        AFK_HashPackedKeyedCell(),
         shapeCellCacheEntries / 2,
         threadAlloc.getNewId());
 
@@ -475,7 +482,7 @@ AFK_Shape::AFK_Shape(
         (2 * settings.shape_skeletonMaxSize * CUBE(afk_shapePointSubdivisionFactor));
     vapourCellCache = new AFK_VAPOUR_CELL_CACHE(
         4,
-        AFK_HashKeyedCell(),
+        AFK_HashPackedKeyedCell(),
         vapourCellCacheEntries / 2,
         threadAlloc.getNewId());
 }
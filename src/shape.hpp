@@ -56,7 +56,7 @@ enum AFK_ShapeArtworkState
  * You should enqueue it with the top level cell (0, 0, 0,
  * SHAPE_CELL_MAX_DISTANCE).
  */
-bool afk_generateEntity(
+struct AFK_WorldWorkResult afk_generateEntity(
     unsigned int threadId,
     const union AFK_WorldWorkParam& param,
     const struct AFK_WorldWorkThreadLocal& threadLocal,
@@ -67,7 +67,7 @@ bool afk_generateEntity(
  * It also makes sure that all intermediate vapour descriptors
  * have been made as it goes down.
  */
-bool afk_generateShapeCells(
+struct AFK_WorldWorkResult afk_generateShapeCells(
     unsigned int threadId,
     const union AFK_WorldWorkParam& param,
     const struct AFK_WorldWorkThreadLocal& threadLocal,
@@ -82,7 +82,7 @@ class AFK_Shape
 protected:
     /* Generates a claimed shape cell at its level of detail.
      * Returns true if successful, or false if you need to
-     * resume.
+     * resume.  Counts what it did in `result'.
      */
     bool generateClaimedShapeCell(
         unsigned int threadId,
@@ -90,7 +90,8 @@ protected:
         const AFK_KeyedCell& cell,
         AFK_VAPOUR_CELL_CACHE::Claim& vapourCellClaim,
         AFK_SHAPE_CELL_CACHE::Claim& shapeCellClaim,
-        const Mat4<float>& worldTransform);
+        const Mat4<float>& worldTransform,
+        struct AFK_WorldWorkResult& result);
 
     /* TODO: Try to move the shape-dependent stuff out of
      * `world' into here, so that I can stop sending along
@@ -110,13 +111,13 @@ public:
     void updateWorld(void);
     void printCacheStats(std::ostream& os, const std::string& prefix);
 
-    friend bool afk_generateEntity(
+    friend struct AFK_WorldWorkResult afk_generateEntity(
         unsigned int threadId,
         const union AFK_WorldWorkParam& param,
         const struct AFK_WorldWorkThreadLocal& threadLocal,
         AFK_WorldWorkQueue& queue);
 
-    friend bool afk_generateShapeCells(
+    friend struct AFK_WorldWorkResult afk_generateShapeCells(
         unsigned int threadId,
         const union AFK_WorldWorkParam& param,
         const struct AFK_WorldWorkThreadLocal& threadLocal,
@@ -54,9 +54,15 @@ std::ostream& operator<<(std::ostream& os, const AFK_TerrainTile& tile)
 
 /* AFK_TerrainList implementation. */
 
+AFK_TerrainList::AFK_TerrainList(AFK_FrameArena *arena):
+    f(AFK_FrameAllocator<AFK_TerrainFeature>(arena)),
+    t(AFK_FrameAllocator<AFK_TerrainTile>(arena))
+{
+}
+
 void AFK_TerrainList::extend(const AFK_TerrainList& list)
 {
-    extend<std::vector<AFK_TerrainFeature>, std::vector<AFK_TerrainTile> >(list.f, list.t);
+    extend<FeatureVector, TileVector>(list.f, list.t);
 }
 
 void AFK_TerrainList::extendInplaceTiles(
@@ -25,6 +25,7 @@
 #include <boost/type_traits/has_trivial_assign.hpp>
 #include <boost/type_traits/has_trivial_destructor.hpp>
 
+#include "data/frame_arena.hpp"
 #include "def.hpp"
 #include "landscape_sizes.hpp"
 #include "rng/rng.hpp"
@@ -159,14 +160,23 @@ std::ostream& operator<<(std::ostream& os, const AFK_TerrainTile& tile);
 BOOST_STATIC_ASSERT((boost::has_trivial_assign<AFK_TerrainTile>::value));
 BOOST_STATIC_ASSERT((boost::has_trivial_destructor<AFK_TerrainTile>::value));
 
-/* Encompasses the terrain as computed on a particular tile. */
+/* Encompasses the terrain as computed on a particular tile.
+ * The one the workers build for each tile is a frame temporary,
+ * and can come out of a frame arena; the compute queue's own
+ * is on the heap.
+ */
 class AFK_TerrainList
 {
 protected:
-    std::vector<AFK_TerrainFeature> f;
-    std::vector<AFK_TerrainTile> t;
+    typedef std::vector<AFK_TerrainFeature, AFK_FrameAllocator<AFK_TerrainFeature> > FeatureVector;
+    typedef std::vector<AFK_TerrainTile, AFK_FrameAllocator<AFK_TerrainTile> > TileVector;
+
+    FeatureVector f;
+    TileVector t;
 
 public:
+    AFK_TerrainList(AFK_FrameArena *arena = nullptr);
+
     /* Adds new TerrainTiles and TerrainFeatures to the list.
      * Make sure they're in order!  This function preserves the
      * mutual ordering.
@@ -17,6 +17,7 @@
 
 #include "afk.hpp"
 
+#include <cassert>
 #include <sstream>
 
 #include "cell.hpp"
@@ -164,3 +165,59 @@ std::ostream& operator<<(std::ostream& os, const AFK_Tile& tile)
         tile.coord.v[3] << ")";
 }
 
+
+/* AFK_PackedTile implementation */
+
+bool afk_isPackable(const AFK_Tile& tile)
+{
+    if (tile.coord.v[2] <= 0 || (tile.coord.v[2] & (tile.coord.v[2] - 1)) != 0) return false;
+
+    int64_t xOffset = tile.coord.v[0] - afk_packedCellOrigin.v[0];
+    int64_t zOffset = tile.coord.v[1] - afk_packedCellOrigin.v[2];
+    return (xOffset >= -AFK_PACKED_TILE_RANGE && xOffset < AFK_PACKED_TILE_RANGE &&
+        zOffset >= -AFK_PACKED_TILE_RANGE && zOffset < AFK_PACKED_TILE_RANGE);
+}
+
+AFK_PackedTile afk_packedTile(const AFK_Tile& tile)
+{
+    AFK_PackedTile packed;
+    if (tile == afk_unassignedTile)
+    {
+        packed.v = ~0ull;
+    }
+    else
+    {
+        assert(afk_isPackable(tile));
+        packed.v = afk_packScale(tile.coord.v[2]) |
+            afk_packSigned(tile.coord.v[0] - afk_packedCellOrigin.v[0],
+                AFK_PACKED_SCALE_BITS, AFK_PACKED_TILE_COORD_BITS) |
+            afk_packSigned(tile.coord.v[1] - afk_packedCellOrigin.v[2],
+                AFK_PACKED_SCALE_BITS + AFK_PACKED_TILE_COORD_BITS, AFK_PACKED_TILE_COORD_BITS);
+    }
+
+    return packed;
+}
+
+AFK_Tile afk_tile(const AFK_PackedTile& packed)
+{
+    if (packed == afk_unassignedPackedTile) return afk_unassignedTile;
+
+    return afk_tile(afk_vec3<int64_t>(
+        afk_packedCellOrigin.v[0] + afk_unpackSigned(packed.v,
+            AFK_PACKED_SCALE_BITS, AFK_PACKED_TILE_COORD_BITS),
+        afk_packedCellOrigin.v[2] + afk_unpackSigned(packed.v,
+            AFK_PACKED_SCALE_BITS + AFK_PACKED_TILE_COORD_BITS, AFK_PACKED_TILE_COORD_BITS),
+        1ll << (packed.v & AFK_PACKED_SCALE_MASK)));
+}
+
+const AFK_PackedTile afk_unassignedPackedTile = { ~0ull };
+
+size_t hash_value(const AFK_PackedTile& packed)
+{
+    return afk_hash_swizzle(0, packed.v);
+}
+
+std::ostream& operator<<(std::ostream& os, const AFK_PackedTile& packed)
+{
+    return os << "Packed" << afk_tile(packed);
+}
@@ -24,7 +24,10 @@
 
 #include "afk.hpp"
 
+#include <vector>
+
 #include "cell.hpp"
+#include "data/frame_arena.hpp"
 
 class AFK_Tile
 {
@@ -74,6 +77,52 @@ struct AFK_HashTile
 
 std::ostream& operator<<(std::ostream& os, const AFK_Tile& tile);
 
+/* A PackedTile is the 64-bit form of a Tile, for keying the
+ * landscape cache: 6 bits of log2(scale) at the bottom, then x and z
+ * as AFK_PACKED_TILE_COORD_BITS-bit signed offsets from the x and z
+ * of afk_packedCellOrigin.  Since there's no y to fit in, tiles get
+ * a lot more range than cells do; the same rebase rules apply (see
+ * cell.hpp).
+ */
+#define AFK_PACKED_TILE_COORD_BITS 28
+#define AFK_PACKED_TILE_RANGE (1ll << (AFK_PACKED_TILE_COORD_BITS - 1))
+
+class AFK_PackedTile
+{
+public:
+    uint64_t v;
+
+    bool operator==(const AFK_PackedTile& _tile) const { return v == _tile.v; }
+    bool operator==(const AFK_PackedTile& _tile) const volatile { return v == _tile.v; }
+    bool operator!=(const AFK_PackedTile& _tile) const { return v != _tile.v; }
+};
+
+bool afk_isPackable(const AFK_Tile& tile);
+
+AFK_PackedTile afk_packedTile(const AFK_Tile& tile);
+AFK_Tile afk_tile(const AFK_PackedTile& packed);
+
+extern const AFK_PackedTile afk_unassignedPackedTile;
+
+size_t hash_value(const AFK_PackedTile& packed);
+
+struct AFK_HashPackedTile
+{
+    size_t operator()(const AFK_PackedTile& packed) const { return hash_value(packed); }
+};
+
+std::ostream& operator<<(std::ostream& os, const AFK_PackedTile& packed);
+
+BOOST_STATIC_ASSERT((sizeof(AFK_PackedTile) == sizeof(uint64_t)));
+BOOST_STATIC_ASSERT((boost::has_trivial_assign<AFK_PackedTile>::value));
+BOOST_STATIC_ASSERT((boost::has_trivial_constructor<AFK_PackedTile>::value));
+BOOST_STATIC_ASSERT((boost::has_trivial_destructor<AFK_PackedTile>::value));
+
+/* A list of (packed) tiles that's only needed for the frame, out
+ * of a worker's frame arena.
+ */
+typedef std::vector<AFK_PackedTile, AFK_FrameAllocator<AFK_PackedTile> > AFK_FramePackedTileVector;
+
 /* Important for being able to pass cells around in the queue. */
 BOOST_STATIC_ASSERT((boost::has_trivial_assign<AFK_Tile>::value));
 BOOST_STATIC_ASSERT((boost::has_trivial_destructor<AFK_Tile>::value));
@@ -0,0 +1,112 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#include "afk.hpp"
+
+#include <cassert>
+#include <fstream>
+#include <new>
+
+#include "file/logstream.hpp"
+#include "trace.hpp"
+
+/* AFK_Tracer implementation */
+
+void AFK_Tracer::record(unsigned int threadId, const char *name, char phase) afk_noexcept
+{
+    if (threadId >= AFK_TRACE_THREADS) return;
+    Ring& ring = rings[threadId];
+
+    Event *events = ring.events.load(boost::memory_order_acquire);
+    if (!events)
+    {
+        /* Only this thread ever allocates its own ring.  (Quietly:
+         * I can get called from within noexcept functions.)
+         */
+        events = new (std::nothrow) Event[AFK_TRACE_EVENTS_PER_THREAD];
+        if (!events) return;
+        ring.events.store(events, boost::memory_order_release);
+    }
+
+    uint_fast64_t n = ring.next.load(boost::memory_order_relaxed);
+    Event& e = events[n % AFK_TRACE_EVENTS_PER_THREAD];
+    e.name = name;
+    e.nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(afk_clock::now() - epoch).count();
+    e.phase = phase;
+    ring.next.store(n + 1, boost::memory_order_release);
+}
+
+AFK_Tracer::AFK_Tracer():
+    enabled(false),
+    epoch(afk_clock::now())
+{
+    for (auto& ring : rings)
+    {
+        ring.events.store(nullptr);
+        ring.next.store(0);
+    }
+}
+
+AFK_Tracer::~AFK_Tracer()
+{
+    for (auto& ring : rings)
+    {
+        Event *events = ring.events.load();
+        if (events) delete[] events;
+    }
+}
+
+void AFK_Tracer::enable(void)
+{
+    enabled.store(true);
+}
+
+bool AFK_Tracer::write(const std::string& filename)
+{
+    std::ofstream os(filename.c_str());
+    if (!os)
+    {
+        afk_out << "AFK_Tracer: Failed to open " << filename << std::endl;
+        return false;
+    }
+
+    os << "{\"traceEvents\":[" << std::endl;
+    bool first = true;
+    for (unsigned int threadId = 0; threadId < AFK_TRACE_THREADS; ++threadId)
+    {
+        Event *events = rings[threadId].events.load(boost::memory_order_acquire);
+        if (!events) continue;
+
+        uint_fast64_t next = rings[threadId].next.load(boost::memory_order_acquire);
+        uint_fast64_t start = (next > AFK_TRACE_EVENTS_PER_THREAD ? next - AFK_TRACE_EVENTS_PER_THREAD : 0);
+        for (uint_fast64_t n = start; n < next; ++n)
+        {
+            const Event& e = events[n % AFK_TRACE_EVENTS_PER_THREAD];
+            if (!first) os << "," << std::endl;
+            os << "{\"name\":\"" << e.name << "\",\"ph\":\"" << e.phase <<
+                "\",\"ts\":" << (e.nanos / 1000) << "." << (e.nanos % 1000) / 100 <<
+                ",\"pid\":1,\"tid\":" << threadId << "}";
+            first = false;
+        }
+    }
+
+    os << std::endl << "]}" << std::endl;
+    afk_out << "AFK_Tracer: Wrote trace to " << filename << std::endl;
+    return os.good();
+}
+
+AFK_Tracer afk_tracer;
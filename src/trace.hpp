@@ -0,0 +1,144 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#ifndef _AFK_TRACE_H_
+#define _AFK_TRACE_H_
+
+#include <cstdint>
+#include <string>
+
+#include <boost/atomic.hpp>
+
+#include "clock.hpp"
+#include "async/thread_allocation.hpp"
+#include "data/data.hpp"
+
+/* A timeline tracer.  Each thread ID records begin and end events
+ * into a ring buffer of its own (so the recording threads never
+ * contend), and write() turns whatever is in the rings into Chrome
+ * trace JSON, which you can load into Perfetto or chrome://tracing
+ * to look for stalls and idle gaps.
+ * It does nothing until it's enabled (with the traceFile option),
+ * and it can be compiled out entirely with AFK_TRACING.
+ * Event names must be string literals: only the pointer is kept.
+ */
+#define AFK_TRACING 1
+
+/* Enough for every thread ID that AFK_ThreadAllocation hands out. */
+#define AFK_TRACE_THREADS AFK_MAX_THREADS
+
+/* The size of each thread's ring.  Once it's full, the oldest
+ * events get overwritten, so the trace covers the last few
+ * seconds or so.
+ */
+#define AFK_TRACE_EVENTS_PER_THREAD (1 << 15)
+
+class AFK_Tracer
+{
+protected:
+    struct Event
+    {
+        const char *name;
+        int64_t nanos; /* since the tracer was made */
+        char phase; /* 'B' or 'E' */
+    };
+
+    /* Rings are only allocated for threads that record something.
+     * Each one is only written by its own thread.
+     */
+    struct Ring
+    {
+        boost::atomic<Event *> events;
+        boost::atomic_uint_fast64_t next;
+
+        char pad[48];
+    };
+
+    Ring rings[AFK_TRACE_THREADS];
+    boost::atomic<bool> enabled;
+    const afk_clock::time_point epoch;
+
+    void record(unsigned int threadId, const char *name, char phase) afk_noexcept;
+
+public:
+    AFK_Tracer();
+    virtual ~AFK_Tracer();
+
+    void enable(void);
+
+    bool isEnabled(void) const
+    {
+        return enabled.load(boost::memory_order_relaxed);
+    }
+
+    void begin(unsigned int threadId, const char *name) afk_noexcept
+    {
+        if (isEnabled()) record(threadId, name, 'B');
+    }
+
+    void end(unsigned int threadId, const char *name) afk_noexcept
+    {
+        if (isEnabled()) record(threadId, name, 'E');
+    }
+
+    /* Writes the contents of the rings to this file.  That can
+     * happen while the other threads are still tracing; it's a
+     * snapshot, and the odd event at the old end of a ring that's
+     * being overwritten might come out wrong.
+     * Returns false if it couldn't write the file.
+     */
+    bool write(const std::string& filename);
+};
+
+extern AFK_Tracer afk_tracer;
+
+/* Traces the lifetime of a scope. */
+class AFK_TraceScope
+{
+protected:
+    const unsigned int threadId;
+    const char *name;
+
+public:
+    AFK_TraceScope(unsigned int _threadId, const char *_name):
+        threadId(_threadId), name(_name)
+    {
+        afk_tracer.begin(threadId, name);
+    }
+
+    AFK_TraceScope(const AFK_TraceScope& _scope) = delete;
+    AFK_TraceScope& operator=(const AFK_TraceScope& _scope) = delete;
+
+    virtual ~AFK_TraceScope()
+    {
+        afk_tracer.end(threadId, name);
+    }
+};
+
+#if AFK_TRACING
+#define AFK_TRACE_CONCAT_INNER(a, b) a##b
+#define AFK_TRACE_CONCAT(a, b) AFK_TRACE_CONCAT_INNER(a, b)
+#define AFK_TRACE_SCOPE(threadId, name) AFK_TraceScope AFK_TRACE_CONCAT(afk_traceScope, __LINE__)(threadId, name);
+#define AFK_TRACE_BEGIN(threadId, name) afk_tracer.begin(threadId, name);
+#define AFK_TRACE_END(threadId, name) afk_tracer.end(threadId, name);
+#else
+#define AFK_TRACE_SCOPE(threadId, name)
+#define AFK_TRACE_BEGIN(threadId, name)
+#define AFK_TRACE_END(threadId, name)
+#endif /* AFK_TRACING */
+
+#endif /* _AFK_TRACE_H_ */
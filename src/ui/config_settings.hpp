@@ -59,7 +59,22 @@ public:
     AFK_CONFIG_FIELD_NOSAVE(int64_t, masterSeedLow,             "Low part of master seed (64 bits)",        -1ll);
     AFK_CONFIG_FIELD_NOSAVE(int64_t, masterSeedHigh,            "High part of master seed (64 bits)",       -1ll);
     AFK_CONFIG_FIELD_NOSAVE(unsigned int, concurrency,          "Number of worker threads",                 std::thread::hardware_concurrency() + 1);
+    AFK_CONFIG_FIELD_NOSAVE(bool,   pinThreads,                 "Pin the master and worker threads to their own cores (GL/CL driver threads are left where they are)", false);
+    AFK_CONFIG_FIELD_NOSAVE(int,    workerNumaNode,             "Keep the worker threads on this NUMA node (-1 for any)",   -1);
+    AFK_CONFIG_FIELD_NOSAVE(bool,   workStealing,               "Give each worker thread its own work queue",   false);
+    AFK_CONFIG_FIELD_NOSAVE(bool,   pipelineFrames,             "Compute a frame ahead of the one being drawn (more throughput, more latency)", false);
+    AFK_CONFIG_FIELD_NOSAVE(bool,   priorityEnumeration,        "Enumerate the biggest looking cells first",    true);
+    AFK_CONFIG_FIELD_NOSAVE(bool,   computeDeadline,            "Stop subdividing cells when the frame runs out of time",   true);
+    AFK_CONFIG_FIELD_NOSAVE(bool,   horizonCulling,             "Skip cells hidden behind the landscape",   true);
+    AFK_CONFIG_FIELD_NOSAVE(float,  sphereDetailPitchTolerance, "Judge cells' detail pitch by their midpoint this far from the target (fraction; 0 for just the bounding sphere's certain answers, negative to always use the vertices)", 0.0f);
+    AFK_CONFIG_FIELD_NOSAVE(bool,   emptySubtreeSkipping,       "Don't subdivide cells with nothing under them (well clear of the landscape, and no entities)", true);
+    AFK_CONFIG_FIELD_NOSAVE(float,  emptySubtreeYMargin,        "How far clear of the landscape's y-bounds an empty cell must be (in cell sizes)", 1.0f);
+    AFK_CONFIG_FIELD_NOSAVE(unsigned int, emptySubtreeEntityDepth, "Look this many levels down for entities under cells above the landscape", 2);
+    AFK_CONFIG_FIELD_NOSAVE(bool,   landscapeQuadtree,          "Enumerate the landscape tiles by themselves, leaving the world cells just the entities", false);
+    AFK_CONFIG_FIELD_NOSAVE(bool,   incrementalEnumeration,     "Start each frame's enumeration from the last one's leaves",    true);
+    AFK_CONFIG_FIELD_NOSAVE(unsigned int, localEnumerationScale, "Enumerate cells up to this scale on the worker that found them (0 to queue them all)", 8);
     AFK_CONFIG_FIELD_NOSAVE(std::string, logFile,               "Log file",                                 "");
+    AFK_CONFIG_FIELD_NOSAVE(std::string, traceFile,             "Chrome trace file (empty for no tracing)", "");
 
     // Graphics settings
 
@@ -48,6 +48,7 @@ std::list<struct AFK_DefaultControl>& afk_getDefaultControls(void)
         { AFK_Control::MOUSE_CAPTURE, "mouseCapture", AFK_InputType::KEYBOARD, "mM" },
         { AFK_Control::MOUSE_CAPTURE, "mouseCapture", AFK_InputType::MOUSE, "2" },
         { AFK_Control::FULLSCREEN, "fullscreen", AFK_InputType::KEYBOARD, "0)" }, /* TODO separate control type for control keys f11 etc? */
+        { AFK_Control::WRITE_TRACE, "writeTrace", AFK_InputType::KEYBOARD, "tT" },
     };
 
     return defaultControls;
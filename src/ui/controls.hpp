@@ -60,6 +60,7 @@ enum class AFK_Control : int
     PRIMARY_FIRE = 0xe,
     SECONDARY_FIRE = 0xf,
     FULLSCREEN = 0x10,
+    WRITE_TRACE = 0x11,
     AXIS_PITCH = 0x100,
     AXIS_YAW = 0x101,
     AXIS_ROLL = 0x102
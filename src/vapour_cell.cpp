@@ -17,7 +17,9 @@
 
 #include "afk.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <vector>
 
 #include "core.hpp"
 #include "debug.hpp"
@@ -167,24 +169,38 @@ bool AFK_VapourCell::build3DList(
     const AFK_KeyedCell& cell,
     AFK_3DList& list,
     const AFK_ShapeSizes& sSizes,
-    AFK_VAPOUR_CELL_CACHE *cache) const
-{
-    /* Add the local vapour to the list. */
+    AFK_VAPOUR_CELL_CACHE *cache,
+    AFK_FrameArena *arena) const
+{
+    /* Work out the chain of parent cells up to the top level
+     * cell, and claim them all together, coarsest first.
+     */
+    std::vector<AFK_PackedKeyedCell, AFK_FrameAllocator<AFK_PackedKeyedCell> > ancestors(
+        (AFK_FrameAllocator<AFK_PackedKeyedCell>(arena)));
+    for (AFK_KeyedCell thisCell = cell;
+        thisCell.c.coord.v[3] < (sSizes.skeletonFlagGridDim * SHAPE_CELL_MAX_DISTANCE); )
+    {
+        thisCell = thisCell.parent(sSizes.subdivisionFactor);
+        ancestors.push_back(afk_packedKeyedCell(thisCell));
+    }
+
+    std::reverse(ancestors.begin(), ancestors.end());
+
+    auto ancestorClaims = cache->getAndClaimChain(threadId, ancestors, AFK_CL_SHARED);
+    if (!ancestorClaims.isValid()) return false;
+
+    /* Add the local vapour to the list, followed by the
+     * parents' from finest to coarsest.
+     */
     list.extend<FeatureArray, CubeArray>(features, cubes);
 
-    /* If this isn't the top level cell... */
-    if (cell.c.coord.v[3] < (sSizes.skeletonFlagGridDim * SHAPE_CELL_MAX_DISTANCE))
+    for (size_t i = ancestorClaims.size(); i > 0; --i)
     {
-        /* Pull the parent cell from the cache, and
-         * include its list too
-         */
-        AFK_KeyedCell parentCell = cell.parent(sSizes.subdivisionFactor);
-        auto parentVapourCellClaim = cache->getAndClaim(threadId, parentCell, AFK_CL_SHARED);
-        if (parentVapourCellClaim.isValid())
-            return parentVapourCellClaim.getShared().build3DList(threadId, parentCell, list, sSizes, cache);
-        else return false;
+        const AFK_VapourCell& ancestor = ancestorClaims.at(i - 1).getShared();
+        list.extend<FeatureArray, CubeArray>(ancestor.features, ancestor.cubes);
     }
-    else return true;
+
+    return true;
 }
 
 bool AFK_VapourCell::alreadyEnqueued(
@@ -27,6 +27,7 @@
 #include "data/claimable.hpp"
 #include "data/evictable_cache.hpp"
 #include "data/frame.hpp"
+#include "data/frame_arena.hpp"
 #include "keyed_cell.hpp"
 #include "shape_sizes.hpp"
 #include "skeleton.hpp"
@@ -125,7 +126,9 @@ public:
      * whose vapour descriptor needs to be created first in
      * order to be able to make this list.  They go from
      * smallest to largest cell.
+     * The parent cells are claimed all together, coarsest first.
      * Returns false if it fails (e.g. can't get claims), need to try again
+     * The list of parent cells comes out of `arena'.
      * TODO: Like building the landscape list, fill out a missing vector?
      */
     bool build3DList(
@@ -133,7 +136,8 @@ public:
         const AFK_KeyedCell& cell,
         AFK_3DList& list,
         const AFK_ShapeSizes& sSizes,
-        AFK_VAPOUR_CELL_CACHE *cache) const;
+        AFK_VAPOUR_CELL_CACHE *cache,
+        AFK_FrameArena *arena) const;
 
     /* Checks whether this vapour cell's features have
      * already gone into the compute queue this frame.
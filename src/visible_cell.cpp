@@ -17,6 +17,9 @@
 
 #include "afk.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 #include "visible_cell.hpp"
 
 
@@ -28,6 +31,18 @@ void AFK_VisibleCell::calculateMidpoint(void)
         (vertices[1][0][0] - vertices[0][0][0]) / 2.0f +
         (vertices[0][1][0] - vertices[0][0][0]) / 2.0f +
         (vertices[0][0][1] - vertices[0][0][0]) / 2.0f;
+
+    scale = (vertices[1][0][0] - vertices[0][0][0]).magnitude();
+
+    /* A transformed cell needn't be a cube any more, so I check
+     * all the vertices.
+     */
+    radius = 0.0f;
+    for (int i = 0; i < 8; ++i)
+    {
+        radius = std::max<float>(radius,
+            (vertices[(i >> 2) & 1][(i >> 1) & 1][i & 1] - midpoint).magnitude());
+    }
 }
 
 void AFK_VisibleCell::bindToCell(const AFK_Cell& cell, float worldScale)
@@ -90,69 +105,190 @@ Vec4<float> AFK_VisibleCell::getRealCoord(void) const
         vertices[0][0][0].v[0],
         vertices[0][0][0].v[1],
         vertices[0][0][0].v[2],
-        (vertices[1][0][0] - vertices[0][0][0]).magnitude());
+        scale);
 }
 
 bool AFK_VisibleCell::testDetailPitch(
     float detailPitch,
     const AFK_Camera& camera,
-    const Vec3<float>& viewerLocation) const
+    const Vec3<float>& viewerLocation,
+    float sphereTolerance) const
 {
+    if (sphereTolerance >= 0.0f)
+    {
+        float midPitch, minPitch, maxPitch;
+        camera.getDetailPitchBoundsAsSeen(scale, midpoint, radius, viewerLocation,
+            midPitch, minPitch, maxPitch);
+
+        /* The vertices' average can't be outside the bounds.  (The
+         * slack is for the rounding in working them out differently.)
+         */
+        if (maxPitch * 1.0001f < detailPitch) return true;
+        if (minPitch * 0.9999f >= detailPitch) return false;
+
+        if (sphereTolerance > 0.0f && fabs(midPitch - detailPitch) > sphereTolerance * detailPitch)
+            return (midPitch < detailPitch);
+    }
+
     /* The cell detail pitch shall be the average of the
      * detail pitches as seen of the 8 vertices.
      */
-    float scale = (vertices[1][0][0] - vertices[0][0][0]).magnitude();
-    float accDP = 0.0f;
+    float xs[8], ys[8], zs[8], pitches[8];
 
-    for (int x = 0; x <= 1; ++x)
+    for (int i = 0; i < 8; ++i)
     {
-        for (int y = 0; y <= 1; ++y)
-        {
-            for (int z = 0; z <= 1; ++z)
-            {
-                accDP += camera.getDetailPitchAsSeen(scale, vertices[x][y][z], viewerLocation);
-            }
-        }
+        const Vec3<float>& v = vertices[(i >> 2) & 1][(i >> 1) & 1][i & 1];
+        xs[i] = v.v[0];
+        ys[i] = v.v[1];
+        zs[i] = v.v[2];
     }
 
+    camera.getDetailPitchesAsSeen(scale, xs, ys, zs, 8, viewerLocation, pitches);
+
+    /* Summing them up in the same order as ever, so that the
+     * answer doesn't change.
+     */
+    float accDP = 0.0f;
+    for (int i = 0; i < 8; ++i) accDP += pitches[i];
+
     return (accDP / 8.0f) < detailPitch;
 }
 
-static void testPointVisible(
-    const Vec3<float>& point,
+void AFK_VisibleCell::testVisibility(
     const AFK_Camera& camera,
     bool& io_someVisible,
-    bool& io_allVisible)
+    bool& io_allVisible) const
 {
-    /* Project the point.  This perspective projection
-     * yields a viewport with the x co-ordinates
-     * (-ar, ar) and the y co-ordinates (-1.0, 1.0).
-     */
-    Vec4<float> projectedPoint = camera.getProjection() * afk_vec4<float>(
-        point.v[0], point.v[1], point.v[2], 1.0f);
-    bool visible = camera.projectedPointIsVisible(projectedPoint);
+    /* The 8 vertices, then the midpoint. */
+    float xs[9], ys[9], zs[9];
+    bool visible[9];
+
+    for (int i = 0; i < 8; ++i)
+    {
+        const Vec3<float>& v = vertices[(i >> 2) & 1][(i >> 1) & 1][i & 1];
+        xs[i] = v.v[0];
+        ys[i] = v.v[1];
+        zs[i] = v.v[2];
+    }
 
-    io_someVisible |= visible;
-    io_allVisible &= visible;
+    xs[8] = midpoint.v[0];
+    ys[8] = midpoint.v[1];
+    zs[8] = midpoint.v[2];
+
+    camera.testPointsVisible(xs, ys, zs, 9, visible);
+
+    for (int i = 0; i < 9; ++i)
+    {
+        io_someVisible |= visible[i];
+        io_allVisible &= visible[i];
+    }
 }
 
-void AFK_VisibleCell::testVisibility(
+bool afk_testSubcellVisibility(
+    const AFK_Cell& cell,
+    unsigned int subdivisionFactor,
+    float worldScale,
     const AFK_Camera& camera,
-    bool& io_someVisible,
-    bool& io_allVisible) const
+    bool *o_someVisible,
+    bool *o_allVisible)
 {
-    for (int x = 0; x <= 1; ++x)
+    if (subdivisionFactor > AFK_MAX_BATCH_SUBDIVISION_FACTOR) return false;
+
+    /* The lattice of subcell vertices goes first, followed by
+     * each subcell's midpoint.
+     */
+    const int64_t sf = (int64_t)subdivisionFactor;
+    const int64_t points = sf + 1;
+    const int64_t stride = cell.coord.v[3] / sf;
+    const int64_t latticeCount = CUBE(points);
+    const int maxCount = CUBE(AFK_MAX_BATCH_SUBDIVISION_FACTOR + 1) + CUBE(AFK_MAX_BATCH_SUBDIVISION_FACTOR);
+
+    float xs[maxCount], ys[maxCount], zs[maxCount];
+    bool visible[maxCount];
+
+    for (int64_t x = 0; x < points; ++x)
     {
-        for (int y = 0; y <= 1; ++y)
+        for (int64_t y = 0; y < points; ++y)
         {
-            for (int z = 0; z <= 1; ++z)
+            for (int64_t z = 0; z < points; ++z)
             {
-                testPointVisible(vertices[x][y][z], camera, io_someVisible, io_allVisible);
+                /* This is the same vertex that bindToCell() would
+                 * make.
+                 */
+                Vec4<float> realCoord = afk_cell(afk_vec4<int64_t>(
+                    cell.coord.v[0] + x * stride,
+                    cell.coord.v[1] + y * stride,
+                    cell.coord.v[2] + z * stride,
+                    stride)).toWorldSpace(worldScale);
+
+                int64_t l = (x * points + y) * points + z;
+                xs[l] = realCoord.v[0];
+                ys[l] = realCoord.v[1];
+                zs[l] = realCoord.v[2];
             }
         }
     }
 
-    testPointVisible(midpoint, camera, io_someVisible, io_allVisible);
+#define AFK_LATTICE_INDEX(x, y, z) (((x) * points + (y)) * points + (z))
+#define AFK_LATTICE_POINT(x, y, z) afk_vec3<float>( \
+    xs[AFK_LATTICE_INDEX(x, y, z)], \
+    ys[AFK_LATTICE_INDEX(x, y, z)], \
+    zs[AFK_LATTICE_INDEX(x, y, z)])
+
+    int64_t s = 0;
+    for (int64_t i = 0; i < sf; ++i)
+    {
+        for (int64_t j = 0; j < sf; ++j)
+        {
+            for (int64_t k = 0; k < sf; ++k)
+            {
+                /* ...and this is the same midpoint as
+                 * calculateMidpoint().
+                 */
+                Vec3<float> v000 = AFK_LATTICE_POINT(i, j, k);
+                Vec3<float> midpoint = v000 +
+                    (AFK_LATTICE_POINT(i + 1, j, k) - v000) / 2.0f +
+                    (AFK_LATTICE_POINT(i, j + 1, k) - v000) / 2.0f +
+                    (AFK_LATTICE_POINT(i, j, k + 1) - v000) / 2.0f;
+
+                xs[latticeCount + s] = midpoint.v[0];
+                ys[latticeCount + s] = midpoint.v[1];
+                zs[latticeCount + s] = midpoint.v[2];
+                ++s;
+            }
+        }
+    }
+
+    camera.testPointsVisible(xs, ys, zs, (unsigned int)(latticeCount + s), visible);
+
+    s = 0;
+    for (int64_t i = 0; i < sf; ++i)
+    {
+        for (int64_t j = 0; j < sf; ++j)
+        {
+            for (int64_t k = 0; k < sf; ++k)
+            {
+                bool someVisible = visible[latticeCount + s];
+                bool allVisible = someVisible;
+
+                for (int c = 0; c < 8; ++c)
+                {
+                    bool v = visible[AFK_LATTICE_INDEX(i + ((c >> 2) & 1), j + ((c >> 1) & 1), k + (c & 1))];
+                    someVisible |= v;
+                    allVisible &= v;
+                }
+
+                o_someVisible[s] = someVisible;
+                o_allVisible[s] = allVisible;
+                ++s;
+            }
+        }
+    }
+
+#undef AFK_LATTICE_POINT
+#undef AFK_LATTICE_INDEX
+
+    return true;
 }
 
 std::ostream& operator<<(std::ostream& os, const AFK_VisibleCell& visibleCell)
@@ -37,8 +37,12 @@ protected:
     /* This array contains all 8 vertices of the cell. */
     Vec3<float> vertices[2][2][2];
 
-    /* This is the midpoint. */
+    /* This is the midpoint, and the length of an edge and the
+     * radius of the bounding sphere about the midpoint.
+     */
     Vec3<float> midpoint;
+    float scale;
+    float radius;
 
     void calculateMidpoint(void);
 
@@ -52,11 +56,22 @@ public:
 
     /* Tests whether this cell is within the specified detail pitch
      * when viewed from the specified location.
+     * The cell's detail pitch is the average of its vertices'.  With
+     * a non-negative `sphereTolerance', though, I look at the
+     * bounding sphere first, with one distance rather than eight:
+     * if the whole sphere is on one side of the line the answer is
+     * certain.  Otherwise, with a positive tolerance, if the
+     * midpoint's detail pitch is more than that fraction of
+     * `detailPitch' away from it, I go with the midpoint.  Only
+     * what's left needs the vertices.  (So a tolerance of 0 uses
+     * just the sphere bounds, and always gets the same answer as
+     * the vertices.)
      */
     bool testDetailPitch(
         float detailPitch,
         const AFK_Camera& camera,
-        const Vec3<float>& viewerLocation) const;
+        const Vec3<float>& viewerLocation,
+        float sphereTolerance = -1.0f) const;
 
     /* Tests whether none, some or all of this cell's vertices are
      * visible when projected with the supplied camera.
@@ -71,5 +86,24 @@ public:
 
 std::ostream& operator<<(std::ostream& os, const AFK_VisibleCell& visibleCell);
 
+/* Tests the visibility of all the subcells of `cell' at once, as
+ * if they'd each been bound (untransformed) and tested with
+ * testVisibility() (the answers are the same).  The subcells share
+ * their vertices, so this projects each lattice point only once.
+ * The outputs are in the order that AFK_Cell::subdivide() makes the
+ * subcells in, and must have room for CUBE(subdivisionFactor).
+ * Returns false without testing anything if the subdivision factor
+ * is more than the below.
+ */
+#define AFK_MAX_BATCH_SUBDIVISION_FACTOR 4
+
+bool afk_testSubcellVisibility(
+    const AFK_Cell& cell,
+    unsigned int subdivisionFactor,
+    float worldScale,
+    const AFK_Camera& camera,
+    bool *o_someVisible,
+    bool *o_allVisible);
+
 #endif /* _AFK_VISIBLE_CELL_H_ */
 
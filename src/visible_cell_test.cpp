@@ -0,0 +1,324 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#include "afk.hpp"
+
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+#include "camera.hpp"
+#include "cell.hpp"
+#include "clock.hpp"
+#include "file/logstream.hpp"
+#include "rng/boost_taus88.hpp"
+#include "visible_cell.hpp"
+#include "visible_cell_test.hpp"
+
+/* This is how visibility testing used to be done: one point at a
+ * time, with the scalar projection.
+ */
+static void testPointVisibleScalar(
+    const Vec3<float>& point,
+    const AFK_Camera& camera,
+    bool& io_someVisible,
+    bool& io_allVisible)
+{
+    Vec4<float> projectedPoint = camera.getProjection() * afk_vec4<float>(
+        point.v[0], point.v[1], point.v[2], 1.0f);
+    bool visible = camera.projectedPointIsVisible(projectedPoint);
+
+    io_someVisible |= visible;
+    io_allVisible &= visible;
+}
+
+/* The 8 vertices and the midpoint, as AFK_VisibleCell makes them. */
+static void makeCellPoints(
+    const AFK_Cell& cell,
+    float worldScale,
+    Vec3<float> *o_points)
+{
+    for (int64_t x = 0; x <= 1; ++x)
+    {
+        for (int64_t y = 0; y <= 1; ++y)
+        {
+            for (int64_t z = 0; z <= 1; ++z)
+            {
+                Vec4<float> realCoord = afk_cell(afk_vec4<int64_t>(
+                    cell.coord.v[0] + x * cell.coord.v[3],
+                    cell.coord.v[1] + y * cell.coord.v[3],
+                    cell.coord.v[2] + z * cell.coord.v[3],
+                    cell.coord.v[3])).toWorldSpace(worldScale);
+                o_points[x * 4 + y * 2 + z] = afk_vec3<float>(realCoord.v[0], realCoord.v[1], realCoord.v[2]);
+            }
+        }
+    }
+
+    o_points[8] = o_points[0] +
+        (o_points[4] - o_points[0]) / 2.0f +
+        (o_points[2] - o_points[0]) / 2.0f +
+        (o_points[1] - o_points[0]) / 2.0f;
+}
+
+static void testVisibilityScalar(
+    const Vec3<float> *points,
+    const AFK_Camera& camera,
+    bool& io_someVisible,
+    bool& io_allVisible)
+{
+    for (int i = 0; i < 9; ++i)
+        testPointVisibleScalar(points[i], camera, io_someVisible, io_allVisible);
+}
+
+void test_visibleCell(void)
+{
+    afk_out << "Visible cell test" << std::endl;
+    afk_out << "-----------------" << std::endl;
+
+    const unsigned int cellCount = 1 << 16;
+    const unsigned int subdivisionFactor = 2;
+    const unsigned int subcellCount = CUBE(subdivisionFactor);
+    const float worldScale = 0.25f;
+    const int timingPasses = 16;
+
+    AFK_Camera camera;
+    camera.setSeparation(afk_vec3<float>(0.0f, 0.0f, 0.0f));
+    camera.setWindowDimensions(1280, 720);
+    camera.driveAndUpdateProjection(afk_vec3<float>(0.0f, 0.0f, 0.0f), afk_vec3<float>(0.1f, 0.3f, 0.0f));
+
+    /* A spread of cells of different sizes all round the camera,
+     * so that there's a good mix of invisible, partly visible and
+     * entirely visible ones.
+     */
+    AFK_Boost_Taus88_RNG rng;
+    rng.seed(AFK_RNG_Value(41));
+
+    std::vector<AFK_Cell> cells;
+    for (unsigned int i = 0; i < cellCount; ++i)
+    {
+        int64_t scale = 2ll << (rng.uirand() % 6);
+        cells.push_back(afk_cell(afk_vec4<int64_t>(
+            ((int64_t)(rng.uirand() % 128) - 64) * scale,
+            ((int64_t)(rng.uirand() % 128) - 64) * scale,
+            ((int64_t)(rng.uirand() % 128) - 64) * scale,
+            scale)));
+    }
+
+    /* The answers first. */
+    unsigned int cellMismatches = 0, subcellMismatches = 0;
+    unsigned int someVisibleCount = 0, allVisibleCount = 0;
+    for (auto cell : cells)
+    {
+        Vec3<float> points[9];
+        makeCellPoints(cell, worldScale, points);
+        bool refSome = false, refAll = true;
+        testVisibilityScalar(points, camera, refSome, refAll);
+        if (refSome) ++someVisibleCount;
+        if (refAll) ++allVisibleCount;
+
+        AFK_VisibleCell visibleCell;
+        visibleCell.bindToCell(cell, worldScale);
+        bool some = false, all = true;
+        visibleCell.testVisibility(camera, some, all);
+        if (some != refSome || all != refAll) ++cellMismatches;
+
+        AFK_Cell subcells[subcellCount];
+        bool subSome[subcellCount], subAll[subcellCount];
+        cell.subdivide(subcells, subcellCount, subdivisionFactor);
+        afk_testSubcellVisibility(cell, subdivisionFactor, worldScale, camera, subSome, subAll);
+        for (unsigned int s = 0; s < subcellCount; ++s)
+        {
+            Vec3<float> subPoints[9];
+            makeCellPoints(subcells[s], worldScale, subPoints);
+            bool subRefSome = false, subRefAll = true;
+            testVisibilityScalar(subPoints, camera, subRefSome, subRefAll);
+            if (subSome[s] != subRefSome || subAll[s] != subRefAll) ++subcellMismatches;
+        }
+    }
+
+    afk_out << "SSE enabled:                  " << AFK_CAMERA_SSE << std::endl;
+    afk_out << "Cells some visible:           " << someVisibleCount << " of " << cellCount << std::endl;
+    afk_out << "Cells all visible:            " << allVisibleCount << " of " << cellCount << std::endl;
+    afk_out << "Cell mismatches:              " << cellMismatches << std::endl;
+    afk_out << "Subcell mismatches:           " << subcellMismatches << std::endl;
+
+    /* Now the timings.  For single cells, I make the vertices in
+     * advance so as to time only the tests themselves.  For
+     * subcells, I time making the vertices too, because that's what
+     * the world has to do.
+     */
+    std::vector<Vec3<float> > cellPoints(cellCount * 9);
+    std::vector<AFK_VisibleCell> visibleCells(cellCount);
+    for (unsigned int i = 0; i < cellCount; ++i)
+    {
+        makeCellPoints(cells[i], worldScale, &cellPoints[i * 9]);
+        visibleCells[i].bindToCell(cells[i], worldScale);
+    }
+
+    unsigned int tally = 0;
+    afk_clock::time_point startTime = afk_clock::now();
+    for (int pass = 0; pass < timingPasses; ++pass)
+    {
+        for (unsigned int i = 0; i < cellCount; ++i)
+        {
+            bool some = false, all = true;
+            testVisibilityScalar(&cellPoints[i * 9], camera, some, all);
+            if (some) ++tally;
+        }
+    }
+
+    afk_duration_mfl scalarTime = std::chrono::duration_cast<afk_duration_mfl>(afk_clock::now() - startTime);
+
+    startTime = afk_clock::now();
+    for (int pass = 0; pass < timingPasses; ++pass)
+    {
+        for (auto& visibleCell : visibleCells)
+        {
+            bool some = false, all = true;
+            visibleCell.testVisibility(camera, some, all);
+            if (some) ++tally;
+        }
+    }
+
+    afk_duration_mfl cellTime = std::chrono::duration_cast<afk_duration_mfl>(afk_clock::now() - startTime);
+
+    startTime = afk_clock::now();
+    for (int pass = 0; pass < timingPasses; ++pass)
+    {
+        for (auto cell : cells)
+        {
+            AFK_Cell subcells[subcellCount];
+            cell.subdivide(subcells, subcellCount, subdivisionFactor);
+            for (unsigned int s = 0; s < subcellCount; ++s)
+            {
+                Vec3<float> subPoints[9];
+                makeCellPoints(subcells[s], worldScale, subPoints);
+                bool some = false, all = true;
+                testVisibilityScalar(subPoints, camera, some, all);
+                if (some) ++tally;
+            }
+        }
+    }
+
+    afk_duration_mfl scalarSubcellTime = std::chrono::duration_cast<afk_duration_mfl>(afk_clock::now() - startTime);
+
+    startTime = afk_clock::now();
+    for (int pass = 0; pass < timingPasses; ++pass)
+    {
+        for (auto cell : cells)
+        {
+            bool subSome[subcellCount], subAll[subcellCount];
+            afk_testSubcellVisibility(cell, subdivisionFactor, worldScale, camera, subSome, subAll);
+            if (subSome[0]) ++tally;
+        }
+    }
+
+    afk_duration_mfl subcellTime = std::chrono::duration_cast<afk_duration_mfl>(afk_clock::now() - startTime);
+
+    float cellsTested = (float)cellCount * (float)timingPasses;
+    afk_out << "(tally " << tally << ")" << std::endl;
+    afk_out << "Scalar cells per second:      " << 1000.0f * cellsTested / scalarTime.count() << std::endl;
+    afk_out << "Batch cells per second:       " << 1000.0f * cellsTested / cellTime.count() << std::endl;
+    afk_out << "Scalar subcells per second:   " << 1000.0f * cellsTested * (float)subcellCount / scalarSubcellTime.count() << std::endl;
+    afk_out << "Batch subcells per second:    " << 1000.0f * cellsTested * (float)subcellCount / subcellTime.count() << std::endl;
+    afk_out << std::endl;
+}
+
+void test_detailPitch(void)
+{
+    afk_out << "Detail pitch test" << std::endl;
+    afk_out << "-----------------" << std::endl;
+
+    const unsigned int cellCount = 1 << 16;
+    const float worldScale = 0.25f;
+    const float detailPitch = 8.0f;
+    const int timingPasses = 16;
+    const float tolerances[] = { 0.0f, 0.001f, 0.01f, 0.05f };
+
+    AFK_Camera camera;
+    camera.setSeparation(afk_vec3<float>(0.0f, 0.0f, 0.0f));
+    camera.setWindowDimensions(1280, 720);
+    camera.driveAndUpdateProjection(afk_vec3<float>(0.0f, 0.0f, 0.0f), afk_vec3<float>(0.1f, 0.3f, 0.0f));
+    Vec3<float> viewerLocation = afk_vec3<float>(0.0f, 0.0f, 0.0f);
+
+    /* The cells are spread out so that a good number of them are
+     * near the line, which is where the metrics could disagree.
+     */
+    AFK_Boost_Taus88_RNG rng;
+    rng.seed(AFK_RNG_Value(46));
+
+    std::vector<AFK_VisibleCell> visibleCells(cellCount);
+    for (unsigned int i = 0; i < cellCount; ++i)
+    {
+        int64_t scale = 2ll << (rng.uirand() % 6);
+        visibleCells[i].bindToCell(afk_cell(afk_vec4<int64_t>(
+            ((int64_t)(rng.uirand() % 256) - 128) * scale,
+            ((int64_t)(rng.uirand() % 256) - 128) * scale,
+            ((int64_t)(rng.uirand() % 256) - 128) * scale,
+            scale)), worldScale);
+    }
+
+    std::vector<bool> reference(cellCount);
+    unsigned int fineCount = 0;
+    for (unsigned int i = 0; i < cellCount; ++i)
+    {
+        reference[i] = visibleCells[i].testDetailPitch(detailPitch, camera, viewerLocation);
+        if (reference[i]) ++fineCount;
+    }
+
+    afk_out << "Cells fine enough:            " << fineCount << " of " << cellCount << std::endl;
+
+    unsigned int tally = 0;
+    afk_clock::time_point startTime = afk_clock::now();
+    for (int pass = 0; pass < timingPasses; ++pass)
+    {
+        for (auto& visibleCell : visibleCells)
+            if (visibleCell.testDetailPitch(detailPitch, camera, viewerLocation)) ++tally;
+    }
+
+    afk_duration_mfl vertexTime = std::chrono::duration_cast<afk_duration_mfl>(afk_clock::now() - startTime);
+    float cellsTested = (float)cellCount * (float)timingPasses;
+    afk_out << "Vertex cells per second:      " << 1000.0f * cellsTested / vertexTime.count() << std::endl;
+
+    for (auto tolerance : tolerances)
+    {
+        unsigned int disagreements = 0;
+        for (unsigned int i = 0; i < cellCount; ++i)
+        {
+            if (visibleCells[i].testDetailPitch(detailPitch, camera, viewerLocation, tolerance) != reference[i])
+                ++disagreements;
+        }
+
+        startTime = afk_clock::now();
+        for (int pass = 0; pass < timingPasses; ++pass)
+        {
+            for (auto& visibleCell : visibleCells)
+                if (visibleCell.testDetailPitch(detailPitch, camera, viewerLocation, tolerance)) ++tally;
+        }
+
+        afk_duration_mfl sphereTime = std::chrono::duration_cast<afk_duration_mfl>(afk_clock::now() - startTime);
+        afk_out << "Sphere tolerance " << tolerance << ": " << disagreements << " disagreements, " <<
+            1000.0f * cellsTested / sphereTime.count() << " cells per second (speedup " <<
+            vertexTime.count() / sphereTime.count() << ")" << std::endl;
+
+        /* At 0, the sphere only ever answers when it's certain. */
+        if (tolerance == 0.0f) assert(disagreements == 0);
+    }
+
+    afk_out << "(tally " << tally << ")" << std::endl;
+    afk_out << std::endl;
+}
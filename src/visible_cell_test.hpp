@@ -0,0 +1,33 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#ifndef _AFK_VISIBLE_CELL_TEST_H_
+#define _AFK_VISIBLE_CELL_TEST_H_
+
+/* Checks that the batch visibility tests give the same answers as
+ * the one-point-at-a-time ones, and times them.
+ * This needs the configuration to have been loaded (for the camera).
+ */
+void test_visibleCell(void);
+
+/* Checks how often the bounding sphere detail pitch disagrees with
+ * the 8 vertex one at a few tolerances (never, at 0), and times
+ * them.
+ */
+void test_detailPitch(void);
+
+#endif /* _AFK_VISIBLE_CELL_TEST_H_ */
@@ -20,11 +20,15 @@
 
 #include "afk.hpp"
 
+#include <cstdint>
+
 #include <boost/atomic.hpp>
 
 #include "async/work_queue.hpp"
+#include "clock.hpp"
 #include "def.hpp"
 #include "keyed_cell.hpp"
+#include "tile.hpp"
 
 /* Defines the work item for the world generator gang.
  * New functions that are valid in the gang need to
@@ -76,14 +80,14 @@ public:
      * you responsible for deleting the object).
      * Else, returns false.
      */
-    bool check(AFK_WorkQueue<ParameterType, ReturnType, ThreadLocalType>& queue)
+    bool check(unsigned int threadId, AFK_WorkQueue<ParameterType, ReturnType, ThreadLocalType>& queue)
     {
         if (count.fetch_sub(1) == 1)
         {
             /* I just subtracted the last dependent task.
              * Enqueue the final task.
              */
-            queue.push(finalItem);
+            queue.push(threadId, finalItem);
             return true;
         }
 
@@ -92,12 +96,129 @@ public:
 };
 
 
+/* A parked work item is one that's waiting for a claimable to be
+ * released (see data/claim_waiters.hpp), and then goes back on
+ * the queue it came from, exactly once.  That's rather than going
+ * round and round the queue trying to claim the thing while it's
+ * busy.
+ */
+template<typename ParameterType, typename ReturnType, typename ThreadLocalType>
+class AFK_ParkedWork
+{
+public:
+    typedef typename AFK_WorkQueue<ParameterType, ReturnType, ThreadLocalType>::WorkItem WorkItem;
+
+protected:
+    WorkItem item;
+    AFK_WorkQueue<ParameterType, ReturnType, ThreadLocalType> *queue;
+
+public:
+    AFK_ParkedWork(const WorkItem& _item, AFK_WorkQueue<ParameterType, ReturnType, ThreadLocalType>& _queue):
+        item(_item), queue(&_queue) {}
+
+    void wake(unsigned int threadId)
+    {
+        queue->push(threadId, item);
+    }
+};
+
+
 /* The thread-local parameter is quite simple for now: */
 struct AFK_WorldWorkThreadLocal
 {
     AFK_Camera camera;
     Vec3<float> viewerLocation;
     float detailPitch;
+
+    /* Past this point, the world stops subdividing cells and
+     * displays what it's got.  time_point::max() means no
+     * deadline.
+     */
+    afk_clock::time_point deadline;
+};
+
+/* What the world work functions return: counts of what they got
+ * up to.  The gang adds these up per worker and then across the
+ * workers at the end of the enumeration (AFK_WorldWorkReducer), so
+ * the world gets its per-frame statistics without every worker
+ * hammering the same shared counters.
+ */
+struct AFK_WorldWorkResult
+{
+    uint64_t cellsEnumerated;
+    uint64_t cellsEnumeratedLocally;
+    uint64_t cellsInvisible;
+    uint64_t cellsOccluded;
+    uint64_t subtreesSkippedEmpty;
+    uint64_t cellsResumed;
+    uint64_t cellsParked;
+    uint64_t cellsCutOffByDeadline;
+    uint64_t tilesEnumerated;
+    uint64_t tileClaimFailures;
+    uint64_t tilesQueued;
+    uint64_t tilesResumed;
+    uint64_t tilesParked;
+    uint64_t tilesComputed;
+    uint64_t tilesRecomputedAfterSweep;
+    uint64_t entitiesQueued;
+
+    uint64_t shapeCellsInvisible;
+    uint64_t shapeCellsReducedOut;
+    uint64_t shapeCellsResumed;
+    uint64_t shapeVapoursComputed;
+    uint64_t shapeEdgesComputed;
+    uint64_t separateVapoursComputed;
+
+    uint64_t dependenciesFollowed;
+
+    AFK_WorldWorkResult():
+        cellsEnumerated(0), cellsEnumeratedLocally(0), cellsInvisible(0), cellsOccluded(0), subtreesSkippedEmpty(0), cellsResumed(0), cellsParked(0), cellsCutOffByDeadline(0), tilesEnumerated(0),
+        tileClaimFailures(0), tilesQueued(0),
+        tilesResumed(0), tilesParked(0), tilesComputed(0), tilesRecomputedAfterSweep(0), entitiesQueued(0),
+        shapeCellsInvisible(0), shapeCellsReducedOut(0), shapeCellsResumed(0),
+        shapeVapoursComputed(0), shapeEdgesComputed(0), separateVapoursComputed(0),
+        dependenciesFollowed(0) {}
+
+    AFK_WorldWorkResult& operator+=(const AFK_WorldWorkResult& r)
+    {
+        cellsEnumerated             += r.cellsEnumerated;
+        cellsEnumeratedLocally      += r.cellsEnumeratedLocally;
+        cellsInvisible              += r.cellsInvisible;
+        cellsOccluded               += r.cellsOccluded;
+        subtreesSkippedEmpty        += r.subtreesSkippedEmpty;
+        cellsResumed                += r.cellsResumed;
+        cellsParked                 += r.cellsParked;
+        cellsCutOffByDeadline       += r.cellsCutOffByDeadline;
+        tilesEnumerated             += r.tilesEnumerated;
+        tileClaimFailures           += r.tileClaimFailures;
+        tilesQueued                 += r.tilesQueued;
+        tilesResumed                += r.tilesResumed;
+        tilesParked                 += r.tilesParked;
+        tilesComputed               += r.tilesComputed;
+        tilesRecomputedAfterSweep   += r.tilesRecomputedAfterSweep;
+        entitiesQueued              += r.entitiesQueued;
+        shapeCellsInvisible         += r.shapeCellsInvisible;
+        shapeCellsReducedOut        += r.shapeCellsReducedOut;
+        shapeCellsResumed           += r.shapeCellsResumed;
+        shapeVapoursComputed        += r.shapeVapoursComputed;
+        shapeEdgesComputed          += r.shapeEdgesComputed;
+        separateVapoursComputed     += r.separateVapoursComputed;
+        dependenciesFollowed        += r.dependenciesFollowed;
+        return *this;
+    }
+};
+
+struct AFK_WorldWorkReducer
+{
+    struct AFK_WorldWorkResult identity(void) const
+    {
+        return AFK_WorldWorkResult();
+    }
+
+    void operator()(struct AFK_WorldWorkResult& acc, const struct AFK_WorldWorkResult& value) const
+    {
+        acc += value;
+    }
 };
 
 /* The work parameter type is a union of all possible
@@ -105,11 +226,14 @@ struct AFK_WorldWorkThreadLocal
  */
 union AFK_WorldWorkParam
 {
-    typedef AFK_WorkDependency<union AFK_WorldWorkParam, bool, struct AFK_WorldWorkThreadLocal> Dependency;
+    typedef AFK_WorkDependency<union AFK_WorldWorkParam, struct AFK_WorldWorkResult, struct AFK_WorldWorkThreadLocal> Dependency;
 
+    /* The cells in here are packed, to keep the work items (and
+     * the queues full of them) small.
+     */
     struct World
     {
-        AFK_Cell cell;
+        AFK_PackedCell cell;
         unsigned int flags;
         Dependency *dependency;  /* TODO: I suspect this is wrong and I should have a
                                   * separate dependency heap to query.  But I'm not
@@ -117,9 +241,23 @@ union AFK_WorldWorkParam
                                   */
     } world;
 
+    /* A landscape tile, when the landscape is enumerated by
+     * itself (see AFK_World::generateLandscapeQuad()).  The y-bounds
+     * are a guess at where the landscape is, passed down from the
+     * parent tile, for until this one has its own.
+     */
+    struct Landscape
+    {
+        AFK_PackedTile tile;
+        float yBoundLower;
+        float yBoundUpper;
+        unsigned int flags;
+        Dependency *dependency;
+    } landscape;
+
     struct Shape
     {
-        AFK_KeyedCell cell;
+        AFK_PackedKeyedCell cell;
         Mat4<float> transformation;
         unsigned int flags;
 
@@ -132,7 +270,8 @@ union AFK_WorldWorkParam
     } shape;
 };
 
-typedef AFK_WorkQueue<union AFK_WorldWorkParam, bool, struct AFK_WorldWorkThreadLocal> AFK_WorldWorkQueue;
+typedef AFK_WorkQueue<union AFK_WorldWorkParam, struct AFK_WorldWorkResult, struct AFK_WorldWorkThreadLocal> AFK_WorldWorkQueue;
+typedef AFK_ParkedWork<union AFK_WorldWorkParam, struct AFK_WorldWorkResult, struct AFK_WorldWorkThreadLocal> AFK_WorldParkedWork;
 
 #endif /* _AFK_WORK_H_ */
 
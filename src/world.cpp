@@ -17,16 +17,19 @@
 
 #include "afk.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cfloat>
 #include <cmath>
 #include <memory>
 
 #include "core.hpp"
+#include "data/claim_waiters.hpp"
 #include "debug.hpp"
 #include "exception.hpp"
 #include "file/logstream.hpp"
 #include "landscape_tile.hpp"
+#include "trace.hpp"
 #include "rng/boost_taus88.hpp"
 #include "rng/rng.hpp"
 #include "work.hpp"
@@ -41,10 +44,14 @@
 #define PROTAGONIST_CELL_DEBUG 0
 
 
-/* The AFK_WorldCellGenParam flags. */
+/* The AFK_WorldCellGenParam flags.  (The landscape quadtree uses
+ * the terrain render and resume ones as well.)
+ */
 #define AFK_WCG_FLAG_ENTIRELY_VISIBLE   2 /* Cell is already known to be entirely within the viewing frustum */
 #define AFK_WCG_FLAG_TERRAIN_RENDER     4 /* Render the terrain regardless of visibility or LoD */
 #define AFK_WCG_FLAG_RESUME             8 /* This is a resume after dependent cells were computed */
+#define AFK_WCG_FLAG_FRONT              16 /* Cell was a leaf of the last enumeration */
+#define AFK_WCG_FLAG_ENTITIES_ONLY      32 /* Cell is above the front's seeds: just queue its entities */
 
 /* The cell generating worker. */
 
@@ -53,19 +60,19 @@
  * making a new one.
  */
 
-bool afk_generateWorldCells(
+/* Does one cell, for afk_generateWorldCells() below. */
+void afk_generateWorldCell(
     unsigned int threadId,
-    const union AFK_WorldWorkParam& param,
+    const struct AFK_WorldWorkParam::World& param,
     const struct AFK_WorldWorkThreadLocal& threadLocal,
-    AFK_WorldWorkQueue& queue)
+    AFK_WorldWorkQueue& queue,
+    struct AFK_WorldWorkResult& result)
 {
-    const AFK_Cell cell                 = param.world.cell;
+    const AFK_Cell cell                 = afk_cell(param.cell);
     AFK_World *world                    = afk_core.world;
 
-    bool renderTerrain                  = ((param.world.flags & AFK_WCG_FLAG_TERRAIN_RENDER) != 0);
-    bool resume                         = ((param.world.flags & AFK_WCG_FLAG_RESUME) != 0);
-
-    bool retval = true;
+    bool renderTerrain                  = ((param.flags & AFK_WCG_FLAG_TERRAIN_RENDER) != 0);
+    bool resume                         = ((param.flags & AFK_WCG_FLAG_RESUME) != 0);
 
     /* I want an exclusive claim on world cells to stop me from
      * repeating the recursive search process.
@@ -78,48 +85,128 @@ bool afk_generateWorldCells(
     unsigned int claimFlags = AFK_CL_BLOCK;
     if (!renderTerrain && !resume) claimFlags |= AFK_CL_EXCLUSIVE;
 
-    auto worldCellClaim = world->worldCache->insertAndClaim(threadId, cell, claimFlags);
+    /* A leaf of the last enumeration that's now out of sight
+     * can stay a leaf without my going near the cache.
+     */
+    if ((param.flags & AFK_WCG_FLAG_FRONT) != 0 &&
+        world->frontCellIsHidden(threadId, cell, threadLocal, result))
+    {
+        world->volumeLeftToEnumerate.remove(threadId, CUBE(cell.coord.v[3]));
+        return;
+    }
+
+    auto worldCellClaim = world->worldCache->insertAndClaim(threadId, param.cell, claimFlags);
     if (worldCellClaim.isValid())
     {
-        retval = world->generateClaimedWorldCell(
-            worldCellClaim, threadId, param.world, threadLocal, queue);
+        world->generateClaimedWorldCell(
+            worldCellClaim, threadId, param, threadLocal, queue, result);
     }
     else
     {
-        /* This cell is busy, try again in a moment --
-         * and track its volume again
+        /* This cell is busy, try again when whoever's got it
+         * lets go -- and track its volume again
          */
-        world->volumeLeftToEnumerate.fetch_add(CUBE(cell.coord.v[3]));
+        world->volumeLeftToEnumerate.add(threadId, CUBE(cell.coord.v[3]));
 
         AFK_WorldWorkQueue::WorkItem resumeItem;
         resumeItem.func = afk_generateWorldCells;
-        resumeItem.param.world = param.world;
+        resumeItem.param.world = param;
 
-        if (param.world.dependency) param.world.dependency->retain();
-        queue.push(resumeItem);
-        world->cellsResumed.fetch_add(1);
+        if (param.dependency) param.dependency->retain();
+        if (world->parkResume(threadId, world->worldCache->get(threadId, param.cell), claimFlags, resumeItem, queue))
+        {
+            ++result.cellsParked;
+        }
+        else
+        {
+            queue.push(resumeItem);
+            ++result.cellsResumed;
+        }
     }
 
     /* If this cell had a dependency ... */
-    if (param.world.dependency)
+    if (param.dependency)
     {
-        if (param.world.dependency->check(queue))
+        if (param.dependency->check(threadId, queue))
         {
-            world->dependenciesFollowed.fetch_add(1);
-               delete param.world.dependency;
+            ++result.dependenciesFollowed;
+            world->dependencyPool.free(threadId, param.dependency);
         }
     }
 
     /* I enumerated this cell */
-    world->volumeLeftToEnumerate.fetch_sub(CUBE(cell.coord.v[3]));
+    world->volumeLeftToEnumerate.remove(threadId, CUBE(cell.coord.v[3]));
+}
+
+struct AFK_WorldWorkResult afk_generateWorldCells(
+    unsigned int threadId,
+    const union AFK_WorldWorkParam& param,
+    const struct AFK_WorldWorkThreadLocal& threadLocal,
+    AFK_WorldWorkQueue& queue)
+{
+    AFK_TRACE_SCOPE(threadId, "generateWorldCells")
+
+    struct AFK_WorldWorkResult result;
+    afk_generateWorldCell(threadId, param.world, threadLocal, queue, result);
 
-    return retval;
+    /* The small subcells that came out of that are mine to do,
+     * depth first, without going back to the queue.
+     */
+    std::vector<struct AFK_WorldWorkParam::World>& localStack =
+        afk_core.world->localStacks[threadId].items;
+    while (!localStack.empty())
+    {
+        struct AFK_WorldWorkParam::World localParam = localStack.back();
+        localStack.pop_back();
+        afk_generateWorldCell(threadId, localParam, threadLocal, queue, result);
+        ++result.cellsEnumeratedLocally;
+    }
+
+    return result;
+}
+
+/* The landscape quadtree's worker (see
+ * AFK_World::generateLandscapeQuad()).
+ */
+struct AFK_WorldWorkResult afk_generateLandscapeTiles(
+    unsigned int threadId,
+    const union AFK_WorldWorkParam& param,
+    const struct AFK_WorldWorkThreadLocal& threadLocal,
+    AFK_WorldWorkQueue& queue)
+{
+    AFK_TRACE_SCOPE(threadId, "generateLandscapeTiles")
+
+    struct AFK_WorldWorkResult result;
+    AFK_World *world = afk_core.world;
+    world->generateLandscapeQuad(threadId, param.landscape, threadLocal, queue, result);
+
+    /* If this tile had a dependency ... */
+    if (param.landscape.dependency)
+    {
+        if (param.landscape.dependency->check(threadId, queue))
+        {
+            ++result.dependenciesFollowed;
+            world->dependencyPool.free(threadId, param.landscape.dependency);
+        }
+    }
+
+    /* I enumerated this tile */
+    world->volumeLeftToEnumerate.remove(threadId, CUBE(afk_tile(param.landscape.tile).coord.v[2]));
+    return result;
+}
+
+/* Puts a parked resume back on its queue. */
+void AFK_World::wakeParkedWork(unsigned int threadId, void *context)
+{
+    AFK_WorldParkedWork *parked = static_cast<AFK_WorldParkedWork*>(context);
+    parked->wake(threadId);
+    afk_core.world->parkedWorkPool.free(threadId, parked);
 }
 
 /* The cell-generation-finished check. */
 bool afk_worldGenerationFinished(void)
 {
-    return (afk_core.world->volumeLeftToEnumerate.load() == 0);
+    return afk_core.world->volumeLeftToEnumerate.finished();
 }
 
 AFK_AsyncTaskFinishedFunc afk_worldGenerationFinishedFunc = afk_worldGenerationFinished;
@@ -130,7 +217,8 @@ AFK_AsyncTaskFinishedFunc afk_worldGenerationFinishedFunc = afk_worldGenerationF
 bool AFK_World::checkClaimedLandscapeTile(
     const AFK_Tile& tile,
     AFK_LandscapeTile& landscapeTile,
-    bool display)
+    bool display,
+    struct AFK_WorldWorkResult& result)
 {
     /* A LandscapeTile has several stages of creation.
      * First, make sure it's got a terrain descriptor, which
@@ -156,7 +244,7 @@ bool AFK_World::checkClaimedLandscapeTile(
 
         case AFK_LANDSCAPE_TILE_PIECE_SWEPT:
             /* I'd like some stats on how often this happens */
-            tilesRecomputedAfterSweep.fetch_add(1);
+            ++result.tilesRecomputedAfterSweep;
             needsArtwork = true;
             break;
 
@@ -184,14 +272,15 @@ bool AFK_World::generateLandscapeArtwork(
     const AFK_Tile& tile,
     AFK_LandscapeTile& landscapeTile,
     unsigned int threadId,
-    std::vector<AFK_Tile>& missingTiles)
+    AFK_FramePackedTileVector& missingTiles,
+    struct AFK_WorldWorkResult& result)
 {
     /* Create the terrain list, which is composed out of
      * the terrain descriptor for this landscape tile, and
      * those of all the parent tiles (so that child tiles
      * just add detail to an existing terrain).
      */
-    AFK_TerrainList terrainList;
+    AFK_TerrainList terrainList(&frameArenas[threadId]);
     landscapeTile.buildTerrainList(
         threadId,
         terrainList,
@@ -234,7 +323,7 @@ bool AFK_World::generateLandscapeArtwork(
     computeQueue->extend(terrainList, piece2D, tile, lSizes);
 #endif
 
-    tilesComputed.fetch_add(1);
+    ++result.tilesComputed;
     return false;
 }
 
@@ -242,7 +331,8 @@ void AFK_World::displayLandscapeTile(
     const AFK_Cell& cell,
     const AFK_Tile& tile,
     const AFK_LandscapeTile& landscapeTile,
-    unsigned int threadId)
+    unsigned int threadId,
+    struct AFK_WorldWorkResult& result)
 {
 #if DEBUG_JIGSAW_ASSOCIATION
     AFK_DEBUG_PRINTL("Display: " << tile << " (" << landscapeTile << ")")
@@ -268,10 +358,168 @@ void AFK_World::displayLandscapeTile(
             landscapeDisplayFair.getUpdateQueue(jigsawPiece.puzzle);
 
         ldq->add(unit, tile);
-        tilesQueued.fetch_add(1);
+        ++result.tilesQueued;
+
+        /* This'll hide whatever's behind it next time. */
+        if (useHorizonCulling)
+            horizon.addOccluder(threadId, tile.toWorldSpace(minCellSize), landscapeTile.getYBoundLower());
     }
 }
 
+void AFK_World::generateLandscapeTile(
+    unsigned int threadId,
+    const AFK_Tile& tile,
+    const AFK_Cell *displayCells,
+    unsigned int displayCellsCount,
+    bool renderTerrain,
+    const AFK_WorldWorkQueue::WorkItem& resumeItem,
+    int64_t resumeVolume,
+    AFK_WorldWorkParam::Dependency *dependency,
+    AFK_WorldWorkQueue& queue,
+    float& o_yBoundLower,
+    float& o_yBoundUpper,
+    struct AFK_WorldWorkResult& result)
+{
+    bool display = (displayCellsCount > 0);
+    bool needsResume = false;
+    AFK_FramePackedTileVector missingTiles((AFK_FrameAllocator<AFK_PackedTile>(&frameArenas[threadId])));
+
+    /* If the landscape tile is busy, these are the flags to wait
+     * for it with.
+     */
+    unsigned int landscapeParkFlags = 0;
+
+    const unsigned int landscapeClaimFlags = AFK_CL_BLOCK | AFK_CL_UPGRADE;
+    auto landscapeClaim = landscapeCache->insertAndClaim(threadId, afk_packedTile(tile), landscapeClaimFlags);
+    if (landscapeClaim.isValid())
+    {
+        o_yBoundLower = landscapeClaim.getShared().getYBoundLower();
+        o_yBoundUpper = landscapeClaim.getShared().getYBoundUpper();
+
+        if (!landscapeClaim.getShared().hasTerrainDescriptor() ||
+            ((renderTerrain || display) && landscapeClaim.getShared().artworkState(landscapeJigsaws) != AFK_LANDSCAPE_TILE_HAS_ARTWORK))
+        {
+            /* In order to generate this tile we need to upgrade
+             * our claim if we can.
+             */
+            if (landscapeClaim.upgrade())
+            {
+                AFK_LandscapeTile& landscapeTile = landscapeClaim.get();
+                if (checkClaimedLandscapeTile(tile, landscapeTile, display, result))
+                    needsResume = generateLandscapeArtwork(tile, landscapeTile, threadId, missingTiles, result);
+
+                if (!needsResume)
+                {
+                    for (unsigned int i = 0; i < displayCellsCount; ++i)
+                        displayLandscapeTile(displayCells[i], tile, landscapeTile, threadId, result);
+                }
+            }
+            else
+            {
+                /* Someone else is reading it: I need them all
+                 * to have gone.
+                 */
+                needsResume = true;
+                landscapeParkFlags = AFK_CL_BLOCK;
+                ++result.tileClaimFailures;
+            }
+        }
+        else
+        {
+            for (unsigned int i = 0; i < displayCellsCount; ++i)
+                displayLandscapeTile(displayCells[i], tile, landscapeClaim.getShared(), threadId, result);
+        }
+    }
+    else
+    {
+        needsResume = true;
+        landscapeParkFlags = landscapeClaimFlags;
+        ++result.tileClaimFailures;
+    }
+
+    /* If I need a resume for the landscape tile, push it in */
+    if (needsResume)
+    {
+        /* Because I'm doing a resume, I need to account for it in the
+         * remaining volume counter
+         */
+        volumeLeftToEnumerate.add(threadId, resumeVolume);
+        if (dependency) dependency->retain();
+
+        /* If we have missing tiles, that resume needs to be a
+         * dependency of those missing tiles:
+         */
+        if (!missingTiles.empty())
+        {
+            AFK_WorldWorkParam::Dependency *dep = dependencyPool.alloc(threadId, resumeItem);
+            dep->retain(missingTiles.size());
+
+            for (auto m : missingTiles)
+            {
+                AFK_Tile missingTile = afk_tile(m);
+                volumeLeftToEnumerate.add(threadId, CUBE(missingTile.coord.v[2]));
+
+                AFK_WorldWorkQueue::WorkItem missingItem;
+                if (useLandscapeQuadtree)
+                {
+                    missingItem.func = afk_generateLandscapeTiles;
+                    missingItem.param.landscape.tile        = m;
+                    missingItem.param.landscape.yBoundLower = -FLT_MAX;
+                    missingItem.param.landscape.yBoundUpper = FLT_MAX;
+                    missingItem.param.landscape.flags       = AFK_WCG_FLAG_TERRAIN_RENDER;
+                    missingItem.param.landscape.dependency  = dep;
+                }
+                else
+                {
+                    missingItem.func = afk_generateWorldCells;
+                    missingItem.param.world.cell        = afk_packedCell(afk_cell(missingTile, 0));
+                    missingItem.param.world.flags       = AFK_WCG_FLAG_ENTIRELY_VISIBLE | AFK_WCG_FLAG_TERRAIN_RENDER;
+                    missingItem.param.world.dependency  = dep;
+                }
+                queue.push(threadId, missingItem);
+            }
+
+            result.tilesResumed += missingTiles.size();
+        }
+        else
+        {
+            /* If the tile was busy, I'll wait until it isn't
+             * (having let go of my own claim, of course.)
+             * Otherwise, I enqueue the resume directly
+             */
+            if (landscapeClaim.isValid()) landscapeClaim.release();
+            if (landscapeParkFlags != 0 &&
+                parkResume(threadId, landscapeCache->get(threadId, afk_packedTile(tile)), landscapeParkFlags, resumeItem, queue))
+            {
+                ++result.tilesParked;
+            }
+            else
+            {
+                queue.push(resumeItem);
+            }
+        }
+
+        ++result.tilesResumed;
+    }
+}
+
+bool AFK_World::peekLandscapeYBounds(
+    unsigned int threadId,
+    const AFK_Tile& tile,
+    float& o_yBoundLower,
+    float& o_yBoundUpper)
+{
+    auto entry = landscapeCache->get(threadId, afk_packedTile(tile));
+    if (!entry) return false;
+
+    auto claim = entry->claimable.claimInplace(threadId, AFK_CL_SHARED);
+    if (!claim.isValid()) return false;
+
+    o_yBoundLower = claim.getShared().getYBoundLower();
+    o_yBoundUpper = claim.getShared().getYBoundUpper();
+    return true;
+}
+
 void AFK_World::generateStartingEntity(
     unsigned int shapeKey,
     AFK_WorldCell& worldCell,
@@ -284,22 +532,325 @@ void AFK_World::generateStartingEntity(
     worldCell.addStartingEntity(threadId, shapeKey, sSizes, rng);
 }
 
-bool AFK_World::generateClaimedWorldCell(
+unsigned int AFK_World::getCellPriority(
+    const AFK_Cell& cell,
+    const struct AFK_WorldWorkThreadLocal& threadLocal) const
+{
+    unsigned int levels = genGang->getPriorityLevels();
+    if (levels <= 1) return 0;
+
+    /* This is a cheaper version of the detail pitch test: just
+     * the midpoint, not all 8 vertices.
+     * Each level is a halving of the detail pitch, so a cell one
+     * subdivision short of being displayed comes in at the bottom.
+     */
+    Vec4<float> realCoord = cell.toWorldSpace(minCellSize);
+    Vec3<float> midpoint = afk_vec3<float>(
+        realCoord.v[0] + realCoord.v[3] * 0.5f,
+        realCoord.v[1] + realCoord.v[3] * 0.5f,
+        realCoord.v[2] + realCoord.v[3] * 0.5f);
+    float pitch = threadLocal.camera.getDetailPitchAsSeen(realCoord.v[3], midpoint, threadLocal.viewerLocation);
+    if (!(pitch > threadLocal.detailPitch)) return levels - 1;
+
+    float halvings = std::log2(pitch / threadLocal.detailPitch);
+    if (halvings >= (float)(levels - 1)) return 0;
+    return (levels - 1) - (unsigned int)halvings;
+}
+
+bool AFK_World::frontCellIsHidden(
+    unsigned int threadId,
+    const AFK_Cell& cell,
+    const struct AFK_WorldWorkThreadLocal& threadLocal,
+    struct AFK_WorldWorkResult& result)
+{
+    AFK_VisibleCell visibleCell;
+    visibleCell.bindToCell(cell, minCellSize);
+
+    bool someVisible = false;
+    bool allVisible = true;
+    visibleCell.testVisibility(threadLocal.camera, someVisible, allVisible);
+    if (!someVisible)
+    {
+        ++result.cellsInvisible;
+        recordLeaf(threadId, cell);
+        return true;
+    }
+
+    if (useHorizonCulling && horizon.occludes(cell.toWorldSpace(minCellSize)))
+    {
+        ++result.cellsOccluded;
+        recordLeaf(threadId, cell);
+        return true;
+    }
+
+    return false;
+}
+
+void AFK_World::generateCellEntities(
+    unsigned int threadId,
+    const AFK_Cell& cell,
+    AFK_WorldCell& worldCell,
+    float landscapeUpperYBound,
+    AFK_WorldWorkQueue& queue,
+    struct AFK_WorldWorkResult& result)
+{
+    /* Firstly, so long as it's above the landscape, give it
+     * some starting entities if it hasn't got them
+     * already.
+     */
+    if (worldCell.getRealCoord().v[1] >= landscapeUpperYBound)
+    {
+        /* TODO: This RNG will make the same set of entities every
+         * time the cell is re-displayed.  This is fine for probably
+         * static, landscape decoration type objects.  But I'm also
+         * going to want to have transient objects popping into
+         * existence, and those should be done with a different,
+         * long-period RNG that I retain (in thread local storage),
+         * perhaps a Mersenne Twister.
+         */
+        AFK_Boost_Taus88_RNG staticRng;
+        staticRng.seed(cell.rngSeed());
+        int startingEntityCount = worldCell.getStartingEntitiesWanted(
+            staticRng, entitySparseness);
+
+        for (int e = 0; e < startingEntityCount; ++e)
+        {
+            int shapeKey = worldCell.getStartingEntityShapeKey(staticRng);
+            generateStartingEntity(shapeKey, worldCell, threadId, staticRng);
+        }
+    }
+
+    for (int eI = 0; eI < worldCell.getEntityCount(); ++eI)
+    {
+        AFK_Entity& e = worldCell.getEntityAt(eI);
+        if (e.notProcessedYet(afk_core.computingFrame))
+        {
+            /* Account for this shape in the volume left to enumerate */
+            volumeLeftToEnumerate.add(threadId, CUBE(SHAPE_CELL_MAX_DISTANCE));
+
+            /* Make sure everything I need in that shape
+             * has been computed ...
+             */
+            AFK_WorldWorkQueue::WorkItem shapeCellItem;
+            shapeCellItem.func                          = afk_generateEntity;
+            shapeCellItem.param.shape.cell              = afk_packedKeyedCell(afk_keyedCell(afk_vec4<int64_t>(
+                                                            0, 0, 0, SHAPE_CELL_MAX_DISTANCE), e.shapeKey));
+            shapeCellItem.param.shape.transformation    = e.getTransformation();
+            shapeCellItem.param.shape.flags             = 0;
+
+#if AFK_SHAPE_ENUM_DEBUG
+            shapeCellItem.param.shape.asedWorldCell     = cell;
+            shapeCellItem.param.shape.asedCounter       = eI;
+            AFK_DEBUG_PRINTL("ASED: Enqueued entity: worldCell=" << cell << ", entity counter=" << eI)
+#endif
+
+            shapeCellItem.param.shape.dependency        = nullptr;
+            queue.push(threadId, shapeCellItem);
+
+            ++result.entitiesQueued;
+        }
+    }
+}
+
+/* The landscape quadtree tests each tile for visibility as a column
+ * of cells the landscape might be in, at most this many high.
+ */
+#define AFK_MAX_LANDSCAPE_SLABS 8
+
+void AFK_World::generateLandscapeQuad(
+    unsigned int threadId,
+    const struct AFK_WorldWorkParam::Landscape& param,
+    const struct AFK_WorldWorkThreadLocal& threadLocal,
+    AFK_WorldWorkQueue& queue,
+    struct AFK_WorldWorkResult& result)
+{
+    const AFK_Tile tile                 = afk_tile(param.tile);
+    const int64_t scale                 = tile.coord.v[2];
+    const Vec3<float>& viewerLocation   = threadLocal.viewerLocation;
+    const AFK_Camera& camera            = threadLocal.camera;
+
+    bool renderTerrain                  = ((param.flags & AFK_WCG_FLAG_TERRAIN_RENDER) != 0);
+    bool resume                         = ((param.flags & AFK_WCG_FLAG_RESUME) != 0);
+
+    if (!renderTerrain && !resume) ++result.tilesEnumerated;
+
+    /* Where's the landscape here?  If this tile has been made
+     * before, it knows; otherwise I go by what my parent
+     * told me.
+     */
+    float yBoundLower = -FLT_MAX;
+    float yBoundUpper = FLT_MAX;
+    if (!peekLandscapeYBounds(threadId, tile, yBoundLower, yBoundUpper) ||
+        yBoundLower == -FLT_MAX || yBoundUpper == FLT_MAX)
+    {
+        yBoundLower = param.yBoundLower;
+        yBoundUpper = param.yBoundUpper;
+    }
+
+    AFK_Cell *displayCells = nullptr;
+    unsigned int displayCellsCount = 0;
+    bool display = false;
+    AFK_Cell nearestSlab;
+
+    if (!renderTerrain)
+    {
+        assert(yBoundLower > -FLT_MAX && yBoundUpper < FLT_MAX);
+
+        /* That's this column of cells (y in cell co-ordinates): */
+        int64_t yCellLower = (int64_t)std::floor(yBoundLower / (minCellSize * (float)scale)) * scale;
+        int64_t yCellUpper = (int64_t)std::floor(yBoundUpper / (minCellSize * (float)scale)) * scale;
+
+        /* Is any of it visible?  If the column's a tall one, I test
+         * it in bigger cells (which cover all the same ground and
+         * then some).
+         */
+        int64_t visibleScale = scale;
+        while ((yCellUpper - yCellLower) / visibleScale >= AFK_MAX_LANDSCAPE_SLABS)
+            visibleScale *= subdivisionFactor;
+
+        bool someVisible = false;
+        for (int64_t y = (int64_t)std::floor((float)yCellLower / (float)visibleScale) * visibleScale;
+            y <= yCellUpper && !someVisible; y += visibleScale)
+        {
+            AFK_Cell slab = afk_cell(afk_vec4<int64_t>(tile.coord.v[0], y, tile.coord.v[1], visibleScale));
+            AFK_VisibleCell visibleSlab;
+            visibleSlab.bindToCell(slab, minCellSize);
+
+            bool slabAllVisible = true;
+            visibleSlab.testVisibility(camera, someVisible, slabAllVisible);
+            if (someVisible && useHorizonCulling && horizon.occludes(slab.toWorldSpace(minCellSize)))
+                someVisible = false;
+        }
+
+        if (!someVisible) return;
+
+        /* The finest the landscape here looks is in the cell
+         * nearest the viewer, so that's the one whose detail
+         * pitch counts.  As with the world cells, 2 is as small as
+         * it goes.
+         */
+        int64_t yViewer = (int64_t)std::floor(viewerLocation.v[1] / (minCellSize * (float)scale)) * scale;
+        int64_t yNearest = std::max(yCellLower, std::min(yCellUpper, yViewer));
+        nearestSlab = afk_cell(afk_vec4<int64_t>(tile.coord.v[0], yNearest, tile.coord.v[1], scale));
+
+        AFK_VisibleCell visibleNearest;
+        visibleNearest.bindToCell(nearestSlab, minCellSize);
+        display = (scale == 2 ||
+            visibleNearest.testDetailPitch(threadLocal.detailPitch, camera, viewerLocation, sphereDetailPitchTolerance));
+
+        if (!display && !resume &&
+            threadLocal.deadline != afk_clock::time_point::max() &&
+            afk_clock::now() > threadLocal.deadline)
+        {
+            display = true;
+            ++result.cellsCutOffByDeadline;
+        }
+
+        /* If I'm displaying it, each visible cell of the column
+         * gets its own display unit (clipped to it), just like it
+         * would have done with the world cells.  That's all of the
+         * column, however tall it is: anything I left out wouldn't
+         * get drawn.
+         */
+        if (display)
+        {
+            size_t columnSize = (size_t)((yCellUpper - yCellLower) / scale + 1);
+            displayCells = frameArenas[threadId].allocArray<AFK_Cell>(columnSize);
+            for (int64_t y = yCellLower; y <= yCellUpper; y += scale)
+            {
+                AFK_Cell slab = afk_cell(afk_vec4<int64_t>(tile.coord.v[0], y, tile.coord.v[1], scale));
+                if (columnSize > 1)
+                {
+                    AFK_VisibleCell visibleSlab;
+                    visibleSlab.bindToCell(slab, minCellSize);
+
+                    bool slabSomeVisible = false;
+                    bool slabAllVisible = true;
+                    visibleSlab.testVisibility(camera, slabSomeVisible, slabAllVisible);
+                    if (!slabSomeVisible) continue;
+                    if (useHorizonCulling && horizon.occludes(slab.toWorldSpace(minCellSize))) continue;
+                }
+
+                displayCells[displayCellsCount++] = slab;
+            }
+
+            /* The bigger cells I tested for visibility above can
+             * see a bit more than these.  If none of these are
+             * visible after all, there's nothing to do.
+             */
+            if (displayCellsCount == 0) return;
+        }
+    }
+
+    /* Now the tile itself. */
+    AFK_WorldWorkQueue::WorkItem resumeItem;
+    resumeItem.func = afk_generateLandscapeTiles;
+    resumeItem.param.landscape = param;
+    resumeItem.param.landscape.flags |= AFK_WCG_FLAG_RESUME;
+
+    float tileYBoundLower = -FLT_MAX;
+    float tileYBoundUpper = FLT_MAX;
+    generateLandscapeTile(
+        threadId, tile, displayCells, displayCellsCount, renderTerrain,
+        resumeItem, CUBE(scale), param.dependency, queue,
+        tileYBoundLower, tileYBoundUpper, result);
+
+    /* If it wasn't fine enough, on to the smaller tiles.  They
+     * get this one's y-bounds (as best I know them) with some
+     * room for the detail they'll add.
+     */
+    if (!display && !renderTerrain && !resume)
+    {
+        if (tileYBoundLower > -FLT_MAX && tileYBoundUpper < FLT_MAX)
+        {
+            yBoundLower = tileYBoundLower;
+            yBoundUpper = tileYBoundUpper;
+        }
+
+        int64_t subtileScale = scale / subdivisionFactor;
+        float subtileMargin = (float)subtileScale * minCellSize;
+        volumeLeftToEnumerate.add(threadId, CUBE(subtileScale) * SQUARE(subdivisionFactor));
+
+        /* The subtiles are all about the same distance off, so they
+         * can go in at the same priority.
+         */
+        unsigned int priority = getCellPriority(nearestSlab, threadLocal);
+        for (unsigned int i = 0; i < subdivisionFactor; ++i)
+        {
+            for (unsigned int j = 0; j < subdivisionFactor; ++j)
+            {
+                AFK_WorldWorkQueue::WorkItem subtileItem;
+                subtileItem.func                            = afk_generateLandscapeTiles;
+                subtileItem.param.landscape.tile            = afk_packedTile(afk_tile(afk_vec3<int64_t>(
+                                                                tile.coord.v[0] + subtileScale * i,
+                                                                tile.coord.v[1] + subtileScale * j,
+                                                                subtileScale)));
+                subtileItem.param.landscape.yBoundLower     = yBoundLower - subtileMargin;
+                subtileItem.param.landscape.yBoundUpper     = yBoundUpper + subtileMargin;
+                subtileItem.param.landscape.flags           = 0;
+                subtileItem.param.landscape.dependency      = nullptr;
+                queue.push(threadId, subtileItem, priority);
+            }
+        }
+    }
+}
+
+void AFK_World::generateClaimedWorldCell(
     AFK_WORLD_CACHE::Claim& claim,
     unsigned int threadId,
     const struct AFK_WorldWorkParam::World& param,
     const struct AFK_WorldWorkThreadLocal& threadLocal,
-    AFK_WorldWorkQueue& queue)
+    AFK_WorldWorkQueue& queue,
+    struct AFK_WorldWorkResult& result)
 {
-    const AFK_Cell& cell                = param.cell;
+    const AFK_Cell cell                 = afk_cell(param.cell);
     const Vec3<float>& viewerLocation   = threadLocal.viewerLocation;
     const AFK_Camera& camera            = threadLocal.camera;
 
     bool entirelyVisible                = ((param.flags & AFK_WCG_FLAG_ENTIRELY_VISIBLE) != 0);
     bool renderTerrain                  = ((param.flags & AFK_WCG_FLAG_TERRAIN_RENDER) != 0);
     bool resume                         = ((param.flags & AFK_WCG_FLAG_RESUME) != 0);
-
-    bool retval = true;
+    bool entitiesOnly                   = ((param.flags & AFK_WCG_FLAG_ENTITIES_ONLY) != 0);
 
     AFK_WorldCell& worldCell = claim.get();
     worldCell.bind(cell, minCellSize);
@@ -308,16 +859,32 @@ bool AFK_World::generateClaimedWorldCell(
     bool someVisible = entirelyVisible;
     bool allVisible = entirelyVisible;
 
+    if (!renderTerrain && !resume && !entitiesOnly) ++result.cellsEnumerated;
+
     if (!entirelyVisible) worldCell.testVisibility(camera, someVisible, allVisible);
     if (!someVisible && !renderTerrain)
     {
-        cellsInvisible.fetch_add(1);
+        if (!entitiesOnly)
+        {
+            ++result.cellsInvisible;
+            if (!resume) recordLeaf(threadId, cell);
+        }
     }
-    else /* if (cell.coord.v[1] == 0) */
+    else if (entitiesOnly)
     {
-        bool needsResume = false;
-        std::vector<AFK_Tile> missingTiles;
+        /* This cell is above the seeds of an incremental
+         * enumeration, which won't come back up here.  Its
+         * subcells and its landscape are done with, but its
+         * entities still need drawing.
+         */
+        float landscapeTileLowerYBound = -FLT_MAX;
+        float landscapeTileUpperYBound = FLT_MAX;
+        peekLandscapeYBounds(threadId, afk_tile(cell), landscapeTileLowerYBound, landscapeTileUpperYBound);
 
+        generateCellEntities(threadId, cell, worldCell, landscapeTileUpperYBound, queue, result);
+    }
+    else /* if (cell.coord.v[1] == 0) */
+    {
         /* We display geometry at a cell if its detail pitch is at the
          * target detail pitch, or if it's already the smallest
          * possible cell.
@@ -326,162 +893,76 @@ bool AFK_World::generateClaimedWorldCell(
          * be at +/- 0.5).
          */
         bool display = (cell.coord.v[3] == 2 ||
-            worldCell.testDetailPitch(threadLocal.detailPitch, camera, viewerLocation));
+            worldCell.testDetailPitch(threadLocal.detailPitch, camera, viewerLocation, sphereDetailPitchTolerance));
+
+        /* If I've run out of time for this frame, I stop here and
+         * display what I've got rather than going any finer.  (The
+         * coarse cells went first, so it's the fine detail that's
+         * missing.)
+         */
+        if (!display && !renderTerrain && !resume &&
+            threadLocal.deadline != afk_clock::time_point::max() &&
+            afk_clock::now() > threadLocal.deadline)
+        {
+            display = true;
+            ++result.cellsCutOffByDeadline;
+        }
 
         /* Find the tile where any landscape at this cell would be
          * homed
          */
         AFK_Tile tile = afk_tile(cell);
 
-        /* I'm going to want this in a moment.
+        /* I'm going to want these in a moment.
          */
+        float landscapeTileLowerYBound = -FLT_MAX;
         float landscapeTileUpperYBound = FLT_MAX;
 
-        /* We always at least touch the landscape.  Higher detailed
-         * landscape tiles are dependent on lower detailed ones for their
-         * terrain description.
-         */
-        auto landscapeClaim = landscapeCache->insertAndClaim(threadId, tile, AFK_CL_BLOCK | AFK_CL_UPGRADE);
-        if (landscapeClaim.isValid())
+        if (useLandscapeQuadtree)
         {
-            landscapeTileUpperYBound = landscapeClaim.getShared().getYBoundUpper();
-        
-            if (!landscapeClaim.getShared().hasTerrainDescriptor() ||
-                ((renderTerrain || display) && landscapeClaim.getShared().artworkState(landscapeJigsaws) != AFK_LANDSCAPE_TILE_HAS_ARTWORK))
-            {
-                /* In order to generate this tile we need to upgrade
-                 * our claim if we can.
-                 */
-                if (landscapeClaim.upgrade())
-                {
-                    AFK_LandscapeTile& landscapeTile = landscapeClaim.get();
-                    if (checkClaimedLandscapeTile(tile, landscapeTile, display))
-                        needsResume = generateLandscapeArtwork(tile, landscapeTile, threadId, missingTiles);
-        
-                    if (!needsResume && display)
-                        displayLandscapeTile(cell, tile, landscapeTile, threadId);
-                }
-                else
-                {
-                    needsResume = true;
-                }
-            }
-            else if (display)
-            {
-                displayLandscapeTile(cell, tile, landscapeClaim.getShared(), threadId);
-            }
+            /* The landscape is being done by itself.  All I want
+             * is its y-bounds for the entities, if it's got that
+             * far: I'm not going to wait for it.
+             */
+            peekLandscapeYBounds(threadId, tile, landscapeTileLowerYBound, landscapeTileUpperYBound);
         }
         else
         {
-            needsResume = true;
-        }
-
-        /* If I need a resume for the landscape tile, push it in */
-        if (needsResume)
-        {
-            /* Because I'm doing a resume, I need to account for it in the
-             * remaining volume counter
+            /* We always at least touch the landscape.  Higher detailed
+             * landscape tiles are dependent on lower detailed ones for their
+             * terrain description.
              */
-            volumeLeftToEnumerate.fetch_add(CUBE(cell.coord.v[3]));
-
             AFK_WorldWorkQueue::WorkItem resumeItem;
             resumeItem.func = afk_generateWorldCells;
             resumeItem.param.world = param;
             resumeItem.param.world.flags |= AFK_WCG_FLAG_RESUME;
-            if (param.dependency) param.dependency->retain();
-
-            /* If we have missing tiles, that resume needs to be a
-             * dependency of those missing tiles:
-             */
-            if (!missingTiles.empty())
-            {
-                AFK_WorldWorkParam::Dependency *dep = new AFK_WorldWorkParam::Dependency(resumeItem);
-                dep->retain(missingTiles.size());
-
-                for (auto m : missingTiles)
-                {
-                    volumeLeftToEnumerate.fetch_add(CUBE(m.coord.v[2]));
-
-                    AFK_WorldWorkQueue::WorkItem missingItem;
-                    missingItem.func = afk_generateWorldCells;
-                    missingItem.param.world.cell        = afk_cell(m, 0);
-                    missingItem.param.world.flags       = AFK_WCG_FLAG_ENTIRELY_VISIBLE | AFK_WCG_FLAG_TERRAIN_RENDER;
-                    missingItem.param.world.dependency  = dep;
-                    queue.push(missingItem);
-                }
-
-                tilesResumed.fetch_add(missingTiles.size());
-            }
-            else
-            {
-                /* We enqueue the resume directly */
-                queue.push(resumeItem);
-            }
 
-            tilesResumed.fetch_add(1);
+            generateLandscapeTile(
+                threadId, tile, &cell, (display ? 1 : 0), renderTerrain,
+                resumeItem, CUBE(cell.coord.v[3]), param.dependency, queue,
+                landscapeTileLowerYBound, landscapeTileUpperYBound, result);
         }
 
         if (!resume && !renderTerrain)
         {
             /* Now that I've done all that, I can get to the
              * business of handling the entities within the cell.
-             * Firstly, so long as it's above the landscape, give it
-             * some starting entities if it hasn't got them
-             * already.
              */
-        
-            if (worldCell.getRealCoord().v[1] >= landscapeTileUpperYBound)
-            {
-                /* TODO: This RNG will make the same set of entities every
-                 * time the cell is re-displayed.  This is fine for probably
-                 * static, landscape decoration type objects.  But I'm also
-                 * going to want to have transient objects popping into
-                 * existence, and those should be done with a different,
-                 * long-period RNG that I retain (in thread local storage),
-                 * perhaps a Mersenne Twister.
-                 */
-                AFK_Boost_Taus88_RNG staticRng;
-                staticRng.seed(cell.rngSeed());
-                int startingEntityCount = worldCell.getStartingEntitiesWanted(
-                    staticRng, entitySparseness);
-        
-                for (int e = 0; e < startingEntityCount; ++e)
-                {
-                    int shapeKey = worldCell.getStartingEntityShapeKey(staticRng);
-                    generateStartingEntity(shapeKey, worldCell, threadId, staticRng);
-                }
-            }
-        
-            for (int eI = 0; eI < worldCell.getEntityCount(); ++eI)
-            {
-                AFK_Entity& e = worldCell.getEntityAt(eI);
-                if (e.notProcessedYet(afk_core.computingFrame))
-                {
-                    /* Account for this shape in the volume left to enumerate */
-                    volumeLeftToEnumerate.fetch_add(CUBE(SHAPE_CELL_MAX_DISTANCE));
-
-                    /* Make sure everything I need in that shape
-                     * has been computed ...
-                     */
-                    AFK_WorldWorkQueue::WorkItem shapeCellItem;
-                    shapeCellItem.func                          = afk_generateEntity;
-                    shapeCellItem.param.shape.cell              = afk_keyedCell(afk_vec4<int64_t>(
-                                                                    0, 0, 0, SHAPE_CELL_MAX_DISTANCE), e.shapeKey);
-                    shapeCellItem.param.shape.transformation    = e.getTransformation();
-                    shapeCellItem.param.shape.flags             = 0;
-        
-#if AFK_SHAPE_ENUM_DEBUG
-                    shapeCellItem.param.shape.asedWorldCell     = cell;
-                    shapeCellItem.param.shape.asedCounter       = eI;
-                    AFK_DEBUG_PRINTL("ASED: Enqueued entity: worldCell=" << cell << ", entity counter=" << eI)
-#endif
-        
-                    shapeCellItem.param.shape.dependency        = nullptr;
-                    queue.push(shapeCellItem);
-            
-                    entitiesQueued.fetch_add(1);
-                }
-            }
+            generateCellEntities(threadId, cell, worldCell, landscapeTileUpperYBound, queue, result);
+        }
+
+        /* If I'm about to subdivide, first check whether there's
+         * anything under here to find.
+         */
+        bool subdivide = (!display && !renderTerrain && someVisible && !resume);
+        if (subdivide && useEmptySubtreeSkipping &&
+            worldCell.testSubtreeEmpty(
+                cell, minCellSize, landscapeTileLowerYBound, landscapeTileUpperYBound,
+                emptySubtreeYMargin, subdivisionFactor, entitySparseness, emptySubtreeEntityDepth))
+        {
+            subdivide = false;
+            ++result.subtreesSkippedEmpty;
+            recordLeaf(threadId, cell);
         }
 
         /* We don't need this any more */
@@ -490,31 +971,77 @@ bool AFK_World::generateClaimedWorldCell(
         /* If the terrain here was at too coarse a resolution to
          * be displayable, recurse through the subcells
          */
-        if (!display && !renderTerrain && someVisible && !resume)
+        if (subdivide)
         {
-            /* I'm about to enumerate this cell's volume in subcells */
-            volumeLeftToEnumerate.fetch_add(CUBE(cell.coord.v[3]));
-
             size_t subcellsSize = CUBE(subdivisionFactor);
-            AFK_Cell *subcells = new AFK_Cell[subcellsSize]; /* TODO avoid heap thrashing somehow.  Maybe make it an iterator */
+            AFK_Cell *subcells = frameArenas[threadId].allocArray<AFK_Cell>(subcellsSize);
             unsigned int subcellsCount = cell.subdivide(subcells, subcellsSize, subdivisionFactor);
             assert(subcellsCount == subcellsSize);
 
+            /* If this cell was only partly visible, I cull the
+             * invisible subcells here, all together, rather than
+             * giving each one a cache entry and a trip round the
+             * queue only to find out that it can't be seen.
+             */
+            bool subcellsSomeVisible[CUBE(AFK_MAX_BATCH_SUBDIVISION_FACTOR)];
+            bool subcellsAllVisible[CUBE(AFK_MAX_BATCH_SUBDIVISION_FACTOR)];
+            bool culled = (!allVisible && afk_testSubcellVisibility(
+                cell, subdivisionFactor, minCellSize, camera, subcellsSomeVisible, subcellsAllVisible));
+
+            /* ...and likewise the subcells hidden behind the
+             * landscape.
+             */
+            bool subcellsOccluded[CUBE(AFK_MAX_BATCH_SUBDIVISION_FACTOR)];
+            unsigned int subcellsQueued = 0;
             for (unsigned int i = 0; i < subcellsCount; ++i)
             {
+                subcellsOccluded[i] = false;
+                if (culled && !subcellsSomeVisible[i])
+                {
+                    ++result.cellsInvisible;
+                    recordLeaf(threadId, subcells[i]);
+                }
+                else if (useHorizonCulling && horizon.occludes(subcells[i].toWorldSpace(minCellSize)))
+                {
+                    subcellsOccluded[i] = true;
+                    ++result.cellsOccluded;
+                    recordLeaf(threadId, subcells[i]);
+                }
+                else
+                {
+                    ++subcellsQueued;
+                }
+            }
+
+            /* I'm about to enumerate that much of this cell's volume
+             * in subcells
+             */
+            if (subcellsQueued > 0)
+                volumeLeftToEnumerate.add(threadId, CUBE(subcells[0].coord.v[3]) * subcellsQueued);
+
+            for (unsigned int i = 0; i < subcellsCount; ++i)
+            {
+                if ((culled && !subcellsSomeVisible[i]) || subcellsOccluded[i]) continue;
+
+                bool subcellAllVisible = (allVisible || (culled && subcellsAllVisible[i]));
+
                 AFK_WorldWorkQueue::WorkItem subcellItem;
                 subcellItem.func                     = afk_generateWorldCells;
-                subcellItem.param.world.cell         = subcells[i];
-                subcellItem.param.world.flags        = (allVisible ? AFK_WCG_FLAG_ENTIRELY_VISIBLE : 0);
+                subcellItem.param.world.cell         = afk_packedCell(subcells[i]);
+                subcellItem.param.world.flags        = (subcellAllVisible ? AFK_WCG_FLAG_ENTIRELY_VISIBLE : 0);
                 subcellItem.param.world.dependency   = nullptr;
-                queue.push(subcellItem);
+                if (subcells[i].coord.v[3] <= localEnumerationScale)
+                    localStacks[threadId].items.push_back(subcellItem.param.world);
+                else
+                    queue.push(threadId, subcellItem, getCellPriority(subcells[i], threadLocal));
             }
-
-            delete[] subcells;
+        }
+        else if (display && !renderTerrain && !resume)
+        {
+            /* This is where the enumeration stops. */
+            recordLeaf(threadId, cell);
         }
     }
-
-    return retval;
 }
 
 AFK_World::AFK_World(
@@ -530,6 +1057,16 @@ AFK_World::AFK_World(
         maxDetailPitch              (settings.maxDetailPitch),
         shape                       (settings, threadAlloc, shapeCacheSize),
         entityFair2DIndex           (AFK_MAX_VAPOUR),
+        useComputeDeadline          (settings.computeDeadline),
+        useHorizonCulling           (settings.horizonCulling),
+        sphereDetailPitchTolerance  (settings.sphereDetailPitchTolerance),
+        useEmptySubtreeSkipping     (settings.emptySubtreeSkipping),
+        emptySubtreeYMargin         (settings.emptySubtreeYMargin),
+        emptySubtreeEntityDepth     (settings.emptySubtreeEntityDepth),
+        useLandscapeQuadtree        (settings.landscapeQuadtree),
+        useIncrementalEnumeration   (settings.incrementalEnumeration),
+        lastTopCell                 (afk_unassignedCell),
+        localEnumerationScale       (settings.localEnumerationScale),
         maxDistance                 (_maxDistance),
         subdivisionFactor           (settings.subdivisionFactor),
         minCellSize                 (settings.minCellSize),
@@ -538,6 +1075,32 @@ AFK_World::AFK_World(
         entitySparseness            (settings.entitySparseness)
 
 {
+    /* The packed cells and tiles that key the caches can only
+     * describe power-of-two scales.
+     */
+    if (subdivisionFactor < 2 || (subdivisionFactor & (subdivisionFactor - 1)) != 0)
+    {
+        std::ostringstream ss;
+        ss << "Subdivision factor " << subdivisionFactor << " isn't a power of two";
+        throw AFK_Exception(ss.str());
+    }
+
+    /* The block of top cells that updateWorld() enumerates reaches
+     * twice the top cell scale past the origin, and all of it has to
+     * be packable (see cell.hpp).  The top cell scale is the first
+     * power of the subdivision factor to reach maxDistance.
+     */
+    int64_t topCellScale = 1;
+    while ((float)topCellScale < maxDistance) topCellScale *= subdivisionFactor;
+    if (2 * topCellScale > AFK_PACKED_CELL_RANGE)
+    {
+        std::ostringstream ss;
+        ss << "Max distance " << maxDistance << " needs top cells of scale " << topCellScale <<
+            ", but packed cells only reach " << AFK_PACKED_CELL_RANGE << " from the origin: " <<
+            "turn zFar down";
+        throw AFK_Exception(ss.str());
+    }
+
     /* Declare the jigsaw images and decide how big things can be. */
     Vec3<int> tpSize = afk_vec3<int>((int)lSizes.tDim, (int)lSizes.tDim, 1);
     AFK_JigsawBufferUsage tBu = settings.clGlSharing ?
@@ -643,7 +1206,7 @@ AFK_World::AFK_World(
 
     landscapeCache = new AFK_LANDSCAPE_CACHE(
         8,
-        AFK_HashTile(),
+        AFK_HashPackedTile(),
         tileCacheEntries / 2,
         threadAlloc.getNewId());
 
@@ -657,7 +1220,7 @@ AFK_World::AFK_World(
 
     worldCache = new AFK_WORLD_CACHE(
         8,
-        AFK_HashCell(),
+        AFK_HashPackedCell(),
         worldCacheEntries,
         threadAlloc.getNewId());
 
@@ -665,9 +1228,14 @@ AFK_World::AFK_World(
     // in a huge mess)
     //unsigned int shapeCacheEntries = shapeCacheSize / (32 * SQUARE(sSizes.eDim) * 6 + 16 * CUBE(sSizes.tDim));
 
-    genGang = new AFK_AsyncGang<union AFK_WorldWorkParam, bool, struct AFK_WorldWorkThreadLocal, afk_worldGenerationFinishedFunc>(
-        100, threadAlloc, settings.concurrency);
-    volumeLeftToEnumerate.store(0);
+    genGang = new AFK_AsyncGang<
+        union AFK_WorldWorkParam,
+        struct AFK_WorldWorkResult,
+        struct AFK_WorldWorkThreadLocal,
+        afk_worldGenerationFinishedFunc,
+        AFK_WorldWorkReducer>(
+        100, threadAlloc, settings.concurrency, settings.workStealing,
+        settings.priorityEnumeration ? AFK_WORLD_PRIORITY_LEVELS : 1);
 
     afk_out << "AFK_World: Configuring landscape jigsaws with: " << jigsawAlloc.at(0) << std::endl;
     landscapeJigsaws = new AFK_JigsawCollection(
@@ -739,20 +1307,15 @@ AFK_World::AFK_World(
     landscape_baseColour = afk_vec3<float>(
         setupRng->frand(), setupRng->frand(), setupRng->frand());
 
-    /* Initialise the statistics. */
-    cellsInvisible.store(0);
-    cellsResumed.store(0);
-    tilesQueued.store(0);
-    tilesResumed.store(0);
-    tilesComputed.store(0);
-    tilesRecomputedAfterSweep.store(0);
-    entitiesQueued.store(0);
+    /* Initialise the statistics.  (enumerationStats starts out
+     * at zero already.)
+     */
     entitiesMoved.store(0);
-    shapeCellsInvisible.store(0);
-    shapeCellsReducedOut.store(0);
-    shapeCellsResumed.store(0);
-    shapeVapoursComputed.store(0);
-    shapeEdgesComputed.store(0);
+    enumerationsSinceCheckpoint = 0;
+    occludersSinceCheckpoint = 0;
+    fullEnumerationsSinceCheckpoint = 0;
+    seedsSinceCheckpoint = 0;
+    enumerationTimeSinceCheckpoint = afk_duration_mfl::zero();
     threadEscapes.store(0);
 }
 
@@ -797,16 +1360,60 @@ void AFK_World::enqueueSubcells(
         cell.coord.v[3]));
 
     /* Submit the volume I'm about to generate to the enumeration tracker */
-    volumeLeftToEnumerate.fetch_add(CUBE(cell.coord.v[3]));
+    volumeLeftToEnumerate.add(afk_core.masterThreadId, CUBE(cell.coord.v[3]));
 
     AFK_WorldWorkQueue::WorkItem cellItem;
     cellItem.func                        = afk_generateWorldCells;
-    cellItem.param.world.cell            = modifiedCell;
+    cellItem.param.world.cell            = afk_packedCell(modifiedCell);
     cellItem.param.world.flags           = 0;
     cellItem.param.world.dependency      = nullptr;
     (*genGang) << cellItem;
 }
 
+void AFK_World::enqueueSeed(const AFK_Cell& cell, unsigned int flags)
+{
+    volumeLeftToEnumerate.add(afk_core.masterThreadId, CUBE(cell.coord.v[3]));
+
+    AFK_WorldWorkQueue::WorkItem cellItem;
+    cellItem.func                        = afk_generateWorldCells;
+    cellItem.param.world.cell            = afk_packedCell(cell);
+    cellItem.param.world.flags           = flags;
+    cellItem.param.world.dependency      = nullptr;
+    (*genGang) << cellItem;
+}
+
+void AFK_World::enqueueTopTile(
+    const AFK_Cell& cell,
+    const Vec2<int64_t>& modifier)
+{
+    AFK_Tile tile = afk_tile(afk_vec3<int64_t>(
+        cell.coord.v[0] + cell.coord.v[3] * modifier.v[0],
+        cell.coord.v[2] + cell.coord.v[3] * modifier.v[1],
+        cell.coord.v[3]));
+
+    volumeLeftToEnumerate.add(afk_core.masterThreadId, CUBE(tile.coord.v[2]));
+
+    /* I don't know where the landscape is yet, but it won't be
+     * outside the block of top cells.
+     */
+    AFK_WorldWorkQueue::WorkItem tileItem;
+    tileItem.func                        = afk_generateLandscapeTiles;
+    tileItem.param.landscape.tile        = afk_packedTile(tile);
+    tileItem.param.landscape.yBoundLower = (float)(cell.coord.v[1] - cell.coord.v[3]) * minCellSize;
+    tileItem.param.landscape.yBoundUpper = (float)(cell.coord.v[1] + 2 * cell.coord.v[3]) * minCellSize;
+    tileItem.param.landscape.flags       = 0;
+    tileItem.param.landscape.dependency  = nullptr;
+    (*genGang) << tileItem;
+}
+
+void AFK_World::resetFrameArenas(void)
+{
+    /* Nothing made during the last enumeration is still in use
+     * now that all its work is done.
+     */
+    for (auto& arena : frameArenas) arena.reset();
+}
+
 void AFK_World::flipRenderQueues(const AFK_Frame& newFrame)
 {
     /* Verify that the concurrency control business has done
@@ -816,6 +1423,8 @@ void AFK_World::flipRenderQueues(const AFK_Frame& newFrame)
     //    threadEscapes.fetch_add(1);
     assert(genGang->noQueuedWork());
 
+    resetFrameArenas();
+
     landscapeComputeFair.flipQueues();
     landscapeDisplayFair.flipQueues();
     landscapeJigsaws->flip(newFrame);
@@ -827,6 +1436,36 @@ void AFK_World::flipRenderQueues(const AFK_Frame& newFrame)
     edgeJigsaws->flip(newFrame);
 }
 
+void AFK_World::commitRenderQueues(const AFK_Frame& newFrame)
+{
+    assert(genGang->noQueuedWork());
+
+    resetFrameArenas();
+
+    landscapeComputeFair.commitQueues();
+    landscapeDisplayFair.commitQueues();
+    landscapeJigsaws->commit(newFrame);
+
+    vapourComputeFair.commitQueues();
+    edgeComputeFair.commitQueues();
+    entityDisplayFair.commitQueues();
+    vapourJigsaws->commit(newFrame);
+    edgeJigsaws->commit(newFrame);
+}
+
+void AFK_World::promoteRenderQueues(void)
+{
+    landscapeComputeFair.promoteQueues();
+    landscapeDisplayFair.promoteQueues();
+    landscapeJigsaws->promote();
+
+    vapourComputeFair.promoteQueues();
+    edgeComputeFair.promoteQueues();
+    entityDisplayFair.promoteQueues();
+    vapourJigsaws->promote();
+    edgeJigsaws->promote();
+}
+
 #if 0
 void AFK_World::alterDetail(float adjustment)
 {
@@ -850,10 +1489,11 @@ float AFK_World::getEntityDetailPitch(float landscapeDetailPitch) const
         (float)sSizes.pointSubdivisionFactor / (float)lSizes.pointSubdivisionFactor;
 }
 
-std::future<bool> AFK_World::updateWorld(
+std::future<struct AFK_WorldWorkResult> AFK_World::updateWorld(
     const AFK_Camera& camera,
     const AFK_Object& protagonistObj,
-    float detailPitch)
+    float detailPitch,
+    const afk_clock::time_point& deadline)
 {
     /* Maintenance. */
     landscapeCache->doEvictionIfNecessary();
@@ -896,21 +1536,114 @@ std::future<bool> AFK_World::updateWorld(
         (float)cell.coord.v[3] < maxDistance;
         cell = parentCell, parentCell = cell.parent(subdivisionFactor));
 
-    /* Draw that cell and the other cells around it.
+    /* Work out what the landscape hides, from the tiles that
+     * got displayed last time.
+     */
+    if (useHorizonCulling)
+        occludersSinceCheckpoint += horizon.build(camera);
+
+    /* If I've still got the top cell I had last time, and the
+     * protagonist hasn't jumped far within it, I can start from
+     * the last enumeration's front.  (Further than that, it'd take
+     * the front a long time to coarsen up, so I may as well start
+     * again.)
+     */
+    leafSeeds.clear();
+    parentSeeds.clear();
+    ancestorSeeds.clear();
+    if (useIncrementalEnumeration &&
+        cell == lastTopCell &&
+        (protagonistLocation - lastViewerLocation).magnitude() < (float)cell.coord.v[3] * minCellSize / 16.0f)
+    {
+        /* A parent of a full set of leaves only goes back in if
+         * it's fine enough to be a leaf itself now.
+         */
+        auto parentIsLeaf = [this, &camera, &protagonistLocation, detailPitch](const AFK_Cell& parent)
+        {
+            AFK_VisibleCell visibleParent;
+            visibleParent.bindToCell(parent, minCellSize);
+            return visibleParent.testDetailPitch(detailPitch, camera, protagonistLocation, sphereDetailPitchTolerance);
+        };
+
+        front.gatherSeeds(subdivisionFactor, cell.coord.v[3], parentIsLeaf, leafSeeds, parentSeeds, ancestorSeeds);
+    }
+    else
+    {
+        front.clear();
+    }
+
+    /* Everything I'm about to enumerate is in the block of top
+     * cells around this one, and has to be packable; checking the
+     * two corner top cells covers the lot, because afk_isPackable()
+     * takes the whole extent of the cell into account.  If it's not,
+     * the protagonist has wandered out of range of the packing
+     * origin (see cell.hpp).
+     */
+    if (!afk_isPackable(afk_cell(afk_vec4<int64_t>(
+            cell.coord.v[0] - cell.coord.v[3],
+            cell.coord.v[1] - cell.coord.v[3],
+            cell.coord.v[2] - cell.coord.v[3],
+            cell.coord.v[3]))) ||
+        !afk_isPackable(afk_cell(afk_vec4<int64_t>(
+            cell.coord.v[0] + cell.coord.v[3],
+            cell.coord.v[1] + cell.coord.v[3],
+            cell.coord.v[2] + cell.coord.v[3],
+            cell.coord.v[3]))))
+    {
+        std::ostringstream ss;
+        ss << "Top cell " << cell << " is out of range of the packing origin " << afk_packedCellOrigin;
+        throw AFK_Exception(ss.str());
+    }
+
+    lastTopCell = cell;
+    lastViewerLocation = protagonistLocation;
+
+    if (leafSeeds.empty() && parentSeeds.empty())
+    {
+        /* Draw that cell and the other cells around it.
+         */
+        for (int64_t i = -1; i <= 1; ++i)
+            for (int64_t j = -1; j <= 1; ++j)
+                for (int64_t k = -1; k <= 1; ++k)
+                    enqueueSubcells(cell, afk_vec3<int64_t>(i, j, k));
+
+        ++fullEnumerationsSinceCheckpoint;
+    }
+    else
+    {
+        for (auto seed : leafSeeds) enqueueSeed(seed, AFK_WCG_FLAG_FRONT);
+        for (auto seed : parentSeeds) enqueueSeed(seed, 0);
+        for (auto seed : ancestorSeeds) enqueueSeed(seed, AFK_WCG_FLAG_ENTITIES_ONLY);
+        seedsSinceCheckpoint += (leafSeeds.size() + parentSeeds.size());
+    }
+
+    /* The landscape quadtree always starts from the top: there's
+     * a lot less of it.
      */
-    for (int64_t i = -1; i <= 1; ++i)
-        for (int64_t j = -1; j <= 1; ++j)
+    if (useLandscapeQuadtree)
+    {
+        for (int64_t i = -1; i <= 1; ++i)
             for (int64_t k = -1; k <= 1; ++k)
-                enqueueSubcells(cell, afk_vec3<int64_t>(i, j, k));
+                enqueueTopTile(cell, afk_vec2<int64_t>(i, k));
+    }
 
     struct AFK_WorldWorkThreadLocal threadLocal;
     threadLocal.camera = camera;
     threadLocal.viewerLocation = protagonistLocation;
     threadLocal.detailPitch = detailPitch;
+    threadLocal.deadline = (useComputeDeadline ? deadline : afk_clock::time_point::max());
 
+    enumerationStarted = afk_clock::now();
     return genGang->start(threadLocal);
 }
 
+void AFK_World::enumerationFinished(const struct AFK_WorldWorkResult& result)
+{
+    enumerationStats += result;
+    ++enumerationsSinceCheckpoint;
+    enumerationTimeSinceCheckpoint += std::chrono::duration_cast<afk_duration_mfl>(afk_clock::now() - enumerationStarted);
+}
+
 void AFK_World::doComputeTasks(unsigned int threadId)
 {
     /* The fair organises the terrain lists and jigsaw pieces by
@@ -926,21 +1659,26 @@ void AFK_World::doComputeTasks(unsigned int threadId)
      * directly interdicting the jigsaws from the update threads, the queue
      * flip is doing that.  This is more of a make-sure.)
      */
+    AFK_TRACE_BEGIN(threadId, "terrainComputeStart")
     for (unsigned int puzzle = 0; puzzle < terrainComputeQueues.size(); ++puzzle)
     {
         terrainComputeQueues.at(puzzle)->computeStart(afk_core.computer, landscapeJigsaws->getPuzzle(puzzle), lSizes, landscape_baseColour);
     }
+    AFK_TRACE_END(threadId, "terrainComputeStart")
 
 #if AFK_RENDER_ENTITIES
     std::vector<std::shared_ptr<AFK_3DVapourComputeQueue> > vapourComputeQueues;
     vapourComputeFair.getDrawQueues(vapourComputeQueues);
     assert(vapourComputeQueues.size() <= 1);
+    AFK_TRACE_BEGIN(threadId, "vapourComputeStart")
     if (vapourComputeQueues.size() == 1)
         vapourComputeQueues.at(0)->computeStart(afk_core.computer, vapourJigsaws, sSizes);
+    AFK_TRACE_END(threadId, "vapourComputeStart")
 
     std::vector<std::shared_ptr<AFK_3DEdgeComputeQueue> > edgeComputeQueues;
     edgeComputeFair.getDrawQueues(edgeComputeQueues);
 
+    AFK_TRACE_BEGIN(threadId, "edgeComputeStart")
     for (unsigned int i = 0; i < edgeComputeQueues.size(); ++i)
     {
         unsigned int vapourPuzzle, edgePuzzle;
@@ -956,21 +1694,27 @@ void AFK_World::doComputeTasks(unsigned int threadId)
                 sSizes);
         }
     }
+    AFK_TRACE_END(threadId, "edgeComputeStart")
 #endif
 
     /* If I finalise stuff now, the y-reduce information will
      * be in the landscape tiles in time for the display
      * to edit out any cells I now know to be empty of terrain.
      */
+    AFK_TRACE_BEGIN(threadId, "terrainComputeFinish")
     for (unsigned int puzzle = 0; puzzle < terrainComputeQueues.size(); ++puzzle)
     {
         terrainComputeQueues.at(puzzle)->computeFinish(threadId, landscapeJigsaws->getPuzzle(puzzle), landscapeCache);
     }
+    AFK_TRACE_END(threadId, "terrainComputeFinish")
 
 #if AFK_RENDER_ENTITIES
+    AFK_TRACE_BEGIN(threadId, "vapourComputeFinish")
     if (vapourComputeQueues.size() == 1)
         vapourComputeQueues.at(0)->computeFinish(threadId, vapourJigsaws, shape.shapeCellCache);
+    AFK_TRACE_END(threadId, "vapourComputeFinish")
 
+    AFK_TRACE_BEGIN(threadId, "edgeComputeFinish")
     for (unsigned int i = 0; i < edgeComputeQueues.size(); ++i)
     {
         unsigned int vapourPuzzle, edgePuzzle;
@@ -984,6 +1728,7 @@ void AFK_World::doComputeTasks(unsigned int threadId)
                 edgeJigsaw);
         }
     }
+    AFK_TRACE_END(threadId, "edgeComputeFinish")
 #endif
 }
 
@@ -1070,28 +1815,82 @@ static float toRatePerSecond(uint64_t quantity, const afk_duration_mfl& interval
 }
 
 #define PRINT_RATE_AND_RESET(s, v) afk_out << s << toRatePerSecond((v).exchange(0), timeSinceLastCheckpoint) << "/second" << std::endl;
+#define PRINT_ENUMERATION_RATE(s, v) afk_out << s << toRatePerSecond(enumerationStats.v, timeSinceLastCheckpoint) << "/second" << std::endl;
 #endif
 
 void AFK_World::checkpoint(afk_duration_mfl& timeSinceLastCheckpoint)
 {
 #if PRINT_CHECKPOINTS
-    PRINT_RATE_AND_RESET("Cells found invisible:        ", cellsInvisible)
-    PRINT_RATE_AND_RESET("Cells resumed:                ", cellsResumed)
-    PRINT_RATE_AND_RESET("Tiles queued:                 ", tilesQueued)
-    PRINT_RATE_AND_RESET("Tiles resumed:                ", tilesResumed)
-    PRINT_RATE_AND_RESET("Tiles computed:               ", tilesComputed)
-    PRINT_RATE_AND_RESET("Tiles recomputed after sweep: ", tilesRecomputedAfterSweep)
+    if (useIncrementalEnumeration)
+    {
+        float enumerations = (float)std::max<uint64_t>(enumerationsSinceCheckpoint, 1);
+        afk_out <<         "Full enumerations:            " << fullEnumerationsSinceCheckpoint << " of " << enumerationsSinceCheckpoint << std::endl;
+        afk_out <<         "Front seeds:                  " << (float)seedsSinceCheckpoint / enumerations << "/frame" << std::endl;
+        afk_out <<         "Cells enumerated:             " << (float)enumerationStats.cellsEnumerated / enumerations << "/frame" << std::endl;
+    }
+    PRINT_ENUMERATION_RATE("Cells enumerated locally:     ", cellsEnumeratedLocally)
+    {
+        float enumerations = (float)std::max<uint64_t>(enumerationsSinceCheckpoint, 1);
+        afk_out <<         "Enumeration time:             " << enumerationTimeSinceCheckpoint.count() / enumerations << " millis/frame" << std::endl;
+        if (useLandscapeQuadtree)
+            afk_out <<     "Tiles enumerated:             " << (float)enumerationStats.tilesEnumerated / enumerations << "/frame" << std::endl;
+        afk_out <<         "Tile claim failures:          " << (float)enumerationStats.tileClaimFailures / enumerations << "/frame" << std::endl;
+    }
+    {
+        uint64_t arenaAllocations = 0, arenaHeapAllocations = 0;
+        for (auto& arena : frameArenas) arena.getStatsAndReset(arenaAllocations, arenaHeapAllocations);
+        float enumerations = (float)std::max<uint64_t>(enumerationsSinceCheckpoint, 1);
+        afk_out <<         "Frame arena allocations:      " << (float)arenaAllocations / enumerations << "/frame (" << (float)arenaHeapAllocations / enumerations << "/frame from the heap)" << std::endl;
+    }
+    PRINT_ENUMERATION_RATE("Cells found invisible:        ", cellsInvisible)
+    if (useHorizonCulling)
+    {
+        float enumerations = (float)std::max<uint64_t>(enumerationsSinceCheckpoint, 1);
+        afk_out <<         "Cells occluded by landscape:  " << (float)enumerationStats.cellsOccluded / enumerations << "/frame" << std::endl;
+        afk_out <<         "Landscape occluders:          " << (float)occludersSinceCheckpoint / enumerations << "/frame" << std::endl;
+    }
+    if (useEmptySubtreeSkipping)
+    {
+        float enumerations = (float)std::max<uint64_t>(enumerationsSinceCheckpoint, 1);
+        afk_out <<         "Empty subtrees skipped:       " << (float)enumerationStats.subtreesSkippedEmpty / enumerations << "/frame" << std::endl;
+    }
+    PRINT_ENUMERATION_RATE("Cells resumed:                ", cellsResumed)
+    PRINT_ENUMERATION_RATE("Cells parked on a claim:      ", cellsParked)
+    PRINT_ENUMERATION_RATE("Cells cut off by deadline:    ", cellsCutOffByDeadline)
+    PRINT_ENUMERATION_RATE("Tiles queued:                 ", tilesQueued)
+    PRINT_ENUMERATION_RATE("Tiles resumed:                ", tilesResumed)
+    PRINT_ENUMERATION_RATE("Tiles parked on a claim:      ", tilesParked)
+    PRINT_ENUMERATION_RATE("Tiles computed:               ", tilesComputed)
+    PRINT_ENUMERATION_RATE("Tiles recomputed after sweep: ", tilesRecomputedAfterSweep)
 #if AFK_RENDER_ENTITIES
-    PRINT_RATE_AND_RESET("Entities queued:              ", entitiesQueued)
+    PRINT_ENUMERATION_RATE("Entities queued:              ", entitiesQueued)
     PRINT_RATE_AND_RESET("Entities moved:               ", entitiesMoved)
-    PRINT_RATE_AND_RESET("Shape cells found invisible:  ", shapeCellsInvisible)
-    PRINT_RATE_AND_RESET("Shape cells reduced out:      ", shapeCellsReducedOut)
-    PRINT_RATE_AND_RESET("Shape cells resumed:          ", shapeCellsResumed)
-    PRINT_RATE_AND_RESET("Shape vapours computed:       ", shapeVapoursComputed)
-    PRINT_RATE_AND_RESET("Shape edges computed:         ", shapeEdgesComputed)
-    PRINT_RATE_AND_RESET("Separate vapours computed:    ", separateVapoursComputed)
+    PRINT_ENUMERATION_RATE("Shape cells found invisible:  ", shapeCellsInvisible)
+    PRINT_ENUMERATION_RATE("Shape cells reduced out:      ", shapeCellsReducedOut)
+    PRINT_ENUMERATION_RATE("Shape cells resumed:          ", shapeCellsResumed)
+    PRINT_ENUMERATION_RATE("Shape vapours computed:       ", shapeVapoursComputed)
+    PRINT_ENUMERATION_RATE("Shape edges computed:         ", shapeEdgesComputed)
+    PRINT_ENUMERATION_RATE("Separate vapours computed:    ", separateVapoursComputed)
 #endif /* AFK_RENDER_ENTITIES */
-    PRINT_RATE_AND_RESET("Dependencies followed:        ", dependenciesFollowed)
+    PRINT_ENUMERATION_RATE("Dependencies followed:        ", dependenciesFollowed)
+    uint64_t dependenciesFresh, dependenciesRecycled;
+    dependencyPool.getStats(dependenciesFresh, dependenciesRecycled);
+    afk_out <<         "Dependencies allocated:       " << toRatePerSecond(dependenciesFresh, timeSinceLastCheckpoint) << "/second" << std::endl;
+    afk_out <<         "Dependencies recycled:        " << toRatePerSecond(dependenciesRecycled, timeSinceLastCheckpoint) << "/second" << std::endl;
+    uint64_t claimParks, claimWakes;
+    afk_claimWaiters.getStats(claimParks, claimWakes);
+    afk_out <<         "Parked work woken:            " << toRatePerSecond(claimWakes, timeSinceLastCheckpoint) << "/second" << std::endl;
+    afk_out <<         "Entity blocks in use:         " << entityStore.getBlocksInUse() << " (" << entityStore.getBytesAllocated() / 1024 << " KB allocated)" << std::endl;
+    enumerationStats = AFK_WorldWorkResult();
+    enumerationsSinceCheckpoint = 0;
+    occludersSinceCheckpoint = 0;
+    fullEnumerationsSinceCheckpoint = 0;
+    seedsSinceCheckpoint = 0;
+    enumerationTimeSinceCheckpoint = afk_duration_mfl::zero();
+    afk_out <<         "Worker idle spinning:         " << toRatePerSecond(
+        genGang->getIdleStats().getSpinNanosAndReset(), timeSinceLastCheckpoint) / 1000000.0f << " millis/second" << std::endl;
+    afk_out <<         "Worker parks:                 " << toRatePerSecond(
+        genGang->getIdleStats().getParksAndReset(), timeSinceLastCheckpoint) << "/second" << std::endl;
     afk_out <<         "Cumulative thread escapes:    " << threadEscapes.load() << std::endl;
 #endif
 }
@@ -29,6 +29,7 @@
 #include "3d_edge_shape_base.hpp"
 #include "3d_vapour_compute_queue.hpp"
 #include "async/async.hpp"
+#include "async/termination_counter.hpp"
 #include "async/work_queue.hpp"
 #include "camera.hpp"
 #include "cell.hpp"
@@ -38,10 +39,13 @@
 #include "data/evictable_cache.hpp"
 #include "data/fair.hpp"
 #include "data/moving_average.hpp"
+#include "data/recycling_pool.hpp"
 #include "data/stage_timer.hpp"
 #include "def.hpp"
 #include "entity.hpp"
 #include "entity_display_queue.hpp"
+#include "entity_store.hpp"
+#include "horizon_buffer.hpp"
 #include "jigsaw_collection.hpp"
 #include "landscape_display_queue.hpp"
 #include "landscape_tile.hpp"
@@ -54,6 +58,7 @@
 #include "ui/config_settings.hpp"
 #include "work.hpp"
 #include "world_cell.hpp"
+#include "world_front.hpp"
 
 /* The world of AFK. */
 
@@ -63,7 +68,16 @@ class AFK_WorldCell;
 
 
 /* This is the cell generating worker function */
-bool afk_generateWorldCells(
+struct AFK_WorldWorkResult afk_generateWorldCells(
+    unsigned int threadId,
+    const union AFK_WorldWorkParam& param,
+    const struct AFK_WorldWorkThreadLocal& threadLocal,
+    AFK_WorldWorkQueue& queue);
+
+/* ...and this one does the landscape tiles, when they're enumerated
+ * by themselves.
+ */
+struct AFK_WorldWorkResult afk_generateLandscapeTiles(
     unsigned int threadId,
     const union AFK_WorldWorkParam& param,
     const struct AFK_WorldWorkThreadLocal& threadLocal,
@@ -94,33 +108,70 @@ protected:
     const float maxDetailPitch;
 
     /* This is my means of tracking whether the current world (and shape)
-     * enumeration is finished or not.
+     * enumeration is finished or not.  Every work item adds the volume
+     * it queues and takes off its own, each thread on its own counter
+     * (see async/termination_counter.hpp).
+     */
+    AFK_TerminationCounter volumeLeftToEnumerate;
+
+    /* Work dependencies come out of here, and go back when
+     * they've been followed.  (World and shape workers alike.)
      */
-    boost::atomic_uint_fast64_t volumeLeftToEnumerate;
+    AFK_RecyclingPool<AFK_WorldWorkParam::Dependency> dependencyPool;
+
+    /* ...and likewise, work items parked on a busy claimable. */
+    AFK_RecyclingPool<AFK_WorldParkedWork> parkedWorkPool;
+
+    /* Parks a resume item on the cache entry it failed to claim
+     * with these flags, so that it goes back on the queue when
+     * that's released.  Returns false if it couldn't (the entry
+     * isn't there, or is already free again), in which case push it
+     * yourself.
+     */
+    template<typename EvictableValue>
+    bool parkResume(
+        unsigned int threadId,
+        EvictableValue *value,
+        unsigned int claimFlags,
+        const AFK_WorldWorkQueue::WorkItem& resumeItem,
+        AFK_WorldWorkQueue& queue)
+    {
+        if (!value) return false;
+
+        AFK_WorldParkedWork *parked = parkedWorkPool.alloc(threadId, resumeItem, queue);
+        if (value->claimable.park(claimFlags, wakeParkedWork, parked)) return true;
+
+        parkedWorkPool.free(threadId, parked);
+        return false;
+    }
+
+    /* The claim waiter function for the above. */
+    static void wakeParkedWork(unsigned int threadId, void *context);
 
     /* Gather statistics.  (Useful.)
+     * The enumeration ones come back from the gang at the end of
+     * each frame's enumeration (see enumerationFinished()), and are
+     * only touched by the main thread.
      */
-    boost::atomic_uint_fast64_t cellsInvisible;
-    boost::atomic_uint_fast64_t cellsResumed;
-    boost::atomic_uint_fast64_t tilesQueued;
-    boost::atomic_uint_fast64_t tilesResumed;
-    boost::atomic_uint_fast64_t tilesComputed;
-    boost::atomic_uint_fast64_t tilesRecomputedAfterSweep;
-    boost::atomic_uint_fast64_t entitiesQueued;
+    struct AFK_WorldWorkResult enumerationStats;
     boost::atomic_uint_fast64_t entitiesMoved;
 
-    /* These ones are updated by the shape worker. */
-    boost::atomic_uint_fast64_t shapeCellsInvisible;
-    boost::atomic_uint_fast64_t shapeCellsReducedOut;
-    boost::atomic_uint_fast64_t shapeCellsResumed;
-    boost::atomic_uint_fast64_t shapeVapoursComputed;
-    boost::atomic_uint_fast64_t shapeEdgesComputed;
-
-    /* ... and this by that little vapour descriptor worker */
-    boost::atomic_uint_fast64_t separateVapoursComputed;
+    /* ...and these are counted by the main thread between
+     * checkpoints, for the per-frame figures.
+     */
+    uint64_t enumerationsSinceCheckpoint;
+    uint64_t occludersSinceCheckpoint;
+    uint64_t fullEnumerationsSinceCheckpoint;
+    uint64_t seedsSinceCheckpoint;
+
+    /* Roughly how long the enumerations are taking: from
+     * updateWorld() to enumerationFinished(), so it includes however
+     * long the main thread took to notice.
+     */
+    afk_clock::time_point enumerationStarted;
+    afk_duration_mfl enumerationTimeSinceCheckpoint;
 
     /* Concurrency stats */
-    boost::atomic_uint_fast64_t dependenciesFollowed;
     boost::atomic_uint_fast64_t threadEscapes;
 
     /* Landscape shader details. */
@@ -143,6 +194,9 @@ protected:
      */
     AFK_WORLD_CACHE *worldCache;
 
+    /* The entities homed to those cells (see entity_store.hpp). */
+    AFK_EntityStore entityStore;
+
     /* These jigsaws form the computed landscape artwork. */
     AFK_JigsawCollection *landscapeJigsaws;
 
@@ -200,11 +254,114 @@ protected:
     GLuint edgeShapeBaseArray;
     AFK_3DEdgeShapeBase *edgeShapeBase;
 
-    /* The cell generating gang */
-    AFK_AsyncGang<union AFK_WorldWorkParam, bool, struct AFK_WorldWorkThreadLocal, afk_worldGenerationFinishedFunc> *genGang;
+    /* The cell generating gang.  If it's got more than one
+     * priority level, subcells are queued coarsest (or biggest
+     * looking) first, so that if the frame runs out of time it's
+     * the finest detail that gets left out.
+     */
+#define AFK_WORLD_PRIORITY_LEVELS 16
+    AFK_AsyncGang<
+        union AFK_WorldWorkParam,
+        struct AFK_WorldWorkResult,
+        struct AFK_WorldWorkThreadLocal,
+        afk_worldGenerationFinishedFunc,
+        AFK_WorldWorkReducer> *genGang;
+
+    /* Whether to give the workers a deadline for the
+     * enumeration (see updateWorld()).
+     */
+    const bool useComputeDeadline;
+
+    /* Whether to skip the cells hidden behind the landscape, and
+     * the buffer that tells me which ones those are.  During an
+     * enumeration the workers test cells against the depths, which
+     * stay put, and append the landscape tiles they display to
+     * their own per-thread occluder lists.  Before the next
+     * enumeration the main thread's build() rasterises those lists
+     * into the depths and empties them.
+     */
+    const bool useHorizonCulling;
+    AFK_HorizonBuffer horizon;
+
+    /* For AFK_VisibleCell::testDetailPitch(). */
+    const float sphereDetailPitchTolerance;
+
+    /* For AFK_WorldCell::testSubtreeEmpty(): whether to stop at
+     * the cells with nothing under them.
+     */
+    const bool useEmptySubtreeSkipping;
+    const float emptySubtreeYMargin;
+    const unsigned int emptySubtreeEntityDepth;
+
+    /* Whether the landscape gets its own quadtree of tiles (see
+     * generateLandscapeQuad()), rather than being done by the world
+     * cells as they go.  In that case the world cells only see to
+     * the entities.
+     */
+    const bool useLandscapeQuadtree;
+
+    /* Whether to start each enumeration from the last one's front
+     * (see world_front.hpp) when the camera hasn't gone far, and
+     * the front itself.  The rest of this is the main thread's, for
+     * deciding that.
+     */
+    const bool useIncrementalEnumeration;
+    AFK_WorldFront front;
+    AFK_Cell lastTopCell;
+    Vec3<float> lastViewerLocation;
+    std::vector<AFK_Cell> leafSeeds;
+    std::vector<AFK_Cell> parentSeeds;
+    std::vector<AFK_Cell> ancestorSeeds;
+
+    void recordLeaf(unsigned int threadId, const AFK_Cell& cell)
+    {
+        if (useIncrementalEnumeration) front.addLeaf(threadId, cell);
+    }
+
+    /* Cells this small (in units of minCellSize), I don't put back
+     * on the queue: the worker that made them does them straight
+     * away, depth first, off its own stack here.  The queue only
+     * needs the bigger cells to keep the workers evenly loaded, and
+     * it saves a push and a pop for most of the cells in the world.
+     * (0 to queue everything.)
+     */
+    const int64_t localEnumerationScale;
+
+    struct LocalStack
+    {
+        std::vector<struct AFK_WorldWorkParam::World> items;
+        char pad[64];
+    };
+
+    LocalStack localStacks[AFK_MAX_THREADS];
+
+    /* Each thread's arena for the temporaries it makes while
+     * enumerating (see data/frame_arena.hpp).  They're reset
+     * together when the enumeration's done, by resetFrameArenas().
+     */
+    AFK_FrameArena frameArenas[AFK_MAX_THREADS];
+    void resetFrameArenas(void);
 
     /* Cell generation worker delegates. */
 
+    /* Works out which priority level to queue a cell at:
+     * 0 for the biggest looking, down to the lowest level for
+     * cells that are nearly fine enough to display.
+     */
+    unsigned int getCellPriority(
+        const AFK_Cell& cell,
+        const struct AFK_WorldWorkThreadLocal& threadLocal) const;
+
+    /* Checks whether a cell from the last front has gone out of
+     * sight, in which case it stays a leaf and there's nothing
+     * else to do with it.
+     */
+    bool frontCellIsHidden(
+        unsigned int threadId,
+        const AFK_Cell& cell,
+        const struct AFK_WorldWorkThreadLocal& threadLocal,
+        struct AFK_WorldWorkResult& result);
+
     /* Makes sure a landscape tile has a terrain descriptor,
      * and checks if its geometry needs generating.
      * Returns true if this thread is to generate the tile's
@@ -213,7 +370,8 @@ protected:
     bool checkClaimedLandscapeTile(
         const AFK_Tile& tile,
         AFK_LandscapeTile& landscapeTile,
-        bool display);
+        bool display,
+        struct AFK_WorldWorkResult& result);
 
     /* Generates a landscape tile's geometry.
      * Returns true if we found missing tiles and you need to
@@ -223,14 +381,69 @@ protected:
         const AFK_Tile& tile,
         AFK_LandscapeTile& landscapeTile,
         unsigned int threadId,
-        std::vector<AFK_Tile>& missingTiles);
+        AFK_FramePackedTileVector& missingTiles,
+        struct AFK_WorldWorkResult& result);
 
     /* Pushes a landscape tile into the display queue. */
     void displayLandscapeTile(
         const AFK_Cell& cell,
         const AFK_Tile& tile,
         const AFK_LandscapeTile& landscapeTile,
-        unsigned int threadId);
+        unsigned int threadId,
+        struct AFK_WorldWorkResult& result);
+
+    /* Does everything a landscape tile needs: a terrain descriptor,
+     * and artwork if it's to be displayed (in each of the
+     * `displayCellsCount' cells) or rendered for its descendants'
+     * sake.  If it can't finish now, it arranges for `resumeItem' to
+     * be re-run later (retaining `dependency' for it).
+     * Fills out the tile's y-bounds, if it's got them yet.
+     */
+    void generateLandscapeTile(
+        unsigned int threadId,
+        const AFK_Tile& tile,
+        const AFK_Cell *displayCells,
+        unsigned int displayCellsCount,
+        bool renderTerrain,
+        const AFK_WorldWorkQueue::WorkItem& resumeItem,
+        int64_t resumeVolume,
+        AFK_WorldWorkParam::Dependency *dependency,
+        AFK_WorldWorkQueue& queue,
+        float& o_yBoundLower,
+        float& o_yBoundUpper,
+        struct AFK_WorldWorkResult& result);
+
+    /* Reads a landscape tile's y-bounds without waiting for it
+     * or making it.  Returns false if it couldn't (in which case
+     * the bounds are left alone).
+     */
+    bool peekLandscapeYBounds(
+        unsigned int threadId,
+        const AFK_Tile& tile,
+        float& o_yBoundLower,
+        float& o_yBoundUpper);
+
+    /* Enumerates one landscape tile of the quadtree: displays it
+     * if it's fine enough, else queues the smaller tiles under it.
+     */
+    void generateLandscapeQuad(
+        unsigned int threadId,
+        const struct AFK_WorldWorkParam::Landscape& param,
+        const struct AFK_WorldWorkThreadLocal& threadLocal,
+        AFK_WorldWorkQueue& queue,
+        struct AFK_WorldWorkResult& result);
+
+    /* Gives a world cell its starting entities, if it's above
+     * the landscape and hasn't got them yet, and queues all its
+     * entities for this frame.
+     */
+    void generateCellEntities(
+        unsigned int threadId,
+        const AFK_Cell& cell,
+        AFK_WorldCell& worldCell,
+        float landscapeUpperYBound,
+        AFK_WorldWorkQueue& queue,
+        struct AFK_WorldWorkResult& result);
 
     /* Makes one starting entity for a world cell, including generating
      * the shape as required.
@@ -241,13 +454,16 @@ protected:
         unsigned int threadId,
         AFK_RNG& rng);
 
-    /* Generates this world cell, as necessary. */
-    bool generateClaimedWorldCell(
+    /* Generates this world cell, as necessary, counting what
+     * it did in `result'.
+     */
+    void generateClaimedWorldCell(
         AFK_WORLD_CACHE::Claim& claim,
         unsigned int threadId,
         const struct AFK_WorldWorkParam::World& param,
         const struct AFK_WorldWorkThreadLocal& threadLocal,
-        AFK_WorldWorkQueue& queue);
+        AFK_WorldWorkQueue& queue,
+        struct AFK_WorldWorkResult& result);
 
 public:
     /* Overall world parameters. */
@@ -300,9 +516,27 @@ public:
         const AFK_Cell& cell,
         const Vec3<int64_t>& modifier);
 
+    /* ...and this one requests a cell from the last front. */
+    void enqueueSeed(const AFK_Cell& cell, unsigned int flags);
+
+    /* ...and this one requests the top landscape tile under
+     * this cell, at an offset like enqueueSubcells()'s.
+     */
+    void enqueueTopTile(
+        const AFK_Cell& cell,
+        const Vec2<int64_t>& modifier);
+
     /* Call when we're about to start a new frame. */
     void flipRenderQueues(const AFK_Frame& newFrame);
 
+    /* When pipelining, call commitRenderQueues() instead when an
+     * update finishes (before starting the next one), and
+     * promoteRenderQueues() when the committed frame is about to
+     * be drawn; the next update can be in progress by then.
+     */
+    void commitRenderQueues(const AFK_Frame& newFrame);
+    void promoteRenderQueues(void);
+
     /* TODO: I'm moving the detail pitch calculation out to the
      * DetailAdjuster object ...
      */
@@ -324,9 +558,19 @@ public:
      * update the world cache and enqueue visible
      * cells.  Returns a future that becomes available
      * when we're done.
+     * Cells still being enumerated after `deadline' are
+     * displayed at whatever level of detail they've got to.
+     */
+    std::future<struct AFK_WorldWorkResult> updateWorld(
+        const AFK_Camera& camera,
+        const AFK_Object& protagonistObj,
+        float detailPitch,
+        const afk_clock::time_point& deadline);
+
+    /* Call with the result of updateWorld() once it's come
+     * in, to gather up the enumeration statistics.
      */
-    std::future<bool> updateWorld(
-        const AFK_Camera& camera, const AFK_Object& protagonistObj, float detailPitch);
+    void enumerationFinished(const struct AFK_WorldWorkResult& result);
 
     /* CL-tasks-at-start-of-frame function. */
     void doComputeTasks(unsigned int threadId);
@@ -347,20 +591,34 @@ public:
     void printJigsawStats(std::ostream& ss, const std::string& prefix);
 
     friend class AFK_Shape;
+    friend class AFK_WorldCell;
 
-    friend bool afk_generateEntity(
+    friend struct AFK_WorldWorkResult afk_generateEntity(
         unsigned int threadId,
         const union AFK_WorldWorkParam& param,
         const struct AFK_WorldWorkThreadLocal& threadLocal,
         AFK_WorldWorkQueue& queue);
 
-    friend bool afk_generateShapeCells(
+    friend struct AFK_WorldWorkResult afk_generateShapeCells(
+        unsigned int threadId,
+        const union AFK_WorldWorkParam& param,
+        const struct AFK_WorldWorkThreadLocal& threadLocal,
+        AFK_WorldWorkQueue& queue);
+
+    friend void afk_generateWorldCell(
+        unsigned int threadId,
+        const struct AFK_WorldWorkParam::World& param,
+        const struct AFK_WorldWorkThreadLocal& threadLocal,
+        AFK_WorldWorkQueue& queue,
+        struct AFK_WorldWorkResult& result);
+
+    friend struct AFK_WorldWorkResult afk_generateWorldCells(
         unsigned int threadId,
         const union AFK_WorldWorkParam& param,
         const struct AFK_WorldWorkThreadLocal& threadLocal,
         AFK_WorldWorkQueue& queue);
 
-    friend bool afk_generateWorldCells(
+    friend struct AFK_WorldWorkResult afk_generateLandscapeTiles(
         unsigned int threadId,
         const union AFK_WorldWorkParam& param,
         const struct AFK_WorldWorkThreadLocal& threadLocal,
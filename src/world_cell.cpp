@@ -19,20 +19,68 @@
 
 #include <cassert>
 #include <cmath>
+#include <limits>
 
 #include "core.hpp"
 #include "exception.hpp"
+#include "rng/boost_taus88.hpp"
+#include "world.hpp"
 #include "world_cell.hpp"
 
 
 AFK_WorldCell::AFK_WorldCell():
-    entityCount(-1), entityAddI(0)
+    entityBlock(AFK_ENTITY_BLOCK_NONE), entityCount(-1), entityAddI(0),
+    entitiesUnder(-1), subtreeEmpty(false),
+    subtreeYBoundLower(std::numeric_limits<float>::quiet_NaN()),
+    subtreeYBoundUpper(std::numeric_limits<float>::quiet_NaN())
 {
 }
 
+int AFK_WorldCell::rollStartingEntities(AFK_RNG& rng, float realScale, unsigned int entitySparseness)
+{
+    /* I want more entities in larger cells */
+    float sparseMult = log(realScale);
+
+    int count = 0;
+    for (unsigned int entitySlot = 0; entitySlot < maxEntityCount; ++entitySlot)
+    {
+        if (rng.frand() < (sparseMult / ((float)entitySparseness)))
+            ++count;
+    }
+
+    return count;
+}
+
+bool AFK_WorldCell::noEntitiesUnder(
+    const AFK_Cell& cell,
+    float worldScale,
+    unsigned int subdivisionFactor,
+    unsigned int entitySparseness)
+{
+    /* The enumeration never subdivides the smallest cells (see
+     * AFK_World::generateClaimedWorldCell()).
+     */
+    if (cell.coord.v[3] <= 2) return true;
+
+    AFK_Cell subcells[CUBE(AFK_MAX_BATCH_SUBDIVISION_FACTOR)];
+    unsigned int subcellsCount = cell.subdivide(subcells, CUBE(subdivisionFactor), subdivisionFactor);
+    for (unsigned int i = 0; i < subcellsCount; ++i)
+    {
+        AFK_Boost_Taus88_RNG staticRng;
+        staticRng.seed(subcells[i].rngSeed());
+        if (rollStartingEntities(staticRng, (float)subcells[i].coord.v[3] * worldScale, entitySparseness) > 0)
+            return false;
+
+        if (!noEntitiesUnder(subcells[i], worldScale, subdivisionFactor, entitySparseness))
+            return false;
+    }
+
+    return true;
+}
+
 AFK_WorldCell::~AFK_WorldCell()
 {
-    evict();
+    /* Not evict(): I might just be a claim's copy. */
 }
 
 Vec4<float> AFK_WorldCell::getRealCoord(void) const
@@ -51,9 +99,49 @@ void AFK_WorldCell::bind(const AFK_Cell& cell, float _worldScale)
 bool AFK_WorldCell::testDetailPitch(
     float detailPitch,
     const AFK_Camera& camera,
-    const Vec3<float>& viewerLocation) const
+    const Vec3<float>& viewerLocation,
+    float sphereTolerance) const
 {
-    return visibleCell.testDetailPitch(detailPitch, camera, viewerLocation);
+    return visibleCell.testDetailPitch(detailPitch, camera, viewerLocation, sphereTolerance);
+}
+
+bool AFK_WorldCell::testSubtreeEmpty(
+    const AFK_Cell& cell,
+    float worldScale,
+    float yBoundLower,
+    float yBoundUpper,
+    float yMargin,
+    unsigned int subdivisionFactor,
+    unsigned int entitySparseness,
+    unsigned int entityDepth)
+{
+    if (entitiesUnder == -1)
+    {
+        /* Only if it's close enough to the bottom, and the subcells
+         * will fit in my array.
+         */
+        unsigned int depth = 0;
+        for (int64_t scale = cell.coord.v[3]; scale > 2; scale /= subdivisionFactor) ++depth;
+
+        if (depth <= entityDepth && subdivisionFactor <= AFK_MAX_BATCH_SUBDIVISION_FACTOR)
+            entitiesUnder = noEntitiesUnder(cell, worldScale, subdivisionFactor, entitySparseness) ? 1 : 0;
+        else
+            entitiesUnder = 0;
+    }
+
+    if (yBoundLower != subtreeYBoundLower || yBoundUpper != subtreeYBoundUpper)
+    {
+        Vec4<float> realCoord = getRealCoord();
+        float margin = yMargin * realCoord.v[3];
+        bool below = (realCoord.v[1] + realCoord.v[3] <= yBoundLower - margin);
+        bool above = (realCoord.v[1] >= yBoundUpper + margin);
+
+        subtreeEmpty = (below || (above && entitiesUnder == 1));
+        subtreeYBoundLower = yBoundLower;
+        subtreeYBoundUpper = yBoundUpper;
+    }
+
+    return subtreeEmpty;
 }
 
 void AFK_WorldCell::testVisibility(const AFK_Camera& camera, bool& io_someVisible, bool& io_allVisible) const
@@ -70,14 +158,12 @@ unsigned int AFK_WorldCell::getStartingEntitiesWanted(
         assert(entityAddI == 0);
         ++entityCount;
 
-        /* I want more entities in larger cells */
-        Vec4<float> realCoord = getRealCoord();
-        float sparseMult = log(realCoord.v[3]);
+        entityCount += rollStartingEntities(rng, getRealCoord().v[3], entitySparseness);
 
-        for (unsigned int entitySlot = 0; entitySlot < maxEntityCount; ++entitySlot)
+        if (entityCount > 0)
         {
-            if (rng.frand() < (sparseMult / ((float)entitySparseness)))
-                ++entityCount;
+            assert(entityBlock == AFK_ENTITY_BLOCK_NONE);
+            entityBlock = afk_core.world->entityStore.alloc();
         }
 
         return entityCount;
@@ -168,6 +254,12 @@ void AFK_WorldCell::addStartingEntity(
         entityRotation);
 }
 
+AFK_Entity& AFK_WorldCell::getEntityAt(int i)
+{
+    assert(i < entityAddI && entityBlock != AFK_ENTITY_BLOCK_NONE);
+    return afk_core.world->entityStore.at(entityBlock)[i];
+}
+
 #if 0
 bool AFK_WorldCell::hasEntities(void) const
 {
@@ -192,8 +284,17 @@ AFK_ENTITY_LIST::iterator AFK_WorldCell::eraseEntity(AFK_ENTITY_LIST::iterator e
 
 void AFK_WorldCell::evict(void)
 {
+    if (entityBlock != AFK_ENTITY_BLOCK_NONE)
+    {
+        afk_core.world->entityStore.free(entityBlock);
+        entityBlock = AFK_ENTITY_BLOCK_NONE;
+    }
+
     entityCount = -1;
     entityAddI = 0;
+    entitiesUnder = -1;
+    subtreeEmpty = false;
+    subtreeYBoundLower = subtreeYBoundUpper = std::numeric_limits<float>::quiet_NaN();
 }
 
 std::ostream& operator<<(std::ostream& os, const AFK_WorldCell& worldCell)
@@ -20,11 +20,12 @@
 
 #include "afk.hpp"
 
-#include <array>
 #include <cassert>
+#include <cstdint>
 
 #include "core.hpp"
 #include "entity.hpp"
+#include "entity_store.hpp"
 #include "rng/rng.hpp"
 #include "shape.hpp"
 #include "shape_sizes.hpp"
@@ -47,10 +48,15 @@ protected:
     /* TODO: This needs to change upon a rebase ... */
     AFK_VisibleCell visibleCell;
 
-    /* The list of Entities currently homed to this cell. */
+    /* The Entities currently homed to this cell live in the
+     * world's entity store, in this block (AFK_ENTITY_BLOCK_NONE
+     * if I haven't got any).
+     * Copies of a cell (in volatile claims) share the block, so
+     * only evict() gives it back.
+     */
     //AFK_ENTITY_LIST *entities;
-    static const unsigned int maxEntityCount = 4;
-    std::array<AFK_Entity, maxEntityCount> entities;
+    static const unsigned int maxEntityCount = AFK_ENTITY_BLOCK_SIZE;
+    uint32_t entityBlock;
     int entityCount; /* -1 for not generated yet */
 
     /* This tracks how far I've gotten along the whole business
@@ -58,6 +64,35 @@ protected:
      */
     int entityAddI;
 
+    /* What I know about the cells under me, so that the enumeration
+     * can skip them when there's nothing there to display (see
+     * testSubtreeEmpty()).
+     * `entitiesUnder' is -1 if I haven't looked yet, 0 if some cell
+     * under me might get entities (or there were too many to look
+     * at), and 1 if none of them will.
+     * `subtreeEmpty' goes with the tile y-bounds it was worked out
+     * from, and gets worked out again if they change.
+     */
+    int entitiesUnder;
+    bool subtreeEmpty;
+    float subtreeYBoundLower;
+    float subtreeYBoundUpper;
+
+    /* The dice that getStartingEntitiesWanted() rolls for a cell of
+     * this real size.
+     */
+    static int rollStartingEntities(AFK_RNG& rng, float realScale, unsigned int entitySparseness);
+
+    /* Rolls those dice for every cell under this one that the
+     * enumeration could ever reach, and returns true if none of
+     * them get any entities.
+     */
+    static bool noEntitiesUnder(
+        const AFK_Cell& cell,
+        float worldScale,
+        unsigned int subdivisionFactor,
+        unsigned int entitySparseness);
+
     /* For generating the shapes for our starting entities. */
     bool checkClaimedShape(unsigned int shapeKey, AFK_Shape& shape, const AFK_ShapeSizes& sSizes);
     void generateShapeArtwork(unsigned int shapeKey, AFK_Shape& shape, unsigned int threadId, const AFK_ShapeSizes& sSizes);
@@ -75,12 +110,37 @@ public:
     void bind(const AFK_Cell& cell, float worldScale);
 
     /* Tests whether this cell is within the specified detail pitch
-     * when viewed from the specified location.
+     * when viewed from the specified location.  (See
+     * AFK_VisibleCell for the tolerance.)
      */
     bool testDetailPitch(
         float detailPitch,
         const AFK_Camera& camera,
-        const Vec3<float>& viewerLocation) const;
+        const Vec3<float>& viewerLocation,
+        float sphereTolerance) const;
+
+    /* Tests whether there's nothing to display anywhere under this
+     * cell, so it needn't be subdivided: that is, if it's more than
+     * `yMargin' cell sizes below the lower y-bound of its landscape
+     * tile, or more than that above the upper y-bound and none of
+     * its subcells want starting entities.
+     * (The margin is because the finer tiles under this one add
+     * their own terrain, which can stray outside this tile's
+     * bounds.)
+     * I only go looking for entities if the cell's no more than
+     * `entityDepth' subdivisions away from the smallest cells;
+     * bigger ones almost always have some, anyway.  I only look
+     * once; I'll check against the y-bounds again if they change.
+     */
+    bool testSubtreeEmpty(
+        const AFK_Cell& cell,
+        float worldScale,
+        float yBoundLower,
+        float yBoundUpper,
+        float yMargin,
+        unsigned int subdivisionFactor,
+        unsigned int entitySparseness,
+        unsigned int entityDepth);
 
     /* Tests whether none, some or all of this cell's vertices are
      * visible when projected with the supplied camera.
@@ -117,7 +177,7 @@ public:
     AFK_ENTITY_LIST::iterator eraseEntity(AFK_ENTITY_LIST::iterator eIt);
 #else
     int getEntityCount() const { return entityCount; }
-    AFK_Entity& getEntityAt(int i) { assert(i < entityAddI); return entities[i]; }
+    AFK_Entity& getEntityAt(int i);
 #endif
 
     /* Evicts the cell. */
@@ -0,0 +1,111 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#include "afk.hpp"
+
+#include <cassert>
+
+#include "world_front.hpp"
+
+
+/* AFK_WorldFront implementation */
+
+AFK_WorldFront::AFK_WorldFront()
+{
+}
+
+void AFK_WorldFront::addLeaf(unsigned int threadId, const AFK_Cell& cell)
+{
+    assert(threadId < AFK_MAX_THREADS);
+    lists[threadId].leaves.push_back(cell);
+}
+
+void AFK_WorldFront::gatherSeeds(
+    unsigned int subdivisionFactor,
+    int64_t rootScale,
+    const std::function<bool (const AFK_Cell&)>& parentIsLeaf,
+    std::vector<AFK_Cell>& o_leafSeeds,
+    std::vector<AFK_Cell>& o_parentSeeds,
+    std::vector<AFK_Cell>& o_ancestorSeeds)
+{
+    const unsigned int subcellsPerParent = CUBE(subdivisionFactor);
+    const unsigned int keepSubcells = subcellsPerParent + 1;
+    parentLeafCounts.clear();
+
+    for (unsigned int t = 0; t < AFK_MAX_THREADS; ++t)
+        for (auto leaf : lists[t].leaves)
+            if (leaf.coord.v[3] < rootScale) ++parentLeafCounts[leaf.parent(subdivisionFactor)];
+
+    for (unsigned int t = 0; t < AFK_MAX_THREADS; ++t)
+    {
+        for (auto leaf : lists[t].leaves)
+        {
+            if (leaf.coord.v[3] < rootScale)
+            {
+                auto parentIt = parentLeafCounts.find(leaf.parent(subdivisionFactor));
+                assert(parentIt != parentLeafCounts.end());
+                if (parentIt->second == subcellsPerParent)
+                {
+                    /* The first subcell to get here decides.  If the
+                     * parent would only be subdivided again, the
+                     * subcells stay; otherwise it puts the parent
+                     * in, and the rest find it's already done.
+                     */
+                    if (parentIsLeaf(parentIt->first))
+                    {
+                        o_parentSeeds.push_back(parentIt->first);
+                        parentIt->second = 0;
+                        continue;
+                    }
+
+                    parentIt->second = keepSubcells;
+                }
+                else if (parentIt->second == 0)
+                {
+                    continue;
+                }
+            }
+
+            o_leafSeeds.push_back(leaf);
+        }
+
+        lists[t].leaves.clear();
+    }
+
+    /* Now, everything above those.  Once I reach an ancestor
+     * I've already got, I've got all of its ancestors too.
+     */
+    ancestors.clear();
+    auto addAncestors = [&](const AFK_Cell& seed)
+    {
+        for (AFK_Cell cell = seed; cell.coord.v[3] < rootScale; )
+        {
+            cell = cell.parent(subdivisionFactor);
+            if (!ancestors.insert(cell).second) break;
+            o_ancestorSeeds.push_back(cell);
+        }
+    };
+
+    for (auto seed : o_leafSeeds) addAncestors(seed);
+    for (auto seed : o_parentSeeds) addAncestors(seed);
+}
+
+void AFK_WorldFront::clear(void)
+{
+    for (unsigned int t = 0; t < AFK_MAX_THREADS; ++t)
+        lists[t].leaves.clear();
+}
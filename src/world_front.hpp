@@ -0,0 +1,102 @@
+/* AFK
+ * Copyright (C) 2013-2014, Alex Holloway.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see [http://www.gnu.org/licenses/].
+ */
+
+#ifndef _AFK_WORLD_FRONT_H_
+#define _AFK_WORLD_FRONT_H_
+
+#include "afk.hpp"
+
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "async/thread_allocation.hpp"
+#include "cell.hpp"
+
+/* The front is the set of leaves of the last world enumeration:
+ * the cells that were displayed, and the cells that were thrown
+ * away as invisible or occluded.  Between them they cover all the
+ * space the enumeration looked at, without overlapping.
+ *
+ * When the camera has barely moved, I can start the next
+ * enumeration from the front rather than from the top-level cells,
+ * and skip walking all the way down the tree again.  Each leaf goes
+ * back in as it was, except where all the subcells of one parent
+ * are leaves and the parent would now be displayed as it is: then
+ * the parent goes in instead, to become a leaf itself.  (Any other
+ * parent would only subdivide again, every frame.)  The enumeration
+ * refines leaves that want refining as it always did.  So the front
+ * can go one level finer anywhere in a single frame, and one level
+ * coarser.
+ *
+ * The cells above the seeds don't get enumerated, but they've still
+ * got entities in them, so they go back in too, just for those.
+ */
+class AFK_WorldFront
+{
+protected:
+    /* The workers each add leaves to their own list (padded
+     * apart.)
+     */
+    struct LeafList
+    {
+        std::vector<AFK_Cell> leaves;
+        char pad[64];
+    };
+
+    LeafList lists[AFK_MAX_THREADS];
+
+    /* For counting up the leaves under each parent.  I keep it
+     * around to save reallocating it every frame.
+     */
+    std::unordered_map<AFK_Cell, unsigned int, AFK_HashCell> parentLeafCounts;
+
+    /* ...and likewise for picking out the cells above the seeds. */
+    std::unordered_set<AFK_Cell, AFK_HashCell> ancestors;
+
+public:
+    AFK_WorldFront();
+
+    AFK_WorldFront(const AFK_WorldFront& _front) = delete;
+    AFK_WorldFront& operator=(const AFK_WorldFront& _front) = delete;
+
+    /* Workers call this for each leaf they make. */
+    void addLeaf(unsigned int threadId, const AFK_Cell& cell);
+
+    /* The master thread calls this between enumerations, to turn
+     * the front into the cells to start the next one from (and
+     * empty it.)  Leaves of `rootScale' stay as they are, because
+     * their parents are above the top of the enumeration.
+     * `o_leafSeeds' are old leaves, and `o_parentSeeds' are the
+     * parents replacing a full set of subcells (those for which
+     * `parentIsLeaf' says yes).  `o_ancestorSeeds' are all the
+     * cells above those, up to `rootScale'.
+     */
+    void gatherSeeds(
+        unsigned int subdivisionFactor,
+        int64_t rootScale,
+        const std::function<bool (const AFK_Cell&)>& parentIsLeaf,
+        std::vector<AFK_Cell>& o_leafSeeds,
+        std::vector<AFK_Cell>& o_parentSeeds,
+        std::vector<AFK_Cell>& o_ancestorSeeds);
+
+    /* Throws the front away (before a full enumeration.) */
+    void clear(void);
+};
+
+#endif /* _AFK_WORLD_FRONT_H_ */
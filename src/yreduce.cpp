@@ -133,7 +133,7 @@ void AFK_YReduce::readBack(
         {
             if (pushed[i]) continue;
 
-            auto entry = cache->get(threadId, landscapeTiles[i]);
+            auto entry = cache->get(threadId, afk_packedTile(landscapeTiles[i]));
             if (entry)
             {
                 auto claim = entry->claimable.claim(threadId, 0);